@@ -8,22 +8,57 @@
  * This software has been placed into the public domain using CC0.
  */
 
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <ctype.h>
+#include <dirent.h>
 #include <err.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <fnmatch.h>
+#include <getopt.h>
 #include <limits.h>
-#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
+#ifdef __linux__
+# include <sys/syscall.h>
+# ifdef __NR_io_uring_setup
+#  include <linux/io_uring.h>
+/**
+ * Build the io_uring engine (--io-uring) on Linux systems that have the
+ * io_uring system calls.
+ */
+#  define TOUCH_IO_URING
+# endif /* __NR_io_uring_setup */
+/**
+ * Flush each filesystem separately using syncfs() (--durable) instead of
+ * flushing every filesystem using sync().
+ */
+# define TOUCH_SYNCFS
+# ifdef __NR_ioprio_set
+/**
+ * Set the I/O priority (--ioprio) using the ioprio_set() system call.
+ */
+#  define TOUCH_IOPRIO
+# endif /* __NR_ioprio_set */
+#endif /* __linux__ */
+
+#include "touch.h"
+
 #ifdef TOUCH_TEST
 /**
  * Declare some functions with extern linkage, allowing the test suite to call
@@ -57,390 +92,8310 @@
 #define MAX_DATE_TIME_FMT_LEN (12)
 
 /**
- * Maximum length for long type (nanoseconds) in fractional specifier.
+ * Size of the read buffer used when reading paths from a list (-f).
+ *
+ * A single buffer of this size gets allocated per list regardless of the
+ * number of paths in the list. Larger lists in regular files get mapped
+ * into memory instead, and get parsed through a window of this size.
  */
-static size_t
-MAX_FRAC_CHAR_LEN;
+#define TOUCH_LIST_BUF_SZ (1 << 20)
 
 /**
- * @defgroup touch_flag touch flags
- *
- * Option flags when running touch.
+ * Maximum number of paths from a list to hand to the workers at once.
  */
+#define TOUCH_BATCH_SZ (16384)
 
 /**
- * Change file access time.
- *
- * Do not change modification time unless @ref TOUCH_FLAG_MOD_TIME (-m) also
- * set.
+ * Number of slots in the ring handing paths from a list to the workers.
  *
- * This flag corresponds to argument -a.
- *
- * @ingroup touch_flag
+ * Must be a power of two.
  */
-#define TOUCH_FLAG_ACCESS_TIME (1 << 0)
+#define TOUCH_RING_SZ (4096)
 
 /**
- * Do not create the file if it does not already exist.
- *
- * This flag corresponds to argument -c.
- *
- * @ingroup touch_flag
+ * Number of list read buffers that the reader cycles through while the
+ * workers still touch paths pointing into the previous buffers.
  */
-#define TOUCH_FLAG_NO_CREATE   (1 << 1)
+#define TOUCH_RING_NUM_BUFS (4)
 
 /**
- * Change file modification time.
- *
- * Do not change access time unless @ref TOUCH_FLAG_ACCESS_TIME (-a) also set.
- *
- * This flag corresponds to argument -m.
- *
- * @ingroup touch_flag
+ * Number of times an idle worker polls the empty ring before sleeping
+ * until the reader adds a path or closes the ring.
  */
-#define TOUCH_FLAG_MOD_TIME    (1 << 2)
+#define TOUCH_RING_SPINS (64)
 
 /**
- * Use the time from a reference file.
- *
- * This flag corresponds to argument -r.
- *
- * @ingroup touch_flag
+ * Minimum size of each block allocated by @ref touch_arena.
  */
-#define TOUCH_FLAG_REF_FILE    (1 << 3)
+#define TOUCH_ARENA_BLOCK_SZ (64 * 1024)
 
 /**
- * Use the time specified in the following format.
- *
- * [[CC]YY]MMDDhhmm[.SS]
- *
- * This flag corresponds to argument -t.
- *
- * @ingroup touch_flag
+ * Number of parent directory file descriptors kept open by each context.
+ */
+#define TOUCH_DIRCACHE_SZ (16)
+
+/**
+ * Maximum number of filesystems flushed separately by --durable before
+ * flushing every filesystem instead.
+ */
+#define TOUCH_DURABLE_FS_SZ (16)
+
+/**
+ * Maximum number of filesystems counted separately by --plan. Targets on any
+ * other filesystem get counted together.
+ */
+#define TOUCH_PLAN_FS_SZ (16)
+
+/**
+ * Apply kernel mode checking the current times first (--if-changed,
+ * --forward-only).
+ */
+#define TOUCH_KERNEL_CHECK   (1U << 0)
+
+/**
+ * Apply kernel mode leaving alone times that would move backwards
+ * (--forward-only).
+ */
+#define TOUCH_KERNEL_FORWARD (1U << 1)
+
+/**
+ * Apply kernel mode creating missing files (no -c).
+ */
+#define TOUCH_KERNEL_CREATE  (1U << 2)
+
+/**
+ * Apply kernel mode waiting for the rate limit and measuring the latency
+ * (--max-rate, --target-latency).
+ */
+#define TOUCH_KERNEL_LIMIT   (1U << 3)
+
+/**
+ * Number of apply kernels, one for each combination of the mode bits.
+ */
+#define TOUCH_KERNEL_NUM     (1U << 4)
+
+/**
+ * Maximum number of worker threads allowed in -j.
+ */
+#define TOUCH_MAX_JOBS (1024)
+
+/**
+ * Long option value for --files0-from.
+ */
+#define TOUCH_OPT_FILES0_FROM (256)
+
+/**
+ * Long option value for --io-uring.
+ */
+#define TOUCH_OPT_IO_URING    (257)
+
+/**
+ * Long option value for --stats.
+ */
+#define TOUCH_OPT_STATS       (258)
+
+/**
+ * Long option value for --manifest.
+ */
+#define TOUCH_OPT_MANIFEST    (259)
+
+/**
+ * Long option value for --ref-root.
+ */
+#define TOUCH_OPT_REF_ROOT    (260)
+
+/**
+ * Long option value for --target-root.
+ */
+#define TOUCH_OPT_TARGET_ROOT (261)
+
+/**
+ * Long option value for --if-changed.
+ */
+#define TOUCH_OPT_IF_CHANGED  (262)
+
+/**
+ * Long option value for --forward-only.
+ */
+#define TOUCH_OPT_FORWARD     (263)
+
+/**
+ * Long option value for --max-errors.
+ */
+#define TOUCH_OPT_MAX_ERRORS  (264)
+
+/**
+ * Long option value for --collapse-errors.
+ */
+#define TOUCH_OPT_COLLAPSE    (265)
+
+/**
+ * Long option value for --new-files.
+ */
+#define TOUCH_OPT_NEW         (266)
+
+/**
+ * Long option value for --sort.
+ */
+#define TOUCH_OPT_SORT        (267)
+
+/**
+ * Long option value for --serve.
+ */
+#define TOUCH_OPT_SERVE       (268)
+
+/**
+ * Long option value for --glob.
+ */
+#define TOUCH_OPT_GLOB        (269)
+
+/**
+ * Long option value for --durable.
+ */
+#define TOUCH_OPT_DURABLE     (270)
+
+/**
+ * Long option value for --progress.
+ */
+#define TOUCH_OPT_PROGRESS    (271)
+
+/**
+ * Long option value for --max-rate.
+ */
+#define TOUCH_OPT_MAX_RATE    (272)
+
+/**
+ * Long option value for --target-latency.
+ */
+#define TOUCH_OPT_TARGET_LATENCY (273)
+
+/**
+ * Long option value for --nice.
+ */
+#define TOUCH_OPT_NICE        (274)
+
+/**
+ * Long option value for --ioprio.
+ */
+#define TOUCH_OPT_IOPRIO      (275)
+
+/**
+ * Long option value for --plan.
+ */
+#define TOUCH_OPT_PLAN        (276)
+
+/**
+ * Long option value for --checkpoint.
+ */
+#define TOUCH_OPT_CHECKPOINT  (277)
+
+/**
+ * Long option value for --resume.
+ */
+#define TOUCH_OPT_RESUME      (278)
+
+/**
+ * Target that would get created (--plan).
+ */
+#define TOUCH_PLAN_CREATE     (0)
+
+/**
+ * Existing target that would get its times updated (--plan).
+ */
+#define TOUCH_PLAN_UPDATE     (1)
+
+/**
+ * Existing target that already has the requested times (--plan).
+ */
+#define TOUCH_PLAN_UNCHANGED  (2)
+
+/**
+ * Missing target that would not get created because of -c (--plan).
+ */
+#define TOUCH_PLAN_SKIP       (3)
+
+/**
+ * Target that would fail to get touched (--plan).
  */
-#define TOUCH_FLAG_TIME        (1 << 4)
+#define TOUCH_PLAN_ERROR      (4)
 
 /**
- * Use the date_time specified in the following format.
+ * Number of target classes counted by --plan.
+ */
+#define TOUCH_PLAN_NUM        (5)
+
+/**
+ * Number of errno values counted separately in @ref touch_stats::errnos.
  *
- * YYYY-MM-DDThh:mm:SS[[.|,]frac][tz]
+ * Larger errno values get counted in the last slot.
+ */
+#define TOUCH_STATS_ERRNO_SZ (160)
+
+/**
+ * Size of the buffer that error messages get saved in before getting
+ * written to STDERR.
+ */
+#define TOUCH_ERRLOG_SZ      (64 * 1024)
+
+/**
+ * Space left in the error message buffer before adding another message,
+ * which fits any message from @ref touch_warn along with the program name
+ * and errno description.
+ */
+#define TOUCH_ERRLOG_LINE_SZ (PATH_MAX + 400)
+
+/**
+ * Size of the buffer that a checkpoint gets formatted in (--checkpoint),
+ * which fits the offset, the totals, and a count for every errno slot.
+ */
+#define TOUCH_CHECKPOINT_SZ  (8 * 1024)
+
+/**
+ * Number of newly created files kept open so that they can get closed
+ * together (--new-files).
+ */
+#define TOUCH_CLOSE_BATCH_SZ (64)
+
+/**
+ * Minimum number of targets in the same directory before reading that
+ * directory to order them by inode number (--sort).
+ */
+#define TOUCH_SORT_SCAN_MIN  (32)
+
+/**
+ * Maximum size of a single request sent to the server (--serve).
+ */
+#define TOUCH_SERVE_MAX_SZ   (16 * 1024 * 1024)
+
+/**
+ * Characters that make a file operand get expanded as a pattern (--glob).
+ */
+#define TOUCH_GLOB_META      "*?[\\"
+
+/**
+ * Pattern component without any pattern characters, which gets looked up
+ * directly instead of reading the directory.
+ */
+#define TOUCH_GLOB_LITERAL   (0)
+
+/**
+ * Pattern component "*" matching any name.
+ */
+#define TOUCH_GLOB_ANY       (1)
+
+/**
+ * Pattern component "literal*" matching names with a literal prefix.
+ */
+#define TOUCH_GLOB_PREFIX    (2)
+
+/**
+ * Pattern component "*literal" matching names with a literal suffix.
+ */
+#define TOUCH_GLOB_SUFFIX    (3)
+
+/**
+ * Any other pattern component, which gets matched using fnmatch().
+ */
+#define TOUCH_GLOB_FNMATCH   (4)
+
+/**
+ * Pattern component "**" matching zero or more directories.
+ */
+#define TOUCH_GLOB_RECURSE   (5)
+
+/**
+ * Length in seconds of the intervals used to cache the local time zone
+ * offset.
  *
- * This flag corresopnds to argument -d.
+ * Time zone transitions never happen twice within one interval, so an
+ * interval with the same offset at both ends has that offset throughout.
+ */
+#define TOUCH_TZ_BUCKET_SEC (900L)
+
+/**
+ * Number of submission queue entries in the io_uring engine.
+ */
+#define TOUCH_URING_ENTRIES (256)
+
+/**
+ * Maximum number of digits in the -d fractional specifier plus one.
  *
- * @ingroup touch_flag
+ * Matches the number of digits in LONG_MAX, which is floor(log10(LONG_MAX))
+ * + 1 computed using 30103 / 100000 as log10(2).
  */
-#define TOUCH_FLAG_DATE_TIME   (1 << 5)
+#define MAX_FRAC_CHAR_LEN \
+  ((size_t)((sizeof(long) * CHAR_BIT - 1) * 30103UL / 100000UL + 1))
 
 /**
- * Touch program context.
+ * Number of fractional digits in a nanosecond value.
  */
-struct touch{
+#define TOUCH_NSEC_DIGITS (9)
+
+#ifndef TOUCH_LIMIT_WINDOW_NS
+/**
+ * Nanoseconds between adjustments of the number of running worker threads
+ * (--target-latency).
+ */
+# define TOUCH_LIMIT_WINDOW_NS (100000000UL)
+#endif /* TOUCH_LIMIT_WINDOW_NS */
+
+/**
+ * Nanoseconds a paused worker thread sleeps before checking whether it can
+ * run again (--target-latency).
+ */
+#define TOUCH_LIMIT_PAUSE_NS  (1000000UL)
+
+/**
+ * Bit position of the class in an I/O priority value (--ioprio).
+ */
+#define TOUCH_IOPRIO_CLASS_SHIFT (13)
+
+/**
+ * Best-effort I/O priority class, with levels 0 (highest) to 7 (lowest).
+ */
+#define TOUCH_IOPRIO_CLASS_BE    (2)
+
+/**
+ * Idle I/O priority class, which only gets disk time when no other process
+ * needs it.
+ */
+#define TOUCH_IOPRIO_CLASS_IDLE  (3)
+
+/**
+ * Lowest best-effort I/O priority level.
+ */
+#define TOUCH_IOPRIO_LEVEL_MAX   (7)
+
+/**
+ * ioprio_set() target type for a single process.
+ */
+#define TOUCH_IOPRIO_WHO_PROCESS (1)
+
+#ifndef TOUCH_PROGRESS_INTERVAL_NS
+/**
+ * Nanoseconds between progress reports (--progress).
+ */
+# define TOUCH_PROGRESS_INTERVAL_NS (1000000000UL)
+#endif /* TOUCH_PROGRESS_INTERVAL_NS */
+
+#ifndef TOUCH_CHECKPOINT_INTERVAL_NS
+/**
+ * Nanoseconds between saving checkpoints (--checkpoint).
+ */
+# define TOUCH_CHECKPOINT_INTERVAL_NS (1000000000UL)
+#endif /* TOUCH_CHECKPOINT_INTERVAL_NS */
+
+#ifdef __GNUC__
+/**
+ * Always inline the functions that the apply kernels get specialized from,
+ * even when called from many places.
+ */
+# define TOUCH_KERNEL_INLINE __inline__ __attribute__((__always_inline__))
+#else /* !(__GNUC__) */
+/**
+ * Leave inlining up to the compiler.
+ */
+# define TOUCH_KERNEL_INLINE
+#endif /* __GNUC__ */
+
+#ifndef TOUCH_APPLY_KERNELS
+/**
+ * Touch each path using the apply kernel chosen for the mode instead of
+ * @ref touch_path.
+ */
+# define TOUCH_APPLY_KERNELS (true)
+#endif /* TOUCH_APPLY_KERNELS */
+
+#ifndef TOUCH_DATE_TIME_FAST
+/**
+ * Try @ref touch_date_time_fast before parsing a date time string with
+ * strptime().
+ */
+# define TOUCH_DATE_TIME_FAST (true)
+#endif /* TOUCH_DATE_TIME_FAST */
+
+struct touch_checkpoint;
+struct touch_dircache;
+struct touch_durable;
+struct touch_limit;
+struct touch_plan;
+struct touch_progress;
+struct touch_uring;
+struct touch_worker;
+
+/**
+ * Offset of local time from UTC over one @ref TOUCH_TZ_BUCKET_SEC interval.
+ */
+struct touch_tzcache{
   /**
-   * See @ref touch_flag.
+   * Interval number, which is the UTC time divided by
+   * @ref TOUCH_TZ_BUCKET_SEC rounded down.
    */
-  unsigned int flags;
+  long bucket;
 
   /**
-   * Exit status set to one of the following values.
-   *   - EXIT_SUCCESS
-   *   - EXIT_FAILURE
+   * Seconds east of UTC during @ref bucket.
    */
-  int status_code;
+  long gmtoff;
 
   /**
-   * Access and modifications times to set.
+   * Set if @ref gmtoff applies to the whole interval in @ref bucket.
    */
-  struct timespec time_am[2];
+  bool valid;
+
+  /**
+   * Set after reading the local time zone.
+   */
+  bool loaded;
 };
 
 /**
- * Print an error message to STDERR and set an error status code.
+ * Counters for events on the hot path (--stats).
+ *
+ * The counters always get updated. The times only get measured when
+ * @ref TOUCH_FLAG_STATS has been set.
+ */
+struct touch_stats{
+  /**
+   * Number of targets checked or touched, counted by the progress reporter
+   * as done.
+   */
+  unsigned long targets;
+
+  /**
+   * Number of files and directories opened, including opens submitted to
+   * the io_uring engine.
+   */
+  unsigned long opens;
+
+  /**
+   * Number of files created.
+   */
+  unsigned long creats;
+
+  /**
+   * Number of utimensat() calls.
+   */
+  unsigned long utimensat;
+
+  /**
+   * Number of futimens() calls.
+   */
+  unsigned long futimens;
+
+  /**
+   * Number of files checked for their times, including reference files.
+   */
+  unsigned long statx;
+
+  /**
+   * Number of existing files left alone by --if-changed or --forward-only.
+   */
+  unsigned long unchanged;
+
+  /**
+   * Number of paths that did not exist when updating the times.
+   */
+  unsigned long enoent;
+
+  /**
+   * Number of errors reported.
+   */
+  unsigned long errors;
+
+  /**
+   * Number of errors reported for each errno value.
+   */
+  unsigned long errnos[TOUCH_STATS_ERRNO_SZ];
+
+  /**
+   * Nanoseconds spent parsing the arguments and lists.
+   */
+  unsigned long parse_ns;
+
+  /**
+   * Nanoseconds spent touching files and reading lists.
+   */
+  unsigned long fs_ns;
+};
+
+/**
+ * Buffered error messages waiting to get written to STDERR.
+ *
+ * Messages get written using one write() call each time the buffer fills
+ * up instead of one or more writes for every message.
+ */
+struct touch_errlog{
+  /**
+   * Formatted messages, each ending with a newline.
+   */
+  char buf[TOUCH_ERRLOG_SZ];
+
+  /**
+   * Number of bytes in @ref buf.
+   */
+  size_t len;
+
+  /**
+   * Number of messages saved in @ref buf so far, including the messages
+   * that have already been written.
+   */
+  unsigned long num_shown;
+
+  /**
+   * Number of messages not shown because of --max-errors.
+   */
+  unsigned long dropped;
+
+  /**
+   * Set after showing a message for the corresponding errno value.
+   */
+  bool seen[TOUCH_STATS_ERRNO_SZ];
+
+  /**
+   * Number of messages not shown for each errno value because of
+   * --collapse-errors.
+   */
+  unsigned long repeats[TOUCH_STATS_ERRNO_SZ];
+};
+
+/**
+ * Touch program context.
+ */
+struct touch{
+  /**
+   * See @ref touch_flag.
+   */
+  unsigned int flags;
+
+  /**
+   * Exit status set to one of the following values.
+   *   - EXIT_SUCCESS
+   *   - EXIT_FAILURE
+   */
+  int status_code;
+
+  /**
+   * Access and modifications times to set.
+   */
+  struct timespec time_am[2];
+
+  /**
+   * Read additional paths from this list (-f or --files0-from).
+   *
+   * Set to "-" to read the list from STDIN.
+   */
+  const char *list_path;
+
+  /**
+   * Character separating each path in @ref list_path.
+   */
+  char list_delim;
+
+  /**
+   * Read records with a path and its own times from this manifest
+   * (--manifest).
+   *
+   * Set to "-" to read the manifest from STDIN.
+   */
+  const char *manifest_path;
+
+  /**
+   * Number of worker threads used to touch paths (-j).
+   */
+  size_t jobs;
+
+  /**
+   * Index of the path currently getting touched by @ref worker.
+   */
+  size_t path_index;
+
+  /**
+   * Worker thread owning this context, or NULL for the main context.
+   *
+   * Error messages get saved in the worker and printed later in path order
+   * when set.
+   */
+  struct touch_worker *worker;
+
+  /**
+   * io_uring engine, or NULL if not available.
+   */
+  struct touch_uring *uring;
+
+  /**
+   * Cache of parent directory file descriptors, or NULL if not available.
+   */
+  struct touch_dircache *dircache;
+
+  /**
+   * Reference root used to find the times of each target (--ref-root).
+   */
+  const char *ref_root;
+
+  /**
+   * Targets get mapped to @ref ref_root relative to this directory
+   * (--target-root), or NULL to append each target path to @ref ref_root.
+   */
+  const char *target_root;
+
+  /**
+   * Cache of reference parent directory file descriptors, or NULL if not
+   * available.
+   */
+  struct touch_dircache *ref_dircache;
+
+  /**
+   * Filesystems to flush when finished (--durable), or NULL if not
+   * available.
+   */
+  struct touch_durable *durable;
+
+  /**
+   * File descriptor getting the progress reports (--progress), or 0 to not
+   * report progress.
+   */
+  int progress_fd;
+
+  /**
+   * Progress reporter thread, or NULL if not running.
+   */
+  struct touch_progress *progress;
+
+  /**
+   * Maximum number of touch operations per second across all threads
+   * (--max-rate), or 0 for no limit.
+   */
+  unsigned long max_rate;
+
+  /**
+   * Target nanoseconds per utimensat() call used to adjust the number of
+   * running worker threads (--target-latency), or 0 to always run every
+   * worker.
+   */
+  unsigned long target_latency_ns;
+
+  /**
+   * State shared by all threads for --max-rate and --target-latency, or
+   * NULL if neither has been provided.
+   */
+  struct touch_limit *limit;
+
+  /**
+   * Scheduling priority (--nice), used if @ref set_nice.
+   */
+  int nice;
+
+  /**
+   * Set the scheduling priority to @ref nice.
+   */
+  bool set_nice;
+
+  /**
+   * I/O priority value (--ioprio), or 0 to leave the I/O priority alone.
+   */
+  int ioprio;
+
+  /**
+   * Targets counted by --plan, or NULL if not available.
+   */
+  struct touch_plan *plan;
+
+  /**
+   * Index in @ref touch_plan::fs of the filesystem holding the parent
+   * directory of the last target (--plan).
+   */
+  size_t plan_fs;
+
+  /**
+   * Error from checking the parent directory of the last target, or 0 if
+   * it exists (--plan).
+   */
+  int plan_dir_errno;
+
+  /**
+   * Save the progress through the list or manifest to this file
+   * (--checkpoint), or NULL to not save any checkpoints.
+   */
+  const char *checkpoint_path;
+
+  /**
+   * Start the list or manifest at the offset saved in
+   * @ref checkpoint_path (--resume).
+   */
+  bool resume;
+
+  /**
+   * Checkpoint state for @ref checkpoint_path, or NULL if not available.
+   */
+  struct touch_checkpoint *checkpoint;
+
+  /**
+   * See @ref touch_stats.
+   */
+  struct touch_stats stats;
+
+  /**
+   * See @ref touch_tzcache.
+   */
+  struct touch_tzcache tz;
+
+  /**
+   * Maximum number of error messages to print (--max-errors), or 0 for no
+   * limit.
+   */
+  unsigned long max_errors;
+
+  /**
+   * See @ref touch_errlog. Messages get printed right away if NULL.
+   */
+  struct touch_errlog *errlog;
+
+  /**
+   * Newly created files waiting to get closed (--new-files).
+   */
+  int close_fds[TOUCH_CLOSE_BATCH_SZ];
+
+  /**
+   * Number of file descriptors in @ref close_fds.
+   */
+  size_t num_close_fds;
+
+  /**
+   * Unix socket path to accept requests on (--serve), or NULL.
+   */
+  const char *serve_path;
+
+  /**
+   * Set once the server has received a shutdown request.
+   */
+  bool serve_stop;
+};
+
+/**
+ * Parent directory of recently touched paths.
+ */
+struct touch_dircache_entry{
+  /**
+   * Directory path, NUL-terminated.
+   */
+  char dir[PATH_MAX];
+
+  /**
+   * Length of @ref dir.
+   */
+  size_t len;
+
+  /**
+   * Open directory file descriptor, or -1 if not open.
+   */
+  int fd;
+
+  /**
+   * Already tried to open the directory.
+   */
+  bool tried;
+
+  /**
+   * Value of @ref touch_dircache::clock when last used. Zero if unused.
+   */
+  unsigned long used;
+};
+
+/**
+ * Least recently used cache of parent directory file descriptors.
+ *
+ * Paths in the same directory get touched relative to a shared directory
+ * file descriptor, so the kernel only needs to resolve the leading
+ * directories once. A directory only gets opened the second time it appears
+ * in a row of recent paths, which avoids the extra open and close for
+ * directories that only contain a single target.
+ */
+struct touch_dircache{
+  /**
+   * Incremented on each lookup.
+   */
+  unsigned long clock;
+
+  /**
+   * Cached directories.
+   */
+  struct touch_dircache_entry entries[TOUCH_DIRCACHE_SZ];
+
+  /**
+   * Parent directory of the last path recorded by --durable or --plan,
+   * NUL-terminated.
+   */
+  char last_dir[PATH_MAX];
+
+  /**
+   * Length of @ref last_dir, or PATH_MAX if no directory has been
+   * recorded.
+   */
+  size_t last_len;
+
+  /**
+   * Device ID of the filesystem holding @ref last_dir.
+   */
+  dev_t last_dev;
+};
+
+/**
+ * Filesystem holding touched files (--durable).
+ */
+struct touch_durable_fs{
+  /**
+   * Device ID of the filesystem.
+   */
+  dev_t dev;
+
+  /**
+   * Open directory file descriptor on the filesystem.
+   */
+  int fd;
+};
+
+/**
+ * Filesystems to flush after touching all targets (--durable).
+ *
+ * Shared by the main context and all worker threads, so each filesystem
+ * only gets flushed once no matter which thread touched its files.
+ */
+struct touch_durable{
+  /**
+   * Protects the filesystem list.
+   */
+  pthread_mutex_t mutex;
+
+  /**
+   * Function touching each path, wrapped by @ref touch_durable_path.
+   */
+  void (*fn)(struct touch *const touch,
+             const char *const path);
+
+  /**
+   * Filesystems recorded so far.
+   */
+  struct touch_durable_fs fs[TOUCH_DURABLE_FS_SZ];
+
+  /**
+   * Number of filesystems in @ref fs.
+   */
+  size_t num_fs;
+
+  /**
+   * Set if a touched file could not get matched to an entry in @ref fs,
+   * which flushes every filesystem instead.
+   */
+  bool sync_all;
+};
+
+/**
+ * Read paths from a list file in large chunks.
+ *
+ * Each path gets NUL-terminated in place inside the buffer, so no memory
+ * gets allocated per path. Large regular files get mapped privately into
+ * memory instead of getting read, and the part of the mapping before the
+ * current window gets released as the list gets parsed, so only a window
+ * of the file stays resident.
+ */
+struct touch_list{
+  /**
+   * Read paths from this file descriptor.
+   */
+  int fd;
+
+  /**
+   * Character separating each path.
+   */
+  char delim;
+
+  /**
+   * Reached the end of the list.
+   */
+  bool eof;
+
+  /**
+   * Discard characters until the next delimiter because the current path
+   * does not fit in @ref buf.
+   */
+  bool skip;
+
+  /**
+   * Number of valid bytes in @ref buf.
+   */
+  size_t len;
+
+  /**
+   * Position of the next path in @ref buf.
+   */
+  size_t pos;
+
+  /**
+   * Read buffer with size @ref TOUCH_LIST_BUF_SZ + 1, or the current
+   * window into @ref map.
+   */
+  char *buf;
+
+  /**
+   * List mapped into memory, or NULL if reading the list into @ref buf.
+   * One extra zeroed byte follows the file contents.
+   */
+  char *map;
+
+  /**
+   * Size of the list file in @ref map.
+   */
+  size_t map_len;
+
+  /**
+   * Offset in @ref map up to which the memory has been released.
+   */
+  size_t map_released;
+
+  /**
+   * Offset in the list of the first byte in @ref buf, so the next path
+   * starts at this offset plus @ref pos.
+   */
+  unsigned long offset;
+};
+
+/**
+ * Position in the list or manifest saved to a side file, so an interrupted
+ * run can start again where it left off (--checkpoint).
+ */
+struct touch_checkpoint{
+  /**
+   * Offset in the list or manifest to start at (--resume).
+   */
+  unsigned long offset;
+
+  /**
+   * Number of targets done by the runs before the one being resumed.
+   */
+  unsigned long targets;
+
+  /**
+   * Number of errors reported by the runs before the one being resumed.
+   */
+  unsigned long errors;
+
+  /**
+   * Number of errors for each errno value reported by the runs before the
+   * one being resumed.
+   */
+  unsigned long errnos[TOUCH_STATS_ERRNO_SZ];
+
+  /**
+   * Monotonic time when the last checkpoint got saved.
+   */
+  unsigned long last_ns;
+
+  /**
+   * Set after failing to save a checkpoint, which stops saving any more.
+   */
+  bool failed;
+
+  /**
+   * Temporary file each checkpoint gets written to before getting renamed
+   * to @ref touch::checkpoint_path.
+   */
+  char tmp_path[PATH_MAX];
+
+  /**
+   * Buffer the checkpoint gets read into or formatted in.
+   */
+  char buf[TOUCH_CHECKPOINT_SZ];
+};
+
+/**
+ * Error message saved by a worker thread.
+ */
+struct touch_diag{
+  /**
+   * Index of the path that caused this error.
+   */
+  size_t path_index;
+
+  /**
+   * Order of this message relative to other messages from the same worker.
+   */
+  size_t seq;
+
+  /**
+   * Value of errno to describe after the message, or 0 if none.
+   */
+  int errnum;
+
+  /**
+   * Formatted message.
+   */
+  char *msg;
+};
+
+/**
+ * Worker thread that touches paths from its own queue, and steals paths
+ * from the other workers once its own queue becomes empty.
+ */
+struct touch_worker{
+  /**
+   * Context copied from the main context with a separate status code.
+   */
+  struct touch touch;
+
+  /**
+   * Worker pool containing this worker.
+   */
+  struct touch_pool *pool;
+
+  /**
+   * Worker thread.
+   */
+  pthread_t thread;
+
+  /**
+   * Thread has been created and needs to get joined.
+   */
+  bool started;
+
+  /**
+   * Protects @ref head and @ref tail.
+   */
+  pthread_mutex_t mutex;
+
+  /**
+   * Index of the next path to touch from the front of the queue.
+   */
+  size_t head;
+
+  /**
+   * Index after the last path in the queue. Other workers steal from here.
+   */
+  size_t tail;
+
+  /**
+   * Saved error messages.
+   */
+  struct touch_diag *diag;
+
+  /**
+   * Number of messages in @ref diag.
+   */
+  size_t diag_len;
+
+  /**
+   * Number of messages allocated in @ref diag.
+   */
+  size_t diag_sz;
+
+  /**
+   * Number of messages in @ref diag that count against --max-errors,
+   * which excludes messages limited by --collapse-errors instead.
+   */
+  size_t diag_limited;
+
+  /**
+   * Number of messages saved so far, used for @ref touch_diag::seq.
+   */
+  size_t diag_seq;
+
+  /**
+   * See @ref touch_errlog::dropped. Only the messages for the first paths
+   * in each worker can be among the first messages overall, so the rest
+   * do not get saved.
+   */
+  unsigned long diag_dropped;
+
+  /**
+   * See @ref touch_errlog::seen.
+   */
+  bool diag_seen[TOUCH_STATS_ERRNO_SZ];
+
+  /**
+   * Index in @ref diag of the saved message for each errno value in
+   * @ref diag_seen.
+   */
+  size_t diag_first[TOUCH_STATS_ERRNO_SZ];
+
+  /**
+   * See @ref touch_errlog::repeats.
+   */
+  unsigned long diag_repeats[TOUCH_STATS_ERRNO_SZ];
+};
+
+/**
+ * List read buffer shared with the workers through @ref touch_ring.
+ */
+struct touch_ring_buf{
+  /**
+   * Read buffer with size @ref TOUCH_LIST_BUF_SZ + 1.
+   */
+  char *data;
+
+  /**
+   * Number of queued or in-progress paths pointing into @ref data, plus one
+   * while the reader still parses paths from it. The reader only reuses
+   * the buffer after this drops to zero.
+   */
+  size_t refs;
+};
+
+/**
+ * Slot in @ref touch_ring.
+ */
+struct touch_ring_slot{
+  /**
+   * Equal to the ring position when the slot can get filled, or one past
+   * the ring position once it holds a path.
+   */
+  size_t seq;
+
+  /**
+   * Path pointing into @ref buf.
+   */
+  const char *path;
+
+  /**
+   * Index of @ref path in the list.
+   */
+  size_t path_index;
+
+  /**
+   * Buffer containing @ref path.
+   */
+  struct touch_ring_buf *buf;
+};
+
+/**
+ * Bounded lock-free multiple-producer, multiple-consumer queue of paths
+ * read from a list.
+ *
+ * Each slot only points into one of the list read buffers, so paths do
+ * not get copied or allocated between reading the list and touching them.
+ */
+struct touch_ring{
+  /**
+   * Next position to fill.
+   */
+  size_t enqueue_pos;
+
+  /**
+   * Keeps the producer and consumer positions on separate cache lines.
+   */
+  char pad_enqueue[64];
+
+  /**
+   * Next position to take a path from.
+   */
+  size_t dequeue_pos;
+
+  /**
+   * See @ref pad_enqueue.
+   */
+  char pad_dequeue[64];
+
+  /**
+   * No more paths will get added.
+   */
+  bool closed;
+
+  /**
+   * Number of workers sleeping on @ref cond.
+   */
+  size_t sleepers;
+
+  /**
+   * Protects the workers going to sleep on @ref cond.
+   */
+  pthread_mutex_t mutex;
+
+  /**
+   * Signaled when a path gets added or the ring gets closed while a worker
+   * sleeps.
+   */
+  pthread_cond_t cond;
+
+  /**
+   * Queue slots.
+   */
+  struct touch_ring_slot slots[TOUCH_RING_SZ];
+
+  /**
+   * List read buffers.
+   */
+  struct touch_ring_buf bufs[TOUCH_RING_NUM_BUFS];
+};
+
+/**
+ * Pool of worker threads touching one batch of paths.
+ */
+struct touch_pool{
+  /**
+   * Paths to touch.
+   */
+  const char *const *paths;
+
+  /**
+   * Take paths from this ring instead of @ref paths if not NULL.
+   */
+  struct touch_ring *ring;
+
+  /**
+   * Function used by the workers to touch each path.
+   */
+  void (*fn)(struct touch *const touch, const char *const path);
+
+  /**
+   * Number of workers in @ref workers.
+   */
+  size_t num_workers;
+
+  /**
+   * Worker list.
+   */
+  struct touch_worker *workers;
+};
+
+/**
+ * Targets counted on one filesystem (--plan).
+ */
+struct touch_plan_fs{
+  /**
+   * Device ID of the filesystem.
+   */
+  dev_t dev;
+
+  /**
+   * Number of parent directories seen on the filesystem, which counts a
+   * directory again each time it comes back after a target in another
+   * directory.
+   */
+  unsigned long dirs;
+
+  /**
+   * Number of targets in each class, indexed by TOUCH_PLAN_CREATE through
+   * TOUCH_PLAN_ERROR.
+   */
+  unsigned long targets[TOUCH_PLAN_NUM];
+};
+
+/**
+ * Targets counted by --plan, shared by the main context and all worker
+ * threads.
+ */
+struct touch_plan{
+  /**
+   * Protects all other members.
+   */
+  pthread_mutex_t mutex;
+
+  /**
+   * Filesystems seen so far, followed by one more entry counting the
+   * targets on any other filesystem or with an unknown parent directory.
+   */
+  struct touch_plan_fs fs[TOUCH_PLAN_FS_SZ + 1];
+
+  /**
+   * Number of filesystems seen in @ref fs.
+   */
+  size_t num_fs;
+
+  /**
+   * Sum of the sampled lookup latencies in nanoseconds.
+   */
+  unsigned long sample_ns;
+
+  /**
+   * Number of sampled lookups in @ref sample_ns.
+   */
+  unsigned long samples;
+};
+
+/**
+ * Operation limits shared by all threads (--max-rate, --target-latency).
+ *
+ * The rate limit hands out start times spaced @ref interval_ns apart, so
+ * each operation waits for its own slot without any lock. The latency target
+ * averages the utimensat() latencies over each window, halves the number
+ * of running workers when the average exceeds the target, and adds one
+ * worker back otherwise. Paused workers leave their paths to be stolen by
+ * the running workers, and the first worker never pauses.
+ */
+struct touch_limit{
+  /**
+   * Nanoseconds between the start of each operation, or 0 for no rate
+   * limit.
+   */
+  unsigned long interval_ns;
+
+  /**
+   * See @ref touch::target_latency_ns.
+   */
+  unsigned long target_ns;
+
+  /**
+   * Monotonic time when the next operation may start.
+   */
+  unsigned long next_ns;
+
+  /**
+   * Monotonic time when the current latency window started.
+   */
+  unsigned long window_ns;
+
+  /**
+   * Sum of the utimensat() latencies in the current window.
+   */
+  unsigned long window_sum;
+
+  /**
+   * Number of utimensat() calls in the current window.
+   */
+  unsigned long window_ops;
+
+  /**
+   * Maximum number of running workers, from -j.
+   */
+  size_t max_workers;
+
+  /**
+   * Number of workers currently allowed to run, between 1 and
+   * @ref max_workers.
+   */
+  size_t workers;
+};
+
+/**
+ * Progress reporter thread (--progress).
+ *
+ * The reporter reads the counters of the main context and of each worker in
+ * the running pool at a fixed interval. Each counter only gets written by
+ * its own thread, so the hot path keeps using plain increments and the
+ * reporter reads each counter with a relaxed atomic load.
+ */
+struct touch_progress{
+  /**
+   * Protects @ref pool and @ref stop.
+   */
+  pthread_mutex_t mutex;
+
+  /**
+   * Signaled when the reporter should stop.
+   */
+  pthread_cond_t cond;
+
+  /**
+   * Reporter thread.
+   */
+  pthread_t thread;
+
+  /**
+   * Main context.
+   */
+  const struct touch *touch;
+
+  /**
+   * Worker pool currently running, or NULL if none.
+   */
+  struct touch_pool *pool;
+
+  /**
+   * Monotonic time when the reporter started.
+   */
+  unsigned long start_ns;
+
+  /**
+   * Monotonic time of the previous report.
+   */
+  unsigned long last_ns;
+
+  /**
+   * Number of targets done at the previous report.
+   */
+  unsigned long last_done;
+
+  /**
+   * Set when the reporter should stop.
+   */
+  bool stop;
+};
+
+/**
+ * Get the slot used for an errno value in the counter arrays.
+ *
+ * @param[in] errnum Value of errno.
+ * @return           Index less than @ref TOUCH_STATS_ERRNO_SZ.
+ */
+static size_t
+touch_errno_slot(const int errnum){
+  size_t slot;
+
+  slot = TOUCH_STATS_ERRNO_SZ - 1;
+  if(errnum >= 0 && errnum < TOUCH_STATS_ERRNO_SZ){
+    slot = (size_t)errnum;
+  }
+  return slot;
+}
+
+/**
+ * Write all of the buffered error messages to STDERR.
+ *
+ * @param[in,out] errlog See @ref touch_errlog.
+ */
+static void
+touch_errlog_flush(struct touch_errlog *const errlog){
+  ssize_t bytes_written;
+  size_t pos;
+
+  pos = 0;
+  while(pos < errlog->len){
+    bytes_written = write(STDERR_FILENO, &errlog->buf[pos], errlog->len - pos);
+    if(bytes_written > 0){
+      pos += (size_t)bytes_written;
+    }
+    else if(bytes_written < 0 && errno == EINTR){
+      /* Try again. */
+    }
+    else{
+      pos = errlog->len;
+    }
+  }
+  errlog->len = 0;
+}
+
+/**
+ * Append a line to the buffered error messages in the same format used by
+ * warn() and warnx(), writing the buffer first if it might not fit.
+ *
+ * @param[in,out] errlog See @ref touch_errlog.
+ * @param[in]     errnum Value of errno to describe, or 0 if none.
+ * @param[in]     msg    Formatted message.
+ */
+static void
+touch_errlog_append(struct touch_errlog *const errlog,
+                    const int errnum,
+                    const char *const msg){
+  size_t avail;
+  int len;
+
+  if(TOUCH_ERRLOG_SZ - errlog->len < TOUCH_ERRLOG_LINE_SZ){
+    touch_errlog_flush(errlog);
+  }
+  avail = TOUCH_ERRLOG_SZ - errlog->len;
+  len = snprintf(&errlog->buf[errlog->len],
+                 avail,
+                 "%s: %s%s%s\n",
+                 program_invocation_short_name,
+                 msg,
+                 errnum ? ": " : "",
+                 errnum ? strerror(errnum) : "");
+  if(len < 0){
+    /* Failed to format the message. */
+  }
+  else if((size_t)len >= avail){
+    errlog->buf[TOUCH_ERRLOG_SZ - 1] = '\n';
+    errlog->len = TOUCH_ERRLOG_SZ;
+  }
+  else{
+    errlog->len += (size_t)len;
+  }
+}
+
+/**
+ * Save an error message to get printed later, applying --max-errors and
+ * --collapse-errors.
+ *
+ * Messages get printed right away if @ref touch::errlog has not been set
+ * up.
+ *
+ * @param[in,out] touch  See @ref touch.
+ * @param[in]     errnum Value of errno to describe, or 0 if none.
+ * @param[in]     msg    Formatted message.
+ */
+static void
+touch_errlog_add(struct touch *const touch,
+                 const int errnum,
+                 const char *const msg){
+  struct touch_errlog *errlog;
+  size_t slot;
+
+  errlog = touch->errlog;
+  slot = touch_errno_slot(errnum);
+  if(errlog == NULL){
+    if(errnum){
+      errno = errnum;
+      warn("%s", msg);
+    }
+    else{
+      warnx("%s", msg);
+    }
+  }
+  else if(errnum && (touch->flags & TOUCH_FLAG_COLLAPSE) && errlog->seen[slot]){
+    errlog->repeats[slot] += 1;
+  }
+  else if(touch->max_errors && errlog->num_shown >= touch->max_errors){
+    errlog->dropped += 1;
+  }
+  else{
+    if(errnum){
+      errlog->seen[slot] = true;
+    }
+    errlog->num_shown += 1;
+    touch_errlog_append(errlog, errnum, msg);
+  }
+}
+
+/**
+ * Write the buffered error messages followed by a count of the messages
+ * that did not get shown.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_errlog_finish(struct touch *const touch){
+  struct touch_errlog *errlog;
+  char msg[100];
+  int errnum;
+
+  errlog = touch->errlog;
+  if(errlog){
+    for(errnum = 0; errnum < TOUCH_STATS_ERRNO_SZ; errnum++){
+      if(errlog->repeats[errnum]){
+        sprintf(msg, "%lu more errors like the above", errlog->repeats[errnum]);
+        touch_errlog_append(errlog, errnum, msg);
+        errlog->repeats[errnum] = 0;
+      }
+    }
+    if(errlog->dropped){
+      sprintf(msg, "%lu more errors not shown", errlog->dropped);
+      touch_errlog_append(errlog, 0, msg);
+      errlog->dropped = 0;
+    }
+    touch_errlog_flush(errlog);
+  }
+}
+
+/**
+ * Compare two saved error messages by path order.
+ *
+ * @param[in] a  First message.
+ * @param[in] b  Second message.
+ * @retval    <0 @p a goes before @p b.
+ * @retval    >0 @p a goes after @p b.
+ * @retval    0  Same position.
+ */
+static int
+touch_diag_cmp(const void *const a,
+               const void *const b){
+  const struct touch_diag *diag_a;
+  const struct touch_diag *diag_b;
+  int cmp;
+
+  diag_a = a;
+  diag_b = b;
+  if(diag_a->path_index != diag_b->path_index){
+    cmp = diag_a->path_index < diag_b->path_index ? -1 : 1;
+  }
+  else if(diag_a->seq != diag_b->seq){
+    cmp = diag_a->seq < diag_b->seq ? -1 : 1;
+  }
+  else{
+    cmp = 0;
+  }
+  return cmp;
+}
+
+/**
+ * Find the saved message with the last path in a worker that counts
+ * against --max-errors.
+ *
+ * @param[in] worker See @ref touch_worker.
+ * @return           Saved message, or NULL if none.
+ */
+static struct touch_diag *
+touch_diag_last(struct touch_worker *const worker){
+  struct touch_diag *last;
+  size_t i;
+
+  last = NULL;
+  for(i = 0; i < worker->diag_len; i++){
+    if(worker->diag[i].errnum &&
+       (worker->touch.flags & TOUCH_FLAG_COLLAPSE)){
+      /* Limited by --collapse-errors instead. */
+    }
+    else if(last == NULL || touch_diag_cmp(&worker->diag[i], last) > 0){
+      last = &worker->diag[i];
+    }
+  }
+  return last;
+}
+
+/**
+ * Save an error message in a worker so it can get printed later.
+ *
+ * Workers can touch paths out of order after stealing from the back of
+ * the other queues, so a message replaces a saved message for a later
+ * path instead of getting discarded when it would be printed before it.
+ *
+ * @param[in,out] worker See @ref touch_worker.
+ * @param[in]     errnum Value of errno to describe, or 0 if none.
+ * @param[in]     fmt    Format string used by vsnprintf.
+ * @param[in]     ap     Format arguments.
+ */
+static void
+touch_diag_save(struct touch_worker *const worker,
+                const int errnum,
+                const char *const fmt,
+                va_list ap){
+  struct touch_diag *diag;
+  char msg[PATH_MAX + 100];
+  char *copy;
+  size_t diag_sz;
+  size_t slot;
+  bool collapse;
+  bool append;
+
+  slot = touch_errno_slot(errnum);
+  collapse = (errnum && (worker->touch.flags & TOUCH_FLAG_COLLAPSE));
+  diag = NULL;
+  append = false;
+  if(collapse && worker->diag_seen[slot]){
+    worker->diag_repeats[slot] += 1;
+    diag = &worker->diag[worker->diag_first[slot]];
+  }
+  else if(!collapse &&
+          worker->touch.max_errors &&
+          worker->diag_limited >= worker->touch.max_errors){
+    worker->diag_dropped += 1;
+    diag = touch_diag_last(worker);
+  }
+  else{
+    if(worker->diag_len == worker->diag_sz){
+      diag_sz = worker->diag_sz * 2 + 16;
+      diag = realloc(worker->diag, diag_sz * sizeof(*diag));
+      if(diag){
+        worker->diag = diag;
+        worker->diag_sz = diag_sz;
+      }
+    }
+    diag = NULL;
+    if(worker->diag_len < worker->diag_sz){
+      diag = &worker->diag[worker->diag_len];
+      diag->msg = NULL;
+      append = true;
+    }
+  }
+  if(diag && !append && diag->path_index <= worker->touch.path_index){
+    /* Saved message gets printed first. */
+  }
+  else if(diag){
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    copy = strdup(msg);
+    if(copy){
+      free(diag->msg);
+      diag->msg = copy;
+      diag->path_index = worker->touch.path_index;
+      diag->seq = worker->diag_seq++;
+      diag->errnum = errnum;
+      if(append){
+        worker->diag_len += 1;
+        worker->diag_limited += !collapse;
+      }
+      if(collapse){
+        worker->diag_seen[slot] = true;
+        worker->diag_first[slot] = (size_t)(diag - worker->diag);
+      }
+    }
+  }
+}
+
+/**
+ * Print an error message to STDERR and set an error status code.
+ *
+ * Worker threads save the message instead so that all messages get printed
+ * in path order after the workers finish. Otherwise the message gets saved
+ * in @ref touch::errlog if available.
+ *
+ * @param[in,out] touch     See @ref touch.
+ * @param[in]     errno_msg Include a standard message describing errno.
+ * @param[in]     fmt       Format string used by vwarnx.
+ */
+static void
+touch_warn(struct touch *const touch,
+            const bool errno_msg,
+            const char *const fmt, ...){
+  va_list ap;
+  char msg[PATH_MAX + 100];
+  int errnum;
+
+  errnum = errno;
+  touch->status_code = EXIT_FAILURE;
+  touch->stats.errors += 1;
+  if(errno_msg){
+    touch->stats.errnos[touch_errno_slot(errnum)] += 1;
+  }
+  va_start(ap, fmt);
+  if(touch->worker){
+    touch_diag_save(touch->worker, errno_msg ? errnum : 0, fmt, ap);
+  }
+  else if(touch->errlog){
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    touch_errlog_add(touch, errno_msg ? errnum : 0, msg);
+  }
+  else if(errno_msg){
+    vwarn(fmt, ap);
+  }
+  else{
+    vwarnx(fmt, ap);
+  }
+  va_end(ap);
+}
+
+/**
+ * Get the current monotonic time.
+ *
+ * @return Monotonic time in nanoseconds, or 0 if not available.
+ */
+static unsigned long
+touch_clock_ns(void){
+  struct timespec ts;
+  unsigned long ns;
+
+  ns = 0;
+  if(clock_gettime(CLOCK_MONOTONIC, &ts) == 0){
+    ns = (unsigned long)ts.tv_sec * 1000000000UL + (unsigned long)ts.tv_nsec;
+  }
+  return ns;
+}
+
+/**
+ * Sleep for a number of nanoseconds, continuing after signals.
+ *
+ * @param[in] ns Nanoseconds to sleep.
+ */
+static void
+touch_sleep_ns(const unsigned long ns){
+  struct timespec ts;
+  int rc;
+
+  ts.tv_sec = (time_t)(ns / 1000000000UL);
+  ts.tv_nsec = (long)(ns % 1000000000UL);
+  do{
+    rc = nanosleep(&ts, &ts);
+  } while(rc != 0 && errno == EINTR);
+}
+
+/**
+ * Wait for the next slot allowed by the rate limit (--max-rate).
+ *
+ * Each caller claims the next start time with a compare and swap, and then
+ * sleeps until that time. Slots missed while idle do not get saved up, so
+ * the rate never goes over the limit after a pause.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_limit_wait(struct touch *const touch){
+  struct touch_limit *limit;
+  unsigned long start;
+  unsigned long next;
+  unsigned long now;
+  bool claimed;
+
+  limit = touch->limit;
+  if(limit && limit->interval_ns){
+    now = touch_clock_ns();
+    next = __atomic_load_n(&limit->next_ns, __ATOMIC_RELAXED);
+    do{
+      start = (next > now) ? next : now;
+      claimed = __atomic_compare_exchange_n(&limit->next_ns,
+                                            &next,
+                                            start + limit->interval_ns,
+                                            false,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED);
+    } while(!claimed);
+    if(start > now){
+      touch_sleep_ns(start - now);
+    }
+  }
+}
+
+/**
+ * Record the latency of a utimensat() call, and adjust the number of
+ * running workers at the end of each window (--target-latency).
+ *
+ * @param[in,out] limit See @ref touch_limit.
+ * @param[in]     start Monotonic time before the call.
+ */
+static void
+touch_limit_record(struct touch_limit *const limit,
+                   const unsigned long start){
+  unsigned long window;
+  unsigned long now;
+  unsigned long sum;
+  unsigned long ops;
+  size_t workers;
+  bool adjust;
+
+  now = touch_clock_ns();
+  __atomic_add_fetch(&limit->window_sum, now - start, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&limit->window_ops, 1, __ATOMIC_RELAXED);
+  window = __atomic_load_n(&limit->window_ns, __ATOMIC_RELAXED);
+  adjust = false;
+  if(now - window >= TOUCH_LIMIT_WINDOW_NS){
+    adjust = __atomic_compare_exchange_n(&limit->window_ns,
+                                         &window,
+                                         now,
+                                         false,
+                                         __ATOMIC_RELAXED,
+                                         __ATOMIC_RELAXED);
+  }
+  if(adjust){
+    sum = __atomic_exchange_n(&limit->window_sum, 0, __ATOMIC_RELAXED);
+    ops = __atomic_exchange_n(&limit->window_ops, 0, __ATOMIC_RELAXED);
+    workers = __atomic_load_n(&limit->workers, __ATOMIC_RELAXED);
+    if(ops == 0){
+      /* Calls got counted in the next window. */
+    }
+    else if(sum / ops > limit->target_ns){
+      workers = (workers + 1) / 2;
+    }
+    else if(workers < limit->max_workers){
+      workers += 1;
+    }
+    __atomic_store_n(&limit->workers, workers, __ATOMIC_RELAXED);
+  }
+}
+
+/**
+ * Check whether a worker should pause to stay under the latency target
+ * (--target-latency).
+ *
+ * @param[in] touch  See @ref touch.
+ * @param[in] self   Index of the worker in its pool.
+ * @retval    true   Worker should pause.
+ * @retval    false  Worker can keep running.
+ */
+static bool
+touch_limit_paused(const struct touch *const touch,
+                   const size_t self){
+  return (touch->limit &&
+          touch->limit->target_ns &&
+          self >= __atomic_load_n(&touch->limit->workers, __ATOMIC_RELAXED));
+}
+
+/**
+ * Get the current monotonic time if measuring times for --stats.
+ *
+ * The difference between two calls gets added to the @ref touch_stats
+ * times, which stay at 0 when not measuring.
+ *
+ * @param[in] touch See @ref touch.
+ * @return          Monotonic time in nanoseconds, or 0 if not measuring.
+ */
+static unsigned long
+touch_stats_clock(const struct touch *const touch){
+  return (touch->flags & TOUCH_FLAG_STATS) ? touch_clock_ns() : 0;
+}
+
+/**
+ * Convert a UTC civil date and time to seconds since the Epoch.
+ *
+ * Uses the days from civil algorithm for the proleptic Gregorian calendar,
+ * so out of range fields such as a 60th second carry over the same way as
+ * mktime().
+ *
+ * @param[in] tm Broken-down UTC time.
+ * @return       Seconds since the Epoch.
+ */
+static time_t
+touch_civil_to_epoch(const struct tm *const tm){
+  long year;
+  long mon;
+  long era;
+  long yoe;
+  long doy;
+  long days;
+
+  year = (long)tm->tm_year + 1900;
+  mon = (long)tm->tm_mon + 1;
+  if(mon <= 2){
+    year -= 1;
+  }
+  era = (year >= 0 ? year : year - 399) / 400;
+  yoe = year - era * 400;
+  doy = (153 * (mon > 2 ? mon - 3 : mon + 9) + 2) / 5 + tm->tm_mday - 1;
+  days = era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+  return (time_t)(days * 86400L +
+                  tm->tm_hour * 3600L +
+                  tm->tm_min * 60L +
+                  tm->tm_sec);
+}
+
+/**
+ * Get the offset of local time from UTC, reading the time zone the first
+ * time it gets used.
+ *
+ * The offsets at both ends of the @ref TOUCH_TZ_BUCKET_SEC interval
+ * containing @p t get cached if they match, so converting many times
+ * close to each other only costs integer math.
+ *
+ * @param[in,out] touch  See @ref touch.
+ * @param[in]     t      Seconds since the Epoch.
+ * @param[out]    gmtoff Seconds east of UTC at @p t.
+ * @retval        true   Found the offset.
+ * @retval        false  Failed to convert @p t to local time.
+ */
+static bool
+touch_tz_offset(struct touch *const touch,
+                const time_t t,
+                long *const gmtoff){
+  struct tm tm;
+  time_t edge;
+  long bucket;
+  long gmtoff_start;
+  bool success;
+
+  gmtoff_start = 0;
+  bucket = (long)t / TOUCH_TZ_BUCKET_SEC;
+  if((long)t % TOUCH_TZ_BUCKET_SEC < 0){
+    bucket -= 1;
+  }
+  if(!touch->tz.loaded){
+    tzset();
+    touch->tz.loaded = true;
+  }
+  success = true;
+  if(!touch->tz.valid || touch->tz.bucket != bucket){
+    edge = (time_t)(bucket * TOUCH_TZ_BUCKET_SEC);
+    success = (localtime_r(&edge, &tm) != NULL);
+    if(success){
+      gmtoff_start = tm.tm_gmtoff;
+      edge += TOUCH_TZ_BUCKET_SEC - 1;
+      success = (localtime_r(&edge, &tm) != NULL);
+    }
+    touch->tz.bucket = bucket;
+    touch->tz.gmtoff = success ? tm.tm_gmtoff : 0;
+    touch->tz.valid = success && gmtoff_start == tm.tm_gmtoff;
+  }
+  if(!success){
+    touch_warn(touch, true, "localtime");
+  }
+  else if(touch->tz.valid){
+    *gmtoff = touch->tz.gmtoff;
+  }
+  else if(localtime_r(&t, &tm) == NULL){
+    touch_warn(touch, true, "localtime");
+    success = false;
+  }
+  else{
+    *gmtoff = tm.tm_gmtoff;
+  }
+  return success;
+}
+
+/**
+ * Convert a local civil date and time to seconds since the Epoch.
+ *
+ * Local times skipped by a daylight saving transition get moved forward by
+ * the length of the transition, and repeated local times use the first
+ * occurrence.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     tm    Broken-down local time.
+ * @param[out]    t     Seconds since the Epoch.
+ * @retval        true  Converted the local time.
+ * @retval        false Failed to find the local time zone offset.
+ */
+static bool
+touch_local_to_epoch(struct touch *const touch,
+                     const struct tm *const tm,
+                     time_t *const t){
+  time_t utc;
+  long gmtoff;
+  long gmtoff_t;
+  long gmtoff_retry;
+  bool success;
+
+  utc = touch_civil_to_epoch(tm);
+  success = touch_tz_offset(touch, utc, &gmtoff);
+  if(success){
+    *t = utc - gmtoff;
+    success = touch_tz_offset(touch, *t, &gmtoff_t);
+  }
+  if(success && gmtoff_t != gmtoff){
+    /* Use the other offset unless the local time does not exist. */
+    success = touch_tz_offset(touch, utc - gmtoff_t, &gmtoff_retry);
+    if(success && gmtoff_retry == gmtoff_t){
+      *t = utc - gmtoff_t;
+    }
+  }
+  return success;
+}
+
+/**
+ * Parse the frac part of a date_time string.
+ *
+ * The digits get accumulated directly into nanoseconds, so the result is
+ * exact and any digits past nanoseconds get truncated.
+ *
+ * @param[in,out] touch      See @ref touch.
+ * @param[in,out] time_parse Pointer to next character in parse string. This
+ *                           pointer will get updated to point to the last
+ *                           character after the frac.
+ * @param[out]    tv_nsec    Nanoseconds, left unchanged if the string does
+ *                           not have a frac.
+ * @retval        true       Parsed the frac or no frac present.
+ * @retval        false      Frac does not have any digits.
+ */
+static bool
+touch_parse_frac(struct touch *const touch,
+                 const char **time_parse,
+                 long *const tv_nsec){
+  const char *frac;
+  size_t i;
+  long nsec;
+  bool success;
+
+  success = true;
+  if(**time_parse == '.' || **time_parse == ','){
+    frac = *time_parse + 1;
+    nsec = 0;
+    for(i = 0;
+        i < MAX_FRAC_CHAR_LEN - 1 && isdigit((unsigned char)frac[i]);
+        i++){
+      if(i < TOUCH_NSEC_DIGITS){
+        nsec = nsec * 10 + (frac[i] - '0');
+      }
+    }
+    if(i == 0){
+      touch_warn(touch, false, "failed to parse frac");
+      success = false;
+    }
+    else{
+      *time_parse = &frac[i];
+      for(; i < TOUCH_NSEC_DIGITS; i++){
+        nsec *= 10;
+      }
+      *tv_nsec = nsec;
+    }
+  }
+  return success;
+}
+
+/**
+ * Layout of the fixed-width part of a date time string, with '0' marking
+ * each digit.
+ */
+static const char TOUCH_DATE_TIME_LAYOUT[] = "0000-00-00T00:00:00";
+
+/**
+ * Byte mask of the separators in @ref TOUCH_DATE_TIME_LAYOUT.
+ *
+ * The time indicator at position 10 gets checked by the caller since it can
+ * hold either 'T' or ' '.
+ */
+static const char TOUCH_DATE_TIME_SEP_MASK[] =
+  "\0\0\0\0\377\0\0\377\0\0\0\0\0\377\0\0\377\0\0";
+
+/**
+ * Byte mask of the high bit in each digit of @ref TOUCH_DATE_TIME_LAYOUT.
+ */
+static const char TOUCH_DATE_TIME_DIGIT_MASK[] =
+  "\200\200\200\200\0\200\200\0\200\200\0\200\200\0\200\200\0\200\200";
+
+/**
+ * Check eight bytes of a date time string against the fixed layout.
+ *
+ * The whole word gets checked at once: each byte gets biased so that any
+ * byte outside of '0' - '9' sets its high bit, and the separators get
+ * compared with an exclusive or.
+ *
+ * @param[in] date_time_str Date time string.
+ * @param[in] off           Offset of the word in the layout.
+ * @return                  Zero if the word matches the layout.
+ */
+static uint64_t
+touch_date_time_word(const char *const date_time_str,
+                     const size_t off){
+  const uint64_t ONES = UINT64_MAX / 0xff;
+  uint64_t word;
+  uint64_t layout;
+  uint64_t sep;
+  uint64_t digit;
+  uint64_t zeroed;
+
+  memcpy(&word, &date_time_str[off], sizeof(word));
+  memcpy(&layout, &TOUCH_DATE_TIME_LAYOUT[off], sizeof(layout));
+  memcpy(&sep, &TOUCH_DATE_TIME_SEP_MASK[off], sizeof(sep));
+  memcpy(&digit, &TOUCH_DATE_TIME_DIGIT_MASK[off], sizeof(digit));
+  zeroed = word ^ (ONES * '0');
+  return ((word ^ layout) & sep) |
+         ((((zeroed & (ONES * 0x7f)) + ONES * (0x80 - 10)) | zeroed) & digit);
+}
+
+/**
+ * Convert two digits to a number.
+ *
+ * @param[in] digits Two digits.
+ * @return           Value of the digits.
+ */
+static int
+touch_date_time_2digit(const char *const digits){
+  return (digits[0] - '0') * 10 + (digits[1] - '0');
+}
+
+/**
+ * Parse a date time string in the common fixed layout without strptime().
+ *
+ * Only handles strings that match the layout exactly, and only with field
+ * values that strptime() also accepts, so anything else can fall back to
+ * @ref touch_date_time_parse and produce the same result.
+ *
+ * @param[in]  date_time_str See @ref touch_date_time_to_ts, which must be
+ *                           at least 19 characters long.
+ * @param[in]  slen          Length of @p date_time_str.
+ * @param[out] tm            Broken-down time, left unchanged on failure.
+ * @param[out] tv_nsec       Nanoseconds, left unchanged on failure.
+ * @param[out] utc           Set if the string ends with the 'Z' time zone.
+ * @retval     true          Parsed the date time string.
+ * @retval     false         Irregular date time string.
+ */
+static bool
+touch_date_time_fast(const char *const date_time_str,
+                     const size_t slen,
+                     struct tm *const tm,
+                     long *const tv_nsec,
+                     bool *const utc){
+  /*
+   * YYYY-MM-DDThh:mm:SS[.frac][tz]
+   *                    ^
+   * 01234567890123456789
+   *          10        20
+   */
+  const size_t FRAC_POS = 19;
+  struct tm tm_fast;
+  size_t end;
+  size_t i;
+  long nsec;
+  bool success;
+
+  success = (touch_date_time_word(date_time_str, 0) |
+             touch_date_time_word(date_time_str, 8) |
+             touch_date_time_word(date_time_str, FRAC_POS - 8)) == 0;
+  end = slen;
+  if(success && date_time_str[end - 1] == 'Z'){
+    end -= 1;
+  }
+  nsec = 0;
+  if(success && end > FRAC_POS){
+    success = (date_time_str[FRAC_POS] == '.' ||
+               date_time_str[FRAC_POS] == ',') &&
+              end - FRAC_POS - 1 > 0 &&
+              end - FRAC_POS - 1 <= MAX_FRAC_CHAR_LEN - 1;
+    for(i = FRAC_POS + 1; success && i < end; i++){
+      success = date_time_str[i] >= '0' && date_time_str[i] <= '9';
+      if(i - FRAC_POS <= TOUCH_NSEC_DIGITS){
+        nsec = nsec * 10 + (date_time_str[i] - '0');
+      }
+    }
+    for(i = end - FRAC_POS - 1; i < TOUCH_NSEC_DIGITS; i++){
+      nsec *= 10;
+    }
+  }
+  if(success){
+    tm_fast = *tm;
+    tm_fast.tm_year = touch_date_time_2digit(&date_time_str[0]) * 100 +
+                      touch_date_time_2digit(&date_time_str[2]) - 1900;
+    tm_fast.tm_mon = touch_date_time_2digit(&date_time_str[5]) - 1;
+    tm_fast.tm_mday = touch_date_time_2digit(&date_time_str[8]);
+    tm_fast.tm_hour = touch_date_time_2digit(&date_time_str[11]);
+    tm_fast.tm_min = touch_date_time_2digit(&date_time_str[14]);
+    tm_fast.tm_sec = touch_date_time_2digit(&date_time_str[17]);
+    success = tm_fast.tm_mon >= 0 && tm_fast.tm_mon < 12 &&
+              tm_fast.tm_mday >= 1 && tm_fast.tm_mday <= 31 &&
+              tm_fast.tm_hour < 24 &&
+              tm_fast.tm_min < 60 &&
+              tm_fast.tm_sec < 60;
+  }
+  if(success){
+    *tm = tm_fast;
+    *tv_nsec = nsec;
+    *utc = (end != slen);
+  }
+  return success;
+}
+
+/**
+ * Parse a date time string with strptime().
+ *
+ * @param[in,out] touch         See @ref touch.
+ * @param[in]     date_time_str See @ref touch_date_time_to_ts.
+ * @param[out]    tm            Broken-down time.
+ * @param[out]    tv_nsec       Nanoseconds.
+ * @param[out]    utc           Set if the string ends with the 'Z' time
+ *                              zone.
+ * @retval        true          Parsed the date time string.
+ * @retval        false         Invalid date time string.
+ */
+static bool
+touch_date_time_parse(struct touch *const touch,
+                      const char *const date_time_str,
+                      struct tm *const tm,
+                      long *const tv_nsec,
+                      bool *const utc){
+  /*
+   * YYYY-MM-DDThh:mm:SS[.frac][tz]
+   *           ^
+   * 01234567890
+   *          10
+   */
+  const size_t DATE_TIME_T_POS = 10;
+  char fmt[MAX_DATE_TIME_FMT_LEN];
+  const char *time_parse;
+  bool success;
+
+  success = false;
+  /*
+   * Set the position of the time indicator in the format string.
+   *           012345678
+   *           ||||||||| */
+  strcpy(fmt, "%Y-%m-%d %T");
+  fmt[8] = date_time_str[DATE_TIME_T_POS];
+  time_parse = strptime(date_time_str, fmt, tm);
+  if(time_parse == NULL){
+    touch_warn(touch, true, "failed to parse date_time");
+  }
+  else{
+    success = touch_parse_frac(touch, &time_parse, tv_nsec);
+    *utc = (success && *time_parse == 'Z');
+    if(*utc){
+      time_parse += 1;
+    }
+    if(!success || *time_parse != '\0'){
+      touch_warn(touch, false, "failed to parse date_time");
+      success = false;
+    }
+  }
+  return success;
+}
+
+/**
+ * Convert a date time string in the following format to a timestamp.
+ *
+ * YYYY-MM-DDThh:mm:SS[[.|,]frac][tz]
+ *
+ * frac = nanoseconds
+ * tz = blank or Z
+ *
+ * @param[in,out] touch         See @ref touch.
+ * @param[in]     date_time_str String with the format described above.
+ * @param[out]    ts            Converted timestamp.
+ * @retval        true          Converted the date time string.
+ * @retval        false         Invalid date time string.
+ */
+static bool
+touch_date_time_to_ts(struct touch *const touch,
+                      const char *const date_time_str,
+                      struct timespec *const ts){
+  /*
+   * YYYY-MM-DDThh:mm:SS
+   * 1234567890123456789
+   *         10       19
+   */
+  const size_t MIN_DATE_TIME = 19;
+  /*
+   * frac = maximum length for long type (nanoseconds)
+   * YYYY-MM-DDThh:mm:SS,fracZ
+   * 12345678901234567890 + MAX_FRAC_CHAR_LEN + 1
+   *         10        20 + MAX_FRAC_CHAR_LEN + 1
+   */
+  const size_t MAX_DATE_TIME = 20 + MAX_FRAC_CHAR_LEN + 1;
+  /*
+   * YYYY-MM-DDThh:mm:SS[.frac][tz]
+   *           ^
+   * 01234567890
+   *          10
+   */
+  const size_t DATE_TIME_T_POS = 10;
+  struct tm tm = {0};
+  size_t slen;
+  bool success;
+  bool utc;
+
+  success = false;
+  ts->tv_nsec = 0;
+  slen = strlen(date_time_str);
+  if(slen < MIN_DATE_TIME ||
+     slen >= MAX_DATE_TIME ||
+     (date_time_str[DATE_TIME_T_POS] != 'T' &&
+      date_time_str[DATE_TIME_T_POS] != ' ')){
+    touch_warn(touch, false, "invalid date_time");
+  }
+  else{
+    success = TOUCH_DATE_TIME_FAST &&
+              touch_date_time_fast(date_time_str,
+                                   slen,
+                                   &tm,
+                                   &ts->tv_nsec,
+                                   &utc);
+    if(!success){
+      success = touch_date_time_parse(touch,
+                                      date_time_str,
+                                      &tm,
+                                      &ts->tv_nsec,
+                                      &utc);
+    }
+    if(!success){
+      /* Already warned. */
+    }
+    else if(utc){
+      ts->tv_sec = touch_civil_to_epoch(&tm);
+    }
+    else{
+      success = touch_local_to_epoch(touch, &tm, &ts->tv_sec);
+    }
+  }
+  return success;
+}
+
+/**
+ * Parse a date time string [-d date_string].
+ *
+ * @param[in,out] touch         See @ref touch.
+ * @param[in]     date_time_str See @ref touch_date_time_to_ts.
+ */
+static void
+touch_parse_date_time(struct touch *const touch,
+                      const char *const date_time_str){
+  struct timespec ts;
+
+  if(touch_date_time_to_ts(touch, date_time_str, &ts)){
+    touch->time_am[0] = ts;
+    touch->time_am[1] = ts;
+  }
+}
+
+/**
+ * Parse a time string [-t time] in the following format.
+ *
+ * [[CC]YY]MMDDhhmm[.SS]
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in]     time_str String with the format described above.
+ */
+static void
+touch_parse_time(struct touch *const touch,
+                 const char *const time_str){
+  /*
+   * MMDDhhmm
+   * 12345678
+   *        8
+   */
+  const size_t MIN_TIME_LEN = 8;
+  /*
+   * CCYYMMDDhhmm.SS
+   * 123456789012345
+   *         10   15
+   */
+  const size_t MAX_TIME_LEN = 15;
+  struct tm tm;
+  char fmt[MAX_TIME_FMT_LEN];
+  size_t slen;
+  size_t slen_minus_sec;
+  const char *time_parse;
+  char *fmt_append;
+  bool has_dot;
+  time_t tv_sec;
+
+  fmt[0] = '\0';
+  memset(&tm, 0, sizeof(tm));
+
+  slen = strlen(time_str);
+  if(slen < MIN_TIME_LEN || slen > MAX_TIME_LEN){
+    touch_warn(touch, false, "invalid time string");
+  }
+  else{
+    slen_minus_sec = slen;
+    if(strchr(time_str, '.')){
+      has_dot = true;
+      slen_minus_sec -= 3;
+    }
+    else{
+      has_dot = false;
+    }
+    fmt_append = fmt;
+    if(slen_minus_sec == 12){
+      fmt_append = stpcpy(fmt_append, "%C");
+    }
+    if(slen_minus_sec >= 10){
+      fmt_append = stpcpy(fmt_append, "%y");
+    }
+    fmt_append = stpcpy(fmt_append, "%m%d%H%M");
+    if(has_dot){
+      stpcpy(fmt_append, ".%S");
+    }
+    time_parse = strptime(time_str, fmt, &tm);
+    if(time_parse == NULL || *time_parse != '\0'){
+      touch_warn(touch, true, "invalid time string");
+    }
+    else if(touch_local_to_epoch(touch, &tm, &tv_sec)){
+      touch->time_am[0].tv_sec = tv_sec;
+      touch->time_am[1].tv_sec = tv_sec;
+    }
+  }
+}
+
+/**
+ * Get the access/modification time of an existing reference file.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     path  Path to reference file.
+ */
+static void
+touch_get_time_ref_file(struct touch *const touch,
+                        const char *const path){
+  struct stat sb;
+
+  if(stat(path, &sb) < 0){
+    touch_warn(touch, true, "stat reference file: %s", path);
+  }
+  else{
+    touch->time_am[0] = sb.st_atim;
+    touch->time_am[1] = sb.st_mtim;
+  }
+}
+
+/**
+ * Close all cached directories and empty the cache.
+ *
+ * @param[in,out] dircache See @ref touch_dircache. Can be NULL.
+ */
+static void
+touch_dircache_reset(struct touch_dircache *const dircache){
+  size_t i;
+
+  if(dircache){
+    dircache->clock = 0;
+    for(i = 0; i < TOUCH_DIRCACHE_SZ; i++){
+      if(dircache->entries[i].fd >= 0){
+        close(dircache->entries[i].fd);
+      }
+      dircache->entries[i].len = 0;
+      dircache->entries[i].fd = -1;
+      dircache->entries[i].tried = false;
+      dircache->entries[i].used = 0;
+    }
+    dircache->last_len = PATH_MAX;
+  }
+}
+
+/**
+ * Allocate an empty directory cache.
+ *
+ * @return Directory cache, or NULL if failed to allocate memory.
+ */
+static struct touch_dircache *
+touch_dircache_new(void){
+  struct touch_dircache *dircache;
+  size_t i;
+
+  dircache = malloc(sizeof(*dircache));
+  if(dircache){
+    for(i = 0; i < TOUCH_DIRCACHE_SZ; i++){
+      dircache->entries[i].fd = -1;
+    }
+    touch_dircache_reset(dircache);
+  }
+  return dircache;
+}
+
+/**
+ * Close all cached directories and free the cache.
+ *
+ * @param[in] dircache See @ref touch_dircache.
+ */
+static void
+touch_dircache_free(struct touch_dircache *const dircache){
+  touch_dircache_reset(dircache);
+  free(dircache);
+}
+
+/**
+ * Get the directory file descriptor and name to use for a path.
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in,out] dircache See @ref touch_dircache. Can be NULL.
+ * @param[in]     path     Path to a file.
+ * @param[out]    name     Name to use relative to the returned directory.
+ * @return                 Directory file descriptor, or AT_FDCWD if
+ *                         @p name should be resolved from the current
+ *                         directory.
+ */
+static int
+touch_dircache_get(struct touch *const touch,
+                   struct touch_dircache *const dircache,
+                   const char *const path,
+                   const char **const name){
+  struct touch_dircache_entry *entry;
+  const char *slash;
+  size_t len;
+  size_t i;
+  int dirfd;
+#ifdef O_PATH
+  const int oflags = O_PATH | O_DIRECTORY | O_CLOEXEC;
+#else /* !(O_PATH) */
+  const int oflags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+#endif /* O_PATH */
+
+  *name = path;
+  dirfd = AT_FDCWD;
+  slash = dircache ? strrchr(path, '/') : NULL;
+  if(slash && slash[1] != '\0'){
+    len = (size_t)(slash - path);
+    if(len == 0){
+      len = 1;
+    }
+    if(len < PATH_MAX){
+      entry = &dircache->entries[0];
+      for(i = 0; i < TOUCH_DIRCACHE_SZ; i++){
+        if(dircache->entries[i].len == len &&
+           memcmp(dircache->entries[i].dir, path, len) == 0){
+          entry = &dircache->entries[i];
+          break;
+        }
+        if(dircache->entries[i].used < entry->used){
+          entry = &dircache->entries[i];
+        }
+      }
+      dircache->clock += 1;
+      if(i == TOUCH_DIRCACHE_SZ){
+        /* Replace the least recently used directory. */
+        if(entry->fd >= 0){
+          close(entry->fd);
+        }
+        memcpy(entry->dir, path, len);
+        entry->dir[len] = '\0';
+        entry->len = len;
+        entry->fd = -1;
+        entry->tried = false;
+      }
+      else if(!entry->tried){
+        entry->tried = true;
+        entry->fd = open(entry->dir, oflags);
+        touch->stats.opens += 1;
+      }
+      entry->used = dircache->clock;
+      if(entry->fd >= 0){
+        dirfd = entry->fd;
+        *name = slash + 1;
+      }
+    }
+  }
+  return dirfd;
+}
+
+/**
+ * Get the access and modification times of a file.
+ *
+ * Only asks for the times when statx() is available, which avoids filling
+ * in the rest of the file status. The times get synchronized the same way
+ * as stat(), so network filesystems never report stale cached times. A
+ * time the filesystem does not report gets set to UTIME_OMIT.
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in]     dirfd    Directory file descriptor that @p name is
+ *                         relative to.
+ * @param[in]     name     Name of the file relative to @p dirfd.
+ * @param[in]     at_flags Either 0 or AT_SYMLINK_NOFOLLOW.
+ * @param[out]    times    Access and modification times, only set on
+ *                         success.
+ * @retval        0        Got the times.
+ * @retval        -1       Failed to get the times, errno set.
+ */
+static int
+touch_get_times(struct touch *const touch,
+                const int dirfd,
+                const char *const name,
+                const int at_flags,
+                struct timespec times[2]){
+  int rc;
+#ifdef STATX_MTIME
+  struct statx stx;
+#else /* !(STATX_MTIME) */
+  struct stat sb;
+#endif /* STATX_MTIME */
+
+  touch->stats.statx += 1;
+#ifdef STATX_MTIME
+  rc = statx(dirfd,
+             name,
+             at_flags | AT_STATX_SYNC_AS_STAT,
+             STATX_ATIME | STATX_MTIME,
+             &stx);
+  if(rc == 0){
+    times[0].tv_sec = stx.stx_atime.tv_sec;
+    times[0].tv_nsec = stx.stx_atime.tv_nsec;
+    times[1].tv_sec = stx.stx_mtime.tv_sec;
+    times[1].tv_nsec = stx.stx_mtime.tv_nsec;
+    if(!(stx.stx_mask & STATX_ATIME)){
+      times[0].tv_sec = 0;
+      times[0].tv_nsec = UTIME_OMIT;
+    }
+    if(!(stx.stx_mask & STATX_MTIME)){
+      times[1].tv_sec = 0;
+      times[1].tv_nsec = UTIME_OMIT;
+    }
+  }
+#else /* !(STATX_MTIME) */
+  rc = fstatat(dirfd, name, &sb, at_flags);
+  if(rc == 0){
+    times[0] = sb.st_atim;
+    times[1] = sb.st_mtim;
+  }
+#endif /* STATX_MTIME */
+  return rc;
+}
+
+/**
+ * Leave alone any time that already has the requested value, and with
+ * --forward-only any time that would move backwards.
+ *
+ * @param[in]     forward Leave alone times that would move backwards.
+ * @param[in]     cur     Current access and modification times, or
+ *                        UTIME_OMIT for times not known, which always get
+ *                        set.
+ * @param[in,out] times   Requested times, which get set to UTIME_OMIT if
+ *                        they should get left alone.
+ */
+static void
+touch_keep_times(const bool forward,
+                 const struct timespec cur[2],
+                 struct timespec times[2]){
+  struct timespec now;
+  struct timespec want;
+  bool backwards;
+  int i;
+
+  clock_gettime(CLOCK_REALTIME, &now);
+  for(i = 0; i < 2; i++){
+    want = times[i];
+    if(want.tv_nsec == UTIME_NOW){
+      want = now;
+    }
+    backwards = (want.tv_sec < cur[i].tv_sec ||
+                 (want.tv_sec == cur[i].tv_sec &&
+                  want.tv_nsec < cur[i].tv_nsec));
+    if(want.tv_nsec == UTIME_OMIT){
+      /* Time does not get changed. */
+    }
+    else if(cur[i].tv_nsec == UTIME_OMIT){
+      /* Current time not known, so it always gets set. */
+    }
+    else if(want.tv_sec == cur[i].tv_sec &&
+            want.tv_nsec == cur[i].tv_nsec){
+      times[i].tv_nsec = UTIME_OMIT;
+    }
+    else if(forward && backwards){
+      times[i].tv_nsec = UTIME_OMIT;
+    }
+  }
+}
+
+/**
+ * Get the apply kernel mode matching the options of a context.
+ *
+ * @param[in] touch See @ref touch.
+ * @return          Combination of TOUCH_KERNEL_CHECK through
+ *                  TOUCH_KERNEL_LIMIT.
+ */
+static unsigned int
+touch_kernel_mode(const struct touch *const touch){
+  unsigned int mode;
+
+  mode = 0;
+  if(touch->flags & (TOUCH_FLAG_IF_CHANGED | TOUCH_FLAG_FORWARD)){
+    mode |= TOUCH_KERNEL_CHECK;
+  }
+  if(touch->flags & TOUCH_FLAG_FORWARD){
+    mode |= TOUCH_KERNEL_FORWARD;
+  }
+  if(!(touch->flags & TOUCH_FLAG_NO_CREATE)){
+    mode |= TOUCH_KERNEL_CREATE;
+  }
+  if(touch->limit){
+    mode |= TOUCH_KERNEL_LIMIT;
+  }
+  return mode;
+}
+
+/**
+ * Set the times of an existing file using a fixed apply kernel mode.
+ *
+ * With --if-changed or --forward-only, the current times get checked first
+ * and any time that would stay the same or move backwards gets left alone.
+ * No update happens at all if that leaves both times alone, so the inode
+ * does not get dirtied.
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in]     dirfd    Directory file descriptor that @p name is
+ *                         relative to.
+ * @param[in]     name     Name of the file relative to @p dirfd.
+ * @param[in]     at_flags Either 0 or AT_SYMLINK_NOFOLLOW.
+ * @param[in]     mode     See @ref touch_kernel_mode.
+ * @retval        0        Updated the file times or did not need to.
+ * @retval        -1       Failed to update the times, errno set.
+ */
+static TOUCH_KERNEL_INLINE int
+touch_utimensat_mode(struct touch *const touch,
+                     const int dirfd,
+                     const char *const name,
+                     const int at_flags,
+                     const unsigned int mode){
+  struct timespec cur[2];
+  struct timespec times[2];
+  unsigned long start;
+  int rc;
+
+  rc = 0;
+  touch->stats.targets += 1;
+  if(mode & TOUCH_KERNEL_LIMIT){
+    touch_limit_wait(touch);
+  }
+  times[0] = touch->time_am[0];
+  times[1] = touch->time_am[1];
+  if(mode & TOUCH_KERNEL_CHECK){
+    rc = touch_get_times(touch, dirfd, name, at_flags, cur);
+    if(rc == 0){
+      touch_keep_times((mode & TOUCH_KERNEL_FORWARD) != 0, cur, times);
+    }
+  }
+  if(rc != 0){
+    /* File does not exist or cannot get checked. */
+  }
+  else if((mode & TOUCH_KERNEL_CHECK) &&
+          times[0].tv_nsec == UTIME_OMIT &&
+          times[1].tv_nsec == UTIME_OMIT){
+    touch->stats.unchanged += 1;
+  }
+  else{
+    touch->stats.utimensat += 1;
+    start = 0;
+    if((mode & TOUCH_KERNEL_LIMIT) && touch->limit->target_ns){
+      start = touch_clock_ns();
+    }
+    rc = utimensat(dirfd, name, times, at_flags);
+    if(start){
+      touch_limit_record(touch->limit, start);
+    }
+  }
+  return rc;
+}
+
+/**
+ * Set the times of an existing file.
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in]     dirfd    Directory file descriptor that @p name is
+ *                         relative to.
+ * @param[in]     name     Name of the file relative to @p dirfd.
+ * @param[in]     at_flags Either 0 or AT_SYMLINK_NOFOLLOW.
+ * @retval        0        Updated the file times or did not need to.
+ * @retval        -1       Failed to update the times, errno set.
+ */
+static int
+touch_utimensat(struct touch *const touch,
+                const int dirfd,
+                const char *const name,
+                const int at_flags){
+  return touch_utimensat_mode(touch,
+                              dirfd,
+                              name,
+                              at_flags,
+                              touch_kernel_mode(touch));
+}
+
+/**
+ * Create a file that does not exist and set the times.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     dirfd Directory file descriptor that @p name is relative to.
+ * @param[in]     name  Name of the file to create relative to @p dirfd.
+ * @param[in]     path  Full path used in error messages.
+ */
+static void
+touch_create(struct touch *const touch,
+             const int dirfd,
+             const char *const name,
+             const char *const path){
+  int fd;
+  const mode_t cm = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
+
+  fd = openat(dirfd, name, O_WRONLY | O_CREAT | O_TRUNC, cm);
+  touch->stats.opens += 1;
+  if(fd < 0){
+    touch_warn(touch, true, "creat: %s", path);
+  }
+  else{
+    touch->stats.creats += 1;
+    touch->stats.futimens += 1;
+    if(futimens(fd, touch->time_am) != 0){
+      touch_warn(touch, true, "futimens: %s", path);
+    }
+    close(fd);
+  }
+}
+
+/**
+ * Close the newly created files saved in @ref touch::close_fds.
+ *
+ * File descriptors get handed out using the lowest available number, so
+ * files created one after another usually have consecutive descriptors.
+ * Each run of consecutive descriptors gets closed using a single
+ * close_range() call when available.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_close_flush(struct touch *const touch){
+  size_t first;
+  size_t last;
+  bool closed;
+
+  for(first = 0; first < touch->num_close_fds; first = last + 1){
+    last = first;
+    while(last + 1 < touch->num_close_fds &&
+          touch->close_fds[last + 1] == touch->close_fds[last] + 1){
+      last += 1;
+    }
+    closed = false;
+#ifdef __NR_close_range
+    if(last > first){
+      closed = (syscall(__NR_close_range,
+                        touch->close_fds[first],
+                        touch->close_fds[last],
+                        0) == 0);
+    }
+#endif /* __NR_close_range */
+    for(; !closed && first <= last; first++){
+      close(touch->close_fds[first]);
+    }
+  }
+  touch->num_close_fds = 0;
+}
+
+/**
+ * Update the times of an existing file.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     path  Path to an existing file.
+ * @param[out]    dirfd Directory file descriptor that @p name is relative
+ *                      to.
+ * @param[out]    name  Name of the file relative to @p dirfd.
+ * @retval        0     Updated the file times.
+ * @retval        -1    utimensat() failed, errno set.
+ */
+static int
+touch_utimens(struct touch *const touch,
+              const char *const path,
+              int *const dirfd,
+              const char **const name){
+  *dirfd = touch_dircache_get(touch, touch->dircache, path, name);
+  return touch_utimensat(touch, *dirfd, *name, 0);
+}
+
+/**
+ * Touch a file using a fixed apply kernel mode.
+ *
+ * Existing files get updated using a single utimensat() call. The file only
+ * gets created if that call fails with ENOENT and the mode has
+ * TOUCH_KERNEL_CREATE.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     path  Path to a file to touch.
+ * @param[in]     mode  See @ref touch_kernel_mode.
+ */
+static TOUCH_KERNEL_INLINE void
+touch_path_mode(struct touch *const touch,
+                const char *const path,
+                const unsigned int mode){
+  const char *name;
+  int dirfd;
+
+  dirfd = touch_dircache_get(touch, touch->dircache, path, &name);
+  if(touch_utimensat_mode(touch, dirfd, name, 0, mode) == 0){
+    /* Updated an existing file. */
+  }
+  else if(errno != ENOENT){
+    touch_warn(touch, true, "utimensat on: %s", path);
+  }
+  else{
+    touch->stats.enoent += 1;
+    if(mode & TOUCH_KERNEL_CREATE){
+      touch_create(touch, dirfd, name, path);
+    }
+  }
+}
+
+/**
+ * Touch a file.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     path  Path to a file to touch.
+ */
+static void
+touch_path(struct touch *const touch,
+           const char *const path){
+  touch_path_mode(touch, path, touch_kernel_mode(touch));
+}
+
+/**
+ * Define the apply kernel touching each path with a fixed mode.
+ *
+ * Each kernel passes a constant mode to @ref touch_path_mode, so the
+ * compiler drops the branches on the mode from the code run for each
+ * path, and the mode only gets looked at once when choosing the kernel.
+ *
+ * @param[in] mode Combination of TOUCH_KERNEL_CHECK through
+ *                 TOUCH_KERNEL_LIMIT.
+ */
+#define TOUCH_KERNEL(mode)                                     \
+  static void                                                  \
+  touch_path_kernel_ ## mode(struct touch *const touch,        \
+                             const char *const path){          \
+    touch_path_mode(touch, path, (mode));                      \
+  }
+
+TOUCH_KERNEL(0)
+TOUCH_KERNEL(1)
+TOUCH_KERNEL(2)
+TOUCH_KERNEL(3)
+TOUCH_KERNEL(4)
+TOUCH_KERNEL(5)
+TOUCH_KERNEL(6)
+TOUCH_KERNEL(7)
+TOUCH_KERNEL(8)
+TOUCH_KERNEL(9)
+TOUCH_KERNEL(10)
+TOUCH_KERNEL(11)
+TOUCH_KERNEL(12)
+TOUCH_KERNEL(13)
+TOUCH_KERNEL(14)
+TOUCH_KERNEL(15)
+
+/**
+ * Apply kernels indexed by @ref touch_kernel_mode.
+ */
+static void
+(*const touch_path_kernels[TOUCH_KERNEL_NUM])(struct touch *const touch,
+                                              const char *const path) = {
+  touch_path_kernel_0,
+  touch_path_kernel_1,
+  touch_path_kernel_2,
+  touch_path_kernel_3,
+  touch_path_kernel_4,
+  touch_path_kernel_5,
+  touch_path_kernel_6,
+  touch_path_kernel_7,
+  touch_path_kernel_8,
+  touch_path_kernel_9,
+  touch_path_kernel_10,
+  touch_path_kernel_11,
+  touch_path_kernel_12,
+  touch_path_kernel_13,
+  touch_path_kernel_14,
+  touch_path_kernel_15
+};
+
+/**
+ * Choose the function touching each path using the usual utimensat() and
+ * create calls.
+ *
+ * @param[in] touch See @ref touch.
+ * @return          Apply kernel for the mode, or @ref touch_path.
+ */
+static void
+(*touch_path_fn(const struct touch *const touch))(struct touch *const touch,
+                                                  const char *const path){
+  void (*fn)(struct touch *const touch,
+             const char *const path);
+
+  fn = touch_path;
+  if(TOUCH_APPLY_KERNELS){
+    fn = touch_path_kernels[touch_kernel_mode(touch)];
+  }
+  return fn;
+}
+
+/**
+ * Create a file expected to not exist yet (--new-files).
+ *
+ * The file gets created using a single openat() call without looking for
+ * an existing file first. The times only get set if they differ from the
+ * creation time, and the file gets closed later with other new files.
+ * Existing files get touched the usual way.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     path  Path to a file to create.
+ */
+static void
+touch_new_path(struct touch *const touch,
+               const char *const path){
+  const int oflags = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC;
+  const mode_t cm = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
+  const char *name;
+  int dirfd;
+  int fd;
+
+  touch_limit_wait(touch);
+  dirfd = touch_dircache_get(touch, touch->dircache, path, &name);
+  fd = openat(dirfd, name, oflags, cm);
+  touch->stats.opens += 1;
+  if(fd >= 0){
+    touch->stats.targets += 1;
+    touch->stats.creats += 1;
+    if((touch->time_am[0].tv_nsec == UTIME_NOW ||
+        touch->time_am[0].tv_nsec == UTIME_OMIT) &&
+       (touch->time_am[1].tv_nsec == UTIME_NOW ||
+        touch->time_am[1].tv_nsec == UTIME_OMIT)){
+      /* New file already has the current time. */
+    }
+    else{
+      touch->stats.futimens += 1;
+      if(futimens(fd, touch->time_am) != 0){
+        touch_warn(touch, true, "futimens: %s", path);
+      }
+    }
+    if(touch->num_close_fds == TOUCH_CLOSE_BATCH_SZ){
+      touch_close_flush(touch);
+    }
+    touch->close_fds[touch->num_close_fds++] = fd;
+  }
+  else if(errno == EEXIST){
+    touch_path(touch, path);
+  }
+  else{
+    touch->stats.targets += 1;
+    touch_warn(touch, true, "creat: %s", path);
+  }
+}
+
+/**
+ * Set the times that do not get changed to UTIME_OMIT when only -a or -m
+ * has been provided.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_omit_times(struct touch *const touch){
+  if(!(touch->flags & TOUCH_FLAG_ACCESS_TIME) &&
+     !(touch->flags & TOUCH_FLAG_MOD_TIME)){
+    /* Update both access and modification times. */
+  }
+  else if(!(touch->flags & TOUCH_FLAG_ACCESS_TIME)){
+    touch->time_am[0].tv_nsec = UTIME_OMIT;
+  }
+  else if(!(touch->flags & TOUCH_FLAG_MOD_TIME)){
+    touch->time_am[1].tv_nsec = UTIME_OMIT;
+  }
+}
+
+/**
+ * Record the filesystem of a touched file to flush later (--durable).
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     dev   Device ID of the filesystem.
+ * @param[in]     fd    File descriptor on the filesystem to duplicate, or
+ *                      -1 to open @p dir instead.
+ * @param[in]     dir   Directory on the filesystem, or NULL along with
+ *                      @p fd -1 if the filesystem is not known. Every
+ *                      filesystem gets flushed instead if @p dir cannot
+ *                      get opened as a directory.
+ */
+static void
+touch_durable_add(struct touch *const touch,
+                  const dev_t dev,
+                  const int fd,
+                  const char *const dir){
+  struct touch_durable *durable;
+  size_t i;
+  int sync_fd;
+
+  durable = touch->durable;
+  pthread_mutex_lock(&durable->mutex);
+  for(i = 0; i < durable->num_fs && durable->fs[i].dev != dev; i++){
+    /* Find the filesystem. */
+  }
+  if(durable->sync_all || i < durable->num_fs){
+    /* Already gets flushed. */
+  }
+  else if(i == TOUCH_DURABLE_FS_SZ || (fd < 0 && dir == NULL)){
+    durable->sync_all = true;
+  }
+  else{
+    if(fd >= 0){
+      sync_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    }
+    else{
+      sync_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      touch->stats.opens += 1;
+    }
+    if(sync_fd < 0){
+      durable->sync_all = true;
+    }
+    else{
+      durable->fs[i].dev = dev;
+      durable->fs[i].fd = sync_fd;
+      durable->num_fs += 1;
+    }
+  }
+  pthread_mutex_unlock(&durable->mutex);
+}
+
+/**
+ * Check whether a path has a different parent directory than the previous
+ * path checked, and get the status of a new parent directory.
+ *
+ * The parent directory only gets checked when it differs from the parent
+ * directory of the previous path, so paths grouped by directory only cost
+ * one extra fstatat() for each directory. On success, the parent directory
+ * can be found in @ref touch_dircache::last_dir.
+ *
+ * @param[in,out] dircache See @ref touch_dircache. Can be NULL.
+ * @param[in]     path     Path to a file.
+ * @param[out]    sb       Status of the parent directory if it changed.
+ * @retval        0        Same parent directory as the previous path.
+ * @retval        1        Different parent directory, @p sb set.
+ * @retval        -1       Parent directory not known, errno set.
+ */
+static int
+touch_dircache_parent(struct touch_dircache *const dircache,
+                      const char *const path,
+                      struct stat *const sb){
+  const char *slash;
+  size_t len;
+  int rc;
+
+  slash = strrchr(path, '/');
+  len = 0;
+  if(slash){
+    len = (slash == path) ? 1 : (size_t)(slash - path);
+  }
+  rc = 0;
+  if(dircache == NULL || len >= PATH_MAX){
+    errno = (dircache == NULL) ? ENOMEM : ENAMETOOLONG;
+    rc = -1;
+  }
+  else if(dircache->last_len == len &&
+          memcmp(dircache->last_dir, path, len) == 0){
+    /* Same directory as the previous path. */
+  }
+  else{
+    if(slash){
+      memcpy(dircache->last_dir, path, len);
+      dircache->last_dir[len] = '\0';
+    }
+    else{
+      strcpy(dircache->last_dir, ".");
+    }
+    dircache->last_len = PATH_MAX;
+    rc = -1;
+    if(fstatat(AT_FDCWD, dircache->last_dir, sb, 0) == 0){
+      dircache->last_len = len;
+      dircache->last_dev = sb->st_dev;
+      rc = 1;
+    }
+  }
+  return rc;
+}
+
+/**
+ * Touch a path and record the filesystems holding its parent directory
+ * and the inode that got touched (--durable).
+ *
+ * The touched inode gets checked following symbolic links, the same way
+ * it got touched. A target on another filesystem than its parent
+ * directory, such as a mount point or a symbolic link into another
+ * filesystem, gets its own filesystem flushed if it is a directory, or
+ * every filesystem otherwise. Every filesystem also gets flushed if the
+ * parent directory cannot get checked.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     path  Path to a file to touch.
+ */
+static void
+touch_durable_path(struct touch *const touch,
+                   const char *const path){
+  struct stat sb;
+  int rc;
+
+  touch->durable->fn(touch, path);
+  rc = touch_dircache_parent(touch->dircache, path, &sb);
+  if(rc < 0){
+    touch_durable_add(touch, 0, -1, NULL);
+  }
+  else{
+    if(rc > 0){
+      touch_durable_add(touch, sb.st_dev, -1, touch->dircache->last_dir);
+    }
+    if(fstatat(AT_FDCWD, path, &sb, 0) == 0 &&
+       sb.st_dev != touch->dircache->last_dev){
+      touch_durable_add(touch, sb.st_dev, -1, path);
+    }
+  }
+}
+
+/**
+ * Map a target path to its counterpart under @ref touch::ref_root.
+ *
+ * A target root of "/" holds every absolute target.
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in]     path     Target path.
+ * @param[out]    ref_path Buffer of size PATH_MAX for the reference path.
+ * @retval        true     Mapped the target path.
+ * @retval        false    Target not under @ref touch::target_root or the
+ *                         reference path is too long, warning printed.
+ */
+static bool
+touch_ref_map(struct touch *const touch,
+              const char *const path,
+              char *const ref_path){
+  const char *suffix;
+  size_t root_len;
+  size_t ref_len;
+  size_t suffix_len;
+  bool success;
+
+  success = true;
+  suffix = path;
+  if(touch->target_root){
+    root_len = strlen(touch->target_root);
+    while(root_len > 0 && touch->target_root[root_len - 1] == '/'){
+      root_len -= 1;
+    }
+    if(strncmp(path, touch->target_root, root_len) != 0 ||
+       (path[root_len] != '/' && (root_len == 0 || path[root_len] != '\0'))){
+      touch_warn(touch, false, "not under --target-root: %s", path);
+      success = false;
+    }
+    suffix = &path[root_len];
+  }
+  while(suffix[0] == '.' && suffix[1] == '/'){
+    suffix += 2;
+  }
+  while(*suffix == '/'){
+    suffix += 1;
+  }
+  ref_len = strlen(touch->ref_root);
+  suffix_len = strlen(suffix);
+  if(success && ref_len + 1 + suffix_len >= PATH_MAX){
+    errno = ENAMETOOLONG;
+    touch_warn(touch, true, "reference file for: %s", path);
+    success = false;
+  }
+  else if(success){
+    memcpy(ref_path, touch->ref_root, ref_len);
+    if(suffix_len > 0){
+      ref_path[ref_len++] = '/';
+      memcpy(&ref_path[ref_len], suffix, suffix_len);
+    }
+    ref_path[ref_len + suffix_len] = '\0';
+  }
+  return success;
+}
+
+/**
+ * Get the times of the counterpart of a target under
+ * @ref touch::ref_root.
+ *
+ * The counterpart only gets asked for its access and modification times,
+ * relative to a cached parent directory. The times get saved to
+ * @ref touch::time_am.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     path  Target path.
+ * @retval        true  Found the times.
+ * @retval        false Failed to find the times.
+ */
+static bool
+touch_ref_times(struct touch *const touch,
+                const char *const path){
+  char ref_path[PATH_MAX];
+  const char *name;
+  int dirfd;
+  bool success;
+
+  success = touch_ref_map(touch, path, ref_path);
+  if(success){
+    dirfd = touch_dircache_get(touch, touch->ref_dircache, ref_path, &name);
+    success = (touch_get_times(touch, dirfd, name, 0, touch->time_am) == 0);
+    if(!success){
+      touch_warn(touch, true, "stat reference file: %s", ref_path);
+    }
+    else{
+      touch_omit_times(touch);
+    }
+  }
+  return success;
+}
+
+/**
+ * Touch a file using the times of its counterpart under
+ * @ref touch::ref_root (--ref-root).
+ *
+ * Targets without a counterpart are left alone and get reported as
+ * errors.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     path  Path to a file to touch.
+ */
+static void
+touch_ref_path(struct touch *const touch,
+               const char *const path){
+  if(touch_ref_times(touch, path)){
+    touch_path(touch, path);
+  }
+}
+
+/**
+ * Record the parent directory of a target and find the filesystem holding
+ * it (--plan).
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     path  Target path.
+ */
+static void
+touch_plan_dir(struct touch *const touch,
+               const char *const path){
+  struct touch_plan *plan;
+  struct stat sb;
+  size_t i;
+  int rc;
+
+  plan = touch->plan;
+  rc = touch_dircache_parent(touch->dircache, path, &sb);
+  if(rc < 0){
+    touch->plan_fs = TOUCH_PLAN_FS_SZ;
+    touch->plan_dir_errno = errno;
+  }
+  else if(rc > 0){
+    touch->plan_fs = TOUCH_PLAN_FS_SZ;
+    touch->plan_dir_errno = 0;
+    if(plan){
+      pthread_mutex_lock(&plan->mutex);
+      for(i = 0; i < plan->num_fs && plan->fs[i].dev != sb.st_dev; i++){
+        /* Find the filesystem. */
+      }
+      if(i == plan->num_fs && i < TOUCH_PLAN_FS_SZ){
+        plan->fs[i].dev = sb.st_dev;
+        plan->num_fs += 1;
+      }
+      plan->fs[i].dirs += 1;
+      pthread_mutex_unlock(&plan->mutex);
+      touch->plan_fs = i;
+    }
+  }
+}
+
+/**
+ * Count a target in its class on the filesystem of its parent directory
+ * (--plan).
+ *
+ * @param[in,out] touch     See @ref touch.
+ * @param[in]     class     TOUCH_PLAN_CREATE through TOUCH_PLAN_ERROR.
+ * @param[in]     lookup_ns Nanoseconds taken to look up the target, or 0 if
+ *                          not sampled.
+ */
+static void
+touch_plan_count(struct touch *const touch,
+                 const int class,
+                 const unsigned long lookup_ns){
+  struct touch_plan *plan;
+
+  plan = touch->plan;
+  if(plan){
+    pthread_mutex_lock(&plan->mutex);
+    plan->fs[touch->plan_fs].targets[class] += 1;
+    if(lookup_ns){
+      plan->sample_ns += lookup_ns;
+      plan->samples += 1;
+    }
+    pthread_mutex_unlock(&plan->mutex);
+  }
+}
+
+/**
+ * Check whether utimensat() would be allowed to set the times of an
+ * existing file (--plan).
+ *
+ * The owner can set any time, while setting both times to the current time
+ * only needs write access. Privileged users can set any time.
+ *
+ * @param[in] dirfd Directory file descriptor that @p name is relative to.
+ * @param[in] name  Name of the file relative to @p dirfd.
+ * @param[in] sb    Status of the file.
+ * @param[in] times Times that would get set.
+ * @retval    true  Setting the times would be allowed.
+ * @retval    false Setting the times would fail, errno set.
+ */
+static bool
+touch_plan_allowed(const int dirfd,
+                   const char *const name,
+                   const struct stat *const sb,
+                   const struct timespec times[2]){
+  bool explicit;
+  bool allowed;
+  uid_t euid;
+
+  euid = geteuid();
+  explicit = ((times[0].tv_nsec != UTIME_NOW &&
+               times[0].tv_nsec != UTIME_OMIT) ||
+              (times[1].tv_nsec != UTIME_NOW &&
+               times[1].tv_nsec != UTIME_OMIT));
+  allowed = (euid == 0 || sb->st_uid == euid);
+  if(allowed){
+    /* Owner can set any time. */
+  }
+  else if(explicit || S_ISLNK(sb->st_mode)){
+    errno = EPERM;
+  }
+  else{
+    allowed = (faccessat(dirfd, name, W_OK, AT_EACCESS) == 0);
+  }
+  return allowed;
+}
+
+/**
+ * Check whether a missing target could get created in its parent directory
+ * (--plan).
+ *
+ * @param[in] touch See @ref touch.
+ * @retval    true  Target could get created.
+ * @retval    false Target would fail to get created, errno set.
+ */
+static bool
+touch_plan_creatable(const struct touch *const touch){
+  bool creatable;
+
+  creatable = true;
+  if(touch->dircache == NULL){
+    /* Parent directory not known. */
+  }
+  else if(touch->plan_dir_errno != 0){
+    errno = touch->plan_dir_errno;
+    creatable = false;
+  }
+  else{
+    creatable = (faccessat(AT_FDCWD,
+                           touch->dircache->last_dir,
+                           W_OK | X_OK,
+                           AT_EACCESS) == 0);
+  }
+  return creatable;
+}
+
+/**
+ * Find out what touching a target would do without changing anything, and
+ * count the target in its class (--plan).
+ *
+ * Each target gets looked up once using fstatat(), and the time taken by
+ * that lookup gets sampled to estimate the time taken by each system call
+ * on the same filesystem. Targets that would fail get reported the same way
+ * as when touching them.
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in]     dirfd    Directory file descriptor that @p name is
+ *                         relative to.
+ * @param[in]     name     Name of the target relative to @p dirfd.
+ * @param[in]     path     Full target path.
+ * @param[in]     at_flags Either 0 or AT_SYMLINK_NOFOLLOW.
+ */
+static void
+touch_plan_target(struct touch *const touch,
+                  const int dirfd,
+                  const char *const name,
+                  const char *const path,
+                  const int at_flags){
+  struct timespec cur[2];
+  struct timespec times[2];
+  struct stat sb;
+  unsigned long start;
+  unsigned long lookup_ns;
+  int class;
+  int rc;
+
+  touch->stats.targets += 1;
+  touch_plan_dir(touch, path);
+  start = touch_clock_ns();
+  rc = fstatat(dirfd, name, &sb, at_flags);
+  lookup_ns = touch_clock_ns() - start;
+  if(rc == 0){
+    times[0] = touch->time_am[0];
+    times[1] = touch->time_am[1];
+    if(touch->flags & (TOUCH_FLAG_IF_CHANGED | TOUCH_FLAG_FORWARD)){
+      cur[0] = sb.st_atim;
+      cur[1] = sb.st_mtim;
+      touch_keep_times((touch->flags & TOUCH_FLAG_FORWARD) != 0, cur, times);
+    }
+    if(times[0].tv_nsec == UTIME_OMIT && times[1].tv_nsec == UTIME_OMIT){
+      class = TOUCH_PLAN_UNCHANGED;
+      touch->stats.unchanged += 1;
+    }
+    else if(touch_plan_allowed(dirfd, name, &sb, times)){
+      class = TOUCH_PLAN_UPDATE;
+    }
+    else{
+      class = TOUCH_PLAN_ERROR;
+      touch_warn(touch, true, "utimensat on: %s", path);
+    }
+  }
+  else if(errno != ENOENT){
+    class = TOUCH_PLAN_ERROR;
+    touch_warn(touch, true, "utimensat on: %s", path);
+  }
+  else if(touch->flags & TOUCH_FLAG_NO_CREATE){
+    class = TOUCH_PLAN_SKIP;
+    touch->stats.enoent += 1;
+  }
+  else if(touch_plan_creatable(touch)){
+    class = TOUCH_PLAN_CREATE;
+    touch->stats.enoent += 1;
+  }
+  else{
+    class = TOUCH_PLAN_ERROR;
+    touch_warn(touch, true, "creat: %s", path);
+  }
+  touch_plan_count(touch, class, lookup_ns);
+}
+
+/**
+ * Find out what touching a path would do without changing anything
+ * (--plan).
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     path  Path to a file to check.
+ */
+static void
+touch_plan_path(struct touch *const touch,
+                const char *const path){
+  const char *name;
+  int dirfd;
+
+  if(touch->ref_root && !touch_ref_times(touch, path)){
+    touch->stats.targets += 1;
+    touch_plan_dir(touch, path);
+    touch_plan_count(touch, TOUCH_PLAN_ERROR, 0);
+  }
+  else{
+    dirfd = touch_dircache_get(touch, touch->dircache, path, &name);
+    touch_plan_target(touch, dirfd, name, path, 0);
+  }
+}
+
+#ifdef TOUCH_IO_URING
+/**
+ * Set in the io_uring user data to mark the completion of a close request.
+ */
+#define TOUCH_URING_CLOSE ((__u64)1 << 32)
+
+# ifndef TOUCH_URING_ENTER
+/**
+ * Submit requests to the io_uring engine and wait for completions.
+ */
+#  define TOUCH_URING_ENTER(fd, to_submit, min_complete, flags) \
+  syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0)
+# endif /* TOUCH_URING_ENTER */
+
+/**
+ * io_uring engine used to create files in batches.
+ *
+ * Existing files still get updated using utimensat() because io_uring does
+ * not have a request for setting file times. Files that need to get created
+ * get opened and closed by batches of io_uring requests. If the new files
+ * do not need any explicit times, each file gets opened into a registered
+ * file slot and closed by a linked request, so a full batch only costs a
+ * single system call.
+ */
+struct touch_uring{
+  /**
+   * io_uring file descriptor.
+   */
+  int fd;
+
+  /**
+   * Number of entries in the submission queue.
+   */
+  unsigned int sq_entries;
+
+  /**
+   * Local copy of the submission queue tail.
+   */
+  unsigned int sqe_tail;
+
+  /**
+   * Files can get opened into registered file slots.
+   */
+  bool direct;
+
+  /**
+   * Mapped submission queue ring.
+   */
+  char *sq_ring;
+
+  /**
+   * Size of @ref sq_ring.
+   */
+  size_t sq_ring_sz;
+
+  /**
+   * Mapped completion queue ring, which might be the same as @ref sq_ring.
+   */
+  char *cq_ring;
+
+  /**
+   * Size of @ref cq_ring.
+   */
+  size_t cq_ring_sz;
+
+  /**
+   * Mapped submission queue entries.
+   */
+  struct io_uring_sqe *sqes;
+
+  /**
+   * Size of @ref sqes.
+   */
+  size_t sqes_sz;
+
+  /**
+   * Submission queue tail shared with the kernel.
+   */
+  unsigned int *sq_tail;
+
+  /**
+   * Submission queue index mask.
+   */
+  unsigned int *sq_mask;
+
+  /**
+   * Completion queue head shared with the kernel.
+   */
+  unsigned int *cq_head;
+
+  /**
+   * Completion queue tail shared with the kernel.
+   */
+  unsigned int *cq_tail;
+
+  /**
+   * Completion queue index mask.
+   */
+  unsigned int *cq_mask;
+
+  /**
+   * Completion queue entries.
+   */
+  struct io_uring_cqe *cqes;
+
+  /**
+   * Paths waiting to get created, up to @ref sq_entries.
+   */
+  const char **pending;
+
+  /**
+   * Number of paths in @ref pending.
+   */
+  unsigned int num_pending;
+
+  /**
+   * Result of the open request for each path in @ref pending.
+   */
+  int *res;
+};
+
+/**
+ * Release the io_uring engine.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_uring_free(struct touch *const touch){
+  struct touch_uring *uring;
+
+  uring = touch->uring;
+  if(uring->sqes != MAP_FAILED){
+    munmap(uring->sqes, uring->sqes_sz);
+  }
+  if(uring->cq_ring != MAP_FAILED && uring->cq_ring != uring->sq_ring){
+    munmap(uring->cq_ring, uring->cq_ring_sz);
+  }
+  if(uring->sq_ring != MAP_FAILED){
+    munmap(uring->sq_ring, uring->sq_ring_sz);
+  }
+  if(uring->fd >= 0){
+    close(uring->fd);
+  }
+  free(uring->pending);
+  free(uring->res);
+  free(uring);
+  touch->uring = NULL;
+}
+
+/**
+ * Check if the kernel supports the open and close io_uring requests.
+ *
+ * @param[in] uring See @ref touch_uring.
+ * @retval    true  Open and close requests supported.
+ * @retval    false Not supported or failed to probe.
+ */
+static bool
+touch_uring_probe(const struct touch_uring *const uring){
+  const size_t PROBE_OPS = 256;
+  struct io_uring_probe *probe;
+  bool supported;
+
+  supported = false;
+  probe = malloc(sizeof(*probe) + PROBE_OPS * sizeof(probe->ops[0]));
+  if(probe){
+    memset(probe, 0, sizeof(*probe) + PROBE_OPS * sizeof(probe->ops[0]));
+    if(syscall(__NR_io_uring_register,
+               uring->fd,
+               IORING_REGISTER_PROBE,
+               probe,
+               PROBE_OPS) == 0 &&
+       probe->last_op >= IORING_OP_CLOSE &&
+       (probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED) &&
+       (probe->ops[IORING_OP_CLOSE].flags & IO_URING_OP_SUPPORTED)){
+      supported = true;
+    }
+    free(probe);
+  }
+  return supported;
+}
+
+/**
+ * Map the io_uring submission and completion queues.
+ *
+ * @param[in,out] uring See @ref touch_uring.
+ * @param[in]     p     Parameters returned by io_uring_setup.
+ * @retval        true  Mapped the queues.
+ * @retval        false Failed to map the queues.
+ */
+static bool
+touch_uring_map(struct touch_uring *const uring,
+                const struct io_uring_params *const p){
+  const int prot = PROT_READ | PROT_WRITE;
+  const int flags = MAP_SHARED | MAP_POPULATE;
+  unsigned int *sq_array;
+  unsigned int i;
+
+  uring->sq_ring_sz = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+  uring->cq_ring_sz = p->cq_off.cqes +
+                      p->cq_entries * sizeof(struct io_uring_cqe);
+  if(p->features & IORING_FEAT_SINGLE_MMAP){
+    if(uring->cq_ring_sz > uring->sq_ring_sz){
+      uring->sq_ring_sz = uring->cq_ring_sz;
+    }
+    uring->cq_ring_sz = uring->sq_ring_sz;
+  }
+  uring->sq_ring = mmap(NULL,
+                        uring->sq_ring_sz,
+                        prot,
+                        flags,
+                        uring->fd,
+                        IORING_OFF_SQ_RING);
+  if(uring->sq_ring != MAP_FAILED){
+    if(p->features & IORING_FEAT_SINGLE_MMAP){
+      uring->cq_ring = uring->sq_ring;
+    }
+    else{
+      uring->cq_ring = mmap(NULL,
+                            uring->cq_ring_sz,
+                            prot,
+                            flags,
+                            uring->fd,
+                            IORING_OFF_CQ_RING);
+    }
+  }
+  if(uring->cq_ring != MAP_FAILED){
+    uring->sqes_sz = p->sq_entries * sizeof(struct io_uring_sqe);
+    uring->sqes = mmap(NULL,
+                       uring->sqes_sz,
+                       prot,
+                       flags,
+                       uring->fd,
+                       IORING_OFF_SQES);
+  }
+  if(uring->sqes != MAP_FAILED){
+    uring->sq_tail = (unsigned int *)(uring->sq_ring + p->sq_off.tail);
+    uring->sq_mask = (unsigned int *)(uring->sq_ring + p->sq_off.ring_mask);
+    sq_array = (unsigned int *)(uring->sq_ring + p->sq_off.array);
+    for(i = 0; i < p->sq_entries; i++){
+      sq_array[i] = i;
+    }
+    uring->sqe_tail = *uring->sq_tail;
+    uring->cq_head = (unsigned int *)(uring->cq_ring + p->cq_off.head);
+    uring->cq_tail = (unsigned int *)(uring->cq_ring + p->cq_off.tail);
+    uring->cq_mask = (unsigned int *)(uring->cq_ring + p->cq_off.ring_mask);
+    uring->cqes = (struct io_uring_cqe *)(uring->cq_ring + p->cq_off.cqes);
+  }
+  return uring->sqes != MAP_FAILED;
+}
+
+/**
+ * Register empty file slots so files can get opened without creating a
+ * file descriptor in the process.
+ *
+ * @param[in,out] uring See @ref touch_uring.
+ */
+static void
+touch_uring_register_files(struct touch_uring *const uring){
+  int *slots;
+  unsigned int i;
+
+  slots = malloc(uring->sq_entries * sizeof(*slots));
+  if(slots){
+    for(i = 0; i < uring->sq_entries; i++){
+      slots[i] = -1;
+    }
+    if(syscall(__NR_io_uring_register,
+               uring->fd,
+               IORING_REGISTER_FILES,
+               slots,
+               uring->sq_entries) == 0){
+      uring->direct = true;
+    }
+    free(slots);
+  }
+}
+
+/**
+ * Set up the io_uring engine if the kernel supports it.
+ *
+ * @ref touch::uring remains NULL if the engine cannot get used, in which
+ * case all files get touched using the POSIX system calls.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_uring_init(struct touch *const touch){
+  struct io_uring_params p;
+  struct touch_uring *uring;
+  long fd;
+
+  uring = malloc(sizeof(*uring));
+  if(uring){
+    memset(uring, 0, sizeof(*uring));
+    uring->sq_ring = MAP_FAILED;
+    uring->cq_ring = MAP_FAILED;
+    uring->sqes = MAP_FAILED;
+    touch->uring = uring;
+    memset(&p, 0, sizeof(p));
+    fd = syscall(__NR_io_uring_setup, TOUCH_URING_ENTRIES, &p);
+    uring->fd = (int)fd;
+    uring->sq_entries = p.sq_entries;
+    uring->pending = malloc(p.sq_entries * sizeof(*uring->pending) + 1);
+    uring->res = malloc(p.sq_entries * sizeof(*uring->res) + 1);
+    if(fd < 0 ||
+       uring->pending == NULL ||
+       uring->res == NULL ||
+       touch_uring_probe(uring) == false ||
+       touch_uring_map(uring, &p) == false){
+      touch_uring_free(touch);
+    }
+    else{
+      touch_uring_register_files(uring);
+    }
+  }
+}
+
+/**
+ * Get the next free submission queue entry.
+ *
+ * @param[in,out] uring     See @ref touch_uring.
+ * @param[in]     opcode    io_uring request type.
+ * @param[in]     user_data Value returned in the completion.
+ * @return                  Cleared submission queue entry.
+ */
+static struct io_uring_sqe *
+touch_uring_sqe(struct touch_uring *const uring,
+                const __u8 opcode,
+                const __u64 user_data){
+  struct io_uring_sqe *sqe;
+
+  sqe = &uring->sqes[uring->sqe_tail & *uring->sq_mask];
+  uring->sqe_tail += 1;
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->user_data = user_data;
+  return sqe;
+}
+
+/**
+ * Submit all queued requests and wait for them to complete.
+ *
+ * Save the result of each open request in @ref touch_uring::res.
+ *
+ * @param[in,out] uring     See @ref touch_uring.
+ * @param[in]     num_sqes  Number of queued requests.
+ * @param[out]    submitted Number of the queued requests, in queue order,
+ *                          that the kernel took before any failure.
+ * @retval        0         All requests completed.
+ * @retval        -1        io_uring_enter failed, errno set.
+ */
+static int
+touch_uring_submit(struct touch_uring *const uring,
+                   const unsigned int num_sqes,
+                   unsigned int *const submitted){
+  const struct io_uring_cqe *cqe;
+  unsigned int reaped;
+  unsigned int head;
+  unsigned int tail;
+  long rc;
+
+  __atomic_store_n(uring->sq_tail, uring->sqe_tail, __ATOMIC_RELEASE);
+  *submitted = 0;
+  reaped = 0;
+  rc = 0;
+  while(rc >= 0 && reaped < num_sqes){
+    rc = TOUCH_URING_ENTER(uring->fd,
+                           num_sqes - *submitted,
+                           1,
+                           IORING_ENTER_GETEVENTS);
+    if(rc < 0 && errno == EINTR){
+      rc = 0;
+    }
+    else if(rc >= 0){
+      *submitted += (unsigned int)rc;
+      head = *uring->cq_head;
+      tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+      while(head != tail){
+        cqe = &uring->cqes[head & *uring->cq_mask];
+        if(!(cqe->user_data & TOUCH_URING_CLOSE)){
+          uring->res[cqe->user_data] = cqe->res;
+        }
+        head += 1;
+        reaped += 1;
+      }
+      __atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+    }
+  }
+  return rc < 0 ? -1 : 0;
+}
+
+/**
+ * Check if newly created files need their times set explicitly.
+ *
+ * New files already have their access and modification times set to the
+ * current time.
+ *
+ * @param[in] touch See @ref touch.
+ * @retval    true  Times need to get set after creating the file.
+ * @retval    false Creating the file sets the requested times.
+ */
+static bool
+touch_create_needs_times(const struct touch *const touch){
+  return (touch->time_am[0].tv_nsec != UTIME_NOW  &&
+          touch->time_am[0].tv_nsec != UTIME_OMIT) ||
+         (touch->time_am[1].tv_nsec != UTIME_NOW  &&
+          touch->time_am[1].tv_nsec != UTIME_OMIT);
+}
+
+/**
+ * Create all pending files using batched io_uring requests.
+ *
+ * If io_uring_enter fails, files opened so far get closed using close(),
+ * the files that never got opened get created using @ref touch_create, and
+ * the engine gets released.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_uring_flush(struct touch *const touch){
+  const mode_t cm = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
+  const int oflags = O_WRONLY | O_CREAT | O_NOCTTY | O_NONBLOCK;
+  struct touch_uring *uring;
+  struct io_uring_sqe *sqe;
+  unsigned int num_sqes;
+  unsigned int num_closes;
+  unsigned int submitted;
+  unsigned int i;
+  bool linked;
+  int rc;
+
+  uring = touch->uring;
+  linked = uring->direct && !touch_create_needs_times(touch);
+  num_sqes = 0;
+  for(i = 0; i < uring->num_pending; i++){
+    uring->res[i] = -ECANCELED;
+    sqe = touch_uring_sqe(uring, IORING_OP_OPENAT, i);
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (__u64)(uintptr_t)uring->pending[i];
+    sqe->len = cm;
+    sqe->open_flags = oflags;
+    num_sqes += 1;
+    if(!linked){
+      sqe->open_flags |= O_CLOEXEC;
+    }
+    else{
+      /* Registered file slots do not allow O_CLOEXEC. */
+      sqe->file_index = i + 1;
+      sqe->flags = IOSQE_IO_LINK;
+      sqe = touch_uring_sqe(uring, IORING_OP_CLOSE, i | TOUCH_URING_CLOSE);
+      sqe->file_index = i + 1;
+      num_sqes += 1;
+    }
+  }
+  rc = touch_uring_submit(uring, num_sqes, &submitted);
+  if(rc != 0){
+    touch_warn(touch, true, "io_uring_enter");
+  }
+  num_closes = 0;
+  for(i = 0; i < uring->num_pending; i++){
+    if(uring->res[i] == -ECANCELED){
+      /* Never opened, so it gets created below. */
+    }
+    else if(uring->res[i] < 0){
+      touch->stats.opens += 1;
+      errno = -uring->res[i];
+      touch_warn(touch, true, "creat: %s", uring->pending[i]);
+    }
+    else if(linked){
+      touch->stats.opens += 1;
+      touch->stats.creats += 1;
+    }
+    else{
+      touch->stats.opens += 1;
+      touch->stats.creats += 1;
+      if(touch_create_needs_times(touch)){
+        touch->stats.futimens += 1;
+        if(futimens(uring->res[i], touch->time_am) != 0){
+          touch_warn(touch, true, "futimens: %s", uring->pending[i]);
+        }
+      }
+      if(rc == 0){
+        sqe = touch_uring_sqe(uring,
+                              IORING_OP_CLOSE,
+                              i | TOUCH_URING_CLOSE);
+        sqe->fd = uring->res[i];
+        num_closes += 1;
+      }
+      else{
+        close(uring->res[i]);
+      }
+    }
+  }
+  if(rc == 0 && num_closes > 0){
+    rc = touch_uring_submit(uring, num_closes, &submitted);
+    if(rc != 0){
+      touch_warn(touch, true, "io_uring_enter");
+    }
+    /* Close the files whose close requests the kernel never took. */
+    num_closes = 0;
+    for(i = 0; rc != 0 && i < uring->num_pending; i++){
+      if(uring->res[i] >= 0){
+        if(num_closes >= submitted){
+          close(uring->res[i]);
+        }
+        num_closes += 1;
+      }
+    }
+  }
+  if(rc != 0){
+    for(i = 0; i < uring->num_pending; i++){
+      if(uring->res[i] == -ECANCELED){
+        touch_create(touch, AT_FDCWD, uring->pending[i], uring->pending[i]);
+      }
+    }
+    touch_uring_free(touch);
+  }
+  else{
+    uring->num_pending = 0;
+  }
+}
+
+/**
+ * Touch a list of paths using the io_uring engine.
+ *
+ * @param[in,out] touch     See @ref touch.
+ * @param[in]     paths     Paths to touch.
+ * @param[in]     num_paths Number of paths in @p paths.
+ */
+static void
+touch_uring_apply(struct touch *const touch,
+                  const char *const paths[],
+                  const size_t num_paths){
+  struct touch_uring *uring;
+  const char *name;
+  unsigned int max_pending;
+  size_t i;
+  int dirfd;
+
+  uring = touch->uring;
+  max_pending = uring->direct ? uring->sq_entries / 2 : uring->sq_entries;
+  for(i = 0; i < num_paths && touch->uring; i++){
+    if(touch_utimens(touch, paths[i], &dirfd, &name) == 0){
+      /* Updated an existing file. */
+    }
+    else if(errno != ENOENT){
+      touch_warn(touch, true, "utimensat on: %s", paths[i]);
+    }
+    else{
+      touch->stats.enoent += 1;
+      if(!(touch->flags & TOUCH_FLAG_NO_CREATE)){
+        uring->pending[uring->num_pending++] = paths[i];
+        if(uring->num_pending == max_pending){
+          touch_uring_flush(touch);
+        }
+      }
+    }
+  }
+  if(touch->uring && uring->num_pending > 0){
+    touch_uring_flush(touch);
+  }
+  for(; i < num_paths; i++){
+    touch_path(touch, paths[i]);
+  }
+}
+#endif /* TOUCH_IO_URING */
+
+/**
+ * Take the next path index from a worker queue.
+ *
+ * @param[in,out] worker See @ref touch_worker.
+ * @param[in]     steal  Take from the back of the queue instead of the front.
+ * @param[out]    index  Path index taken from the queue.
+ * @retval        true   Took a path from the queue.
+ * @retval        false  Queue empty.
+ */
+static bool
+touch_worker_take(struct touch_worker *const worker,
+                  const bool steal,
+                  size_t *const index){
+  bool took;
+
+  took = false;
+  pthread_mutex_lock(&worker->mutex);
+  if(worker->head < worker->tail){
+    if(steal){
+      worker->tail -= 1;
+      *index = worker->tail;
+    }
+    else{
+      *index = worker->head;
+      worker->head += 1;
+    }
+    took = true;
+  }
+  pthread_mutex_unlock(&worker->mutex);
+  return took;
+}
+
+/**
+ * Check whether any worker queue in a pool still has paths.
+ *
+ * @param[in,out] pool  See @ref touch_pool.
+ * @retval        true  Some queue has paths left.
+ * @retval        false Every queue is empty.
+ */
+static bool
+touch_pool_has_paths(struct touch_pool *const pool){
+  struct touch_worker *worker;
+  bool has_paths;
+  size_t i;
+
+  has_paths = false;
+  for(i = 0; !has_paths && i < pool->num_workers; i++){
+    worker = &pool->workers[i];
+    pthread_mutex_lock(&worker->mutex);
+    has_paths = (worker->head < worker->tail);
+    pthread_mutex_unlock(&worker->mutex);
+  }
+  return has_paths;
+}
+
+/**
+ * Reset a ring to empty and set up the condition idle workers sleep on.
+ *
+ * @param[out] ring  See @ref touch_ring.
+ * @retval     true  Set up the ring.
+ * @retval     false Failed to set up the condition, free nothing.
+ */
+static bool
+touch_ring_init(struct touch_ring *const ring){
+  size_t i;
+  bool success;
+
+  ring->enqueue_pos = 0;
+  ring->dequeue_pos = 0;
+  ring->closed = false;
+  ring->sleepers = 0;
+  for(i = 0; i < TOUCH_RING_SZ; i++){
+    ring->slots[i].seq = i;
+  }
+  success = (pthread_mutex_init(&ring->mutex, NULL) == 0);
+  if(success){
+    success = (pthread_cond_init(&ring->cond, NULL) == 0);
+    if(!success){
+      pthread_mutex_destroy(&ring->mutex);
+    }
+  }
+  return success;
+}
+
+/**
+ * Release the condition set up by @ref touch_ring_init.
+ *
+ * @param[in,out] ring See @ref touch_ring.
+ */
+static void
+touch_ring_free(struct touch_ring *const ring){
+  pthread_cond_destroy(&ring->cond);
+  pthread_mutex_destroy(&ring->mutex);
+}
+
+/**
+ * Check whether a ring has no path ready to get taken.
+ *
+ * @param[in] ring  See @ref touch_ring.
+ * @retval    true  Ring empty.
+ * @retval    false Ring has a path.
+ */
+static bool
+touch_ring_empty(struct touch_ring *const ring){
+  size_t pos;
+
+  pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_SEQ_CST);
+  return __atomic_load_n(&ring->slots[pos & (TOUCH_RING_SZ - 1)].seq,
+                         __ATOMIC_SEQ_CST) != pos + 1;
+}
+
+/**
+ * Wake a worker sleeping on an empty ring after adding a path.
+ *
+ * The fence orders the new path before checking for sleepers, matching
+ * @ref touch_ring_sleep which counts itself before checking the ring, so
+ * either the reader sees the sleeper or the sleeper sees the path.
+ *
+ * @param[in,out] ring See @ref touch_ring.
+ */
+static void
+touch_ring_wake(struct touch_ring *const ring){
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if(__atomic_load_n(&ring->sleepers, __ATOMIC_SEQ_CST) > 0){
+    pthread_mutex_lock(&ring->mutex);
+    pthread_cond_signal(&ring->cond);
+    pthread_mutex_unlock(&ring->mutex);
+  }
+}
+
+/**
+ * Close a ring so that the workers finish once it becomes empty, waking
+ * every sleeping worker.
+ *
+ * @param[in,out] ring See @ref touch_ring.
+ */
+static void
+touch_ring_close(struct touch_ring *const ring){
+  pthread_mutex_lock(&ring->mutex);
+  __atomic_store_n(&ring->closed, true, __ATOMIC_SEQ_CST);
+  pthread_cond_broadcast(&ring->cond);
+  pthread_mutex_unlock(&ring->mutex);
+}
+
+/**
+ * Sleep until the reader adds a path to an empty ring or closes it, so
+ * idle workers do not keep polling while a slow list gets read.
+ *
+ * Returns right away if a path arrived or the ring got closed in the
+ * meantime, and may also return early because of spurious wakeups.
+ *
+ * @param[in,out] ring See @ref touch_ring.
+ */
+static void
+touch_ring_sleep(struct touch_ring *const ring){
+  pthread_mutex_lock(&ring->mutex);
+  __atomic_add_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+  if(touch_ring_empty(ring) &&
+     !__atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST)){
+    pthread_cond_wait(&ring->cond, &ring->mutex);
+  }
+  __atomic_sub_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&ring->mutex);
+}
+
+/**
+ * Add a path to a ring.
+ *
+ * @param[in,out] ring       See @ref touch_ring.
+ * @param[in]     path       See @ref touch_ring_slot::path.
+ * @param[in]     path_index See @ref touch_ring_slot::path_index.
+ * @param[in]     buf        See @ref touch_ring_slot::buf.
+ * @retval        true       Added the path.
+ * @retval        false      Ring full.
+ */
+static bool
+touch_ring_push(struct touch_ring *const ring,
+                const char *const path,
+                const size_t path_index,
+                struct touch_ring_buf *const buf){
+  struct touch_ring_slot *slot;
+  size_t pos;
+  size_t seq;
+  bool pushed;
+  bool done;
+
+  pushed = false;
+  done = false;
+  slot = NULL;
+  pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+  while(!done){
+    slot = &ring->slots[pos & (TOUCH_RING_SZ - 1)];
+    seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if(seq == pos){
+      pushed = __atomic_compare_exchange_n(&ring->enqueue_pos,
+                                           &pos,
+                                           pos + 1,
+                                           true,
+                                           __ATOMIC_RELAXED,
+                                           __ATOMIC_RELAXED);
+      done = pushed;
+    }
+    else if(seq < pos){
+      done = true;
+    }
+    else{
+      pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+    }
+  }
+  if(pushed){
+    slot->path = path;
+    slot->path_index = path_index;
+    slot->buf = buf;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    touch_ring_wake(ring);
+  }
+  return pushed;
+}
+
+/**
+ * Take the next path from a ring.
+ *
+ * @param[in,out] ring   See @ref touch_ring.
+ * @param[out]    out    Copy of the slot holding the path.
+ * @retval        true   Took a path from the ring.
+ * @retval        false  Ring empty.
+ */
+static bool
+touch_ring_pop(struct touch_ring *const ring,
+               struct touch_ring_slot *const out){
+  struct touch_ring_slot *slot;
+  size_t pos;
+  size_t seq;
+  bool popped;
+  bool done;
+
+  popped = false;
+  done = false;
+  slot = NULL;
+  pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+  while(!done){
+    slot = &ring->slots[pos & (TOUCH_RING_SZ - 1)];
+    seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if(seq == pos + 1){
+      popped = __atomic_compare_exchange_n(&ring->dequeue_pos,
+                                           &pos,
+                                           pos + 1,
+                                           true,
+                                           __ATOMIC_RELAXED,
+                                           __ATOMIC_RELAXED);
+      done = popped;
+    }
+    else if(seq < pos + 1){
+      done = true;
+    }
+    else{
+      pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+    }
+  }
+  if(popped){
+    *out = *slot;
+    __atomic_store_n(&slot->seq, pos + TOUCH_RING_SZ, __ATOMIC_RELEASE);
+  }
+  return popped;
+}
+
+/**
+ * Take one path from the pool ring and touch it, releasing the buffer the
+ * path points into.
+ *
+ * @param[in,out] worker See @ref touch_worker.
+ * @retval        true   Touched a path.
+ * @retval        false  Ring empty.
+ */
+static bool
+touch_ring_run_one(struct touch_worker *const worker){
+  struct touch_ring_slot slot;
+  bool took;
+
+  took = touch_ring_pop(worker->pool->ring, &slot);
+  if(took){
+    worker->touch.path_index = slot.path_index;
+    worker->pool->fn(&worker->touch, slot.path);
+    __atomic_sub_fetch(&slot.buf->refs, 1, __ATOMIC_RELEASE);
+  }
+  return took;
+}
+
+/**
+ * Touch a path from the pool ring while waiting on the workers, or yield
+ * if the ring is empty.
+ *
+ * @param[in,out] worker See @ref touch_worker.
+ */
+static void
+touch_ring_wait(struct touch_worker *const worker){
+  if(!touch_ring_run_one(worker)){
+    sched_yield();
+  }
+}
+
+/**
+ * Worker thread entry point.
+ *
+ * Touch all paths in the worker queue, and then steal paths from the other
+ * workers until every queue becomes empty. When the pool has a ring, touch
+ * paths from the ring until it becomes empty after getting closed, and
+ * sleep after polling the empty ring @ref TOUCH_RING_SPINS times. Workers
+ * paused by --target-latency sleep until they can run again or no work is
+ * left.
+ *
+ * @param[in,out] arg See @ref touch_worker.
+ * @return            NULL.
+ */
+static void *
+touch_worker_run(void *const arg){
+  struct touch_worker *worker;
+  struct touch_pool *pool;
+  size_t self;
+  size_t i;
+  size_t index;
+  size_t idle;
+  bool paused;
+  bool took;
+  bool closed;
+
+  worker = arg;
+  pool = worker->pool;
+  self = (size_t)(worker - pool->workers);
+  if(pool->ring){
+    idle = 0;
+    do{
+      closed = __atomic_load_n(&pool->ring->closed, __ATOMIC_ACQUIRE);
+      paused = touch_limit_paused(&worker->touch, self);
+      took = false;
+      if(paused){
+        touch_sleep_ns(TOUCH_LIMIT_PAUSE_NS);
+      }
+      else{
+        took = touch_ring_run_one(worker);
+      }
+      if(took || paused || closed){
+        idle = 0;
+      }
+      else if(idle < TOUCH_RING_SPINS){
+        idle += 1;
+        sched_yield();
+      }
+      else{
+        touch_ring_sleep(pool->ring);
+        idle = 0;
+      }
+    } while(took || !closed);
+  }
+  else{
+    do{
+      paused = touch_limit_paused(&worker->touch, self);
+      if(paused){
+        touch_sleep_ns(TOUCH_LIMIT_PAUSE_NS);
+        took = touch_pool_has_paths(pool);
+      }
+      else{
+        took = touch_worker_take(worker, false, &index);
+        for(i = 1; !took && i < pool->num_workers; i++){
+          took = touch_worker_take(&pool->workers[(self + i) %
+                                                  pool->num_workers],
+                                   true,
+                                   &index);
+        }
+        if(took){
+          worker->touch.path_index = index;
+          pool->fn(&worker->touch, pool->paths[index]);
+        }
+      }
+    } while(took);
+  }
+  touch_close_flush(&worker->touch);
+  return NULL;
+}
+
+/**
+ * Add the counters from a worker to the main context.
+ *
+ * @param[in,out] stats  Main context counters.
+ * @param[in]     worker Worker context counters.
+ */
+static void
+touch_stats_merge(struct touch_stats *const stats,
+                  const struct touch_stats *const worker){
+  size_t i;
+
+  stats->targets += worker->targets;
+  stats->opens += worker->opens;
+  stats->creats += worker->creats;
+  stats->utimensat += worker->utimensat;
+  stats->futimens += worker->futimens;
+  stats->statx += worker->statx;
+  stats->unchanged += worker->unchanged;
+  stats->enoent += worker->enoent;
+  stats->errors += worker->errors;
+  for(i = 0; i < TOUCH_STATS_ERRNO_SZ; i++){
+    stats->errnos[i] += worker->errnos[i];
+  }
+}
+
+/**
+ * Merge the status code, counters, and saved error messages from each
+ * worker into the main context, printing the messages in path order.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in,out] pool  See @ref touch_pool.
+ */
+static void
+touch_pool_merge(struct touch *const touch,
+                 struct touch_pool *const pool){
+  struct touch_diag *diag;
+  size_t diag_len;
+  size_t i;
+  size_t j;
+
+  diag_len = 0;
+  for(i = 0; i < pool->num_workers; i++){
+    if(pool->workers[i].touch.status_code != EXIT_SUCCESS){
+      touch->status_code = EXIT_FAILURE;
+    }
+    touch_stats_merge(&touch->stats, &pool->workers[i].touch.stats);
+    diag_len += pool->workers[i].diag_len;
+  }
+  diag = malloc(diag_len * sizeof(*diag) + 1);
+  if(diag == NULL){
+    touch_warn(touch, true, "malloc: diagnostics");
+  }
+  else{
+    diag_len = 0;
+    for(i = 0; i < pool->num_workers; i++){
+      for(j = 0; j < pool->workers[i].diag_len; j++){
+        diag[diag_len++] = pool->workers[i].diag[j];
+        pool->workers[i].diag[j].msg = NULL;
+      }
+    }
+    qsort(diag, diag_len, sizeof(*diag), touch_diag_cmp);
+    for(i = 0; i < diag_len; i++){
+      touch_errlog_add(touch, diag[i].errnum, diag[i].msg);
+      free(diag[i].msg);
+    }
+    free(diag);
+  }
+  for(i = 0; touch->errlog && i < pool->num_workers; i++){
+    touch->errlog->dropped += pool->workers[i].diag_dropped;
+    for(j = 0; j < TOUCH_STATS_ERRNO_SZ; j++){
+      touch->errlog->repeats[j] += pool->workers[i].diag_repeats[j];
+    }
+  }
+  for(i = 0; i < pool->num_workers; i++){
+    for(j = 0; j < pool->workers[i].diag_len; j++){
+      free(pool->workers[i].diag[j].msg);
+    }
+    free(pool->workers[i].diag);
+  }
+}
+
+/**
+ * Add up the counters of the main context and the running pool.
+ *
+ * Must get called with @ref touch_progress::mutex locked.
+ *
+ * @param[in]  progress See @ref touch_progress.
+ * @param[out] done     Number of targets done.
+ * @param[out] errors   Number of errors.
+ * @param[out] queued   Number of paths waiting for a worker.
+ */
+static void
+touch_progress_count(const struct touch_progress *const progress,
+                     unsigned long *const done,
+                     unsigned long *const errors,
+                     unsigned long *const queued){
+  const struct touch_stats *stats;
+  struct touch_worker *worker;
+  struct touch_ring *ring;
+  size_t i;
+
+  stats = &progress->touch->stats;
+  *done = __atomic_load_n(&stats->targets, __ATOMIC_RELAXED);
+  *errors = __atomic_load_n(&stats->errors, __ATOMIC_RELAXED);
+  *queued = 0;
+  for(i = 0; progress->pool && i < progress->pool->num_workers; i++){
+    worker = &progress->pool->workers[i];
+    stats = &worker->touch.stats;
+    *done += __atomic_load_n(&stats->targets, __ATOMIC_RELAXED);
+    *errors += __atomic_load_n(&stats->errors, __ATOMIC_RELAXED);
+    if(progress->pool->ring == NULL){
+      pthread_mutex_lock(&worker->mutex);
+      *queued += (unsigned long)(worker->tail - worker->head);
+      pthread_mutex_unlock(&worker->mutex);
+    }
+  }
+  ring = progress->pool ? progress->pool->ring : NULL;
+  if(ring){
+    *queued = (unsigned long)(__atomic_load_n(&ring->enqueue_pos,
+                                              __ATOMIC_RELAXED) -
+                              __atomic_load_n(&ring->dequeue_pos,
+                                              __ATOMIC_RELAXED));
+  }
+}
+
+/**
+ * Write a progress report.
+ *
+ * The rate covers the time since the previous report, or the whole run for
+ * the final report.
+ *
+ * Must get called with @ref touch_progress::mutex locked.
+ *
+ * @param[in,out] progress See @ref touch_progress.
+ * @param[in]     final    Set for the report written after finishing.
+ */
+static void
+touch_progress_report(struct touch_progress *const progress,
+                      const bool final){
+  unsigned long now;
+  unsigned long done;
+  unsigned long errors;
+  unsigned long queued;
+  unsigned long since_done;
+  unsigned long since_ns;
+  unsigned long rate;
+
+  now = touch_clock_ns();
+  touch_progress_count(progress, &done, &errors, &queued);
+  since_done = done - progress->last_done;
+  since_ns = now - progress->last_ns;
+  if(final){
+    since_done = done;
+    since_ns = now - progress->start_ns;
+  }
+  rate = 0;
+  if(since_ns >= 1000000UL){
+    rate = since_done * 1000UL / (since_ns / 1000000UL);
+  }
+  dprintf(progress->touch->progress_fd,
+          "progress: done=%lu errors=%lu rate=%lu/s queued=%lu "
+          "elapsed_ms=%lu%s\n",
+          done,
+          errors,
+          rate,
+          queued,
+          (now - progress->start_ns) / 1000000UL,
+          final ? " finished" : "");
+  progress->last_done = done;
+  progress->last_ns = now;
+}
+
+/**
+ * Progress reporter thread entry point.
+ *
+ * @param[in,out] arg See @ref touch_progress.
+ * @return            NULL.
+ */
+static void *
+touch_progress_run(void *const arg){
+  struct touch_progress *progress;
+  struct timespec deadline;
+  unsigned long next_ns;
+  int rc;
+
+  progress = arg;
+  pthread_mutex_lock(&progress->mutex);
+  next_ns = progress->start_ns + TOUCH_PROGRESS_INTERVAL_NS;
+  while(!progress->stop){
+    deadline.tv_sec = (time_t)(next_ns / 1000000000UL);
+    deadline.tv_nsec = (long)(next_ns % 1000000000UL);
+    rc = pthread_cond_timedwait(&progress->cond,
+                                &progress->mutex,
+                                &deadline);
+    if(rc == ETIMEDOUT && !progress->stop){
+      touch_progress_report(progress, false);
+      next_ns += TOUCH_PROGRESS_INTERVAL_NS;
+    }
+  }
+  pthread_mutex_unlock(&progress->mutex);
+  return NULL;
+}
+
+/**
+ * Start the progress reporter thread (--progress).
+ *
+ * Progress does not get reported if the thread fails to start.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_progress_start(struct touch *const touch){
+  struct touch_progress *progress;
+  pthread_condattr_t attr;
+  bool success;
+
+  progress = malloc(sizeof(*progress));
+  success = (progress != NULL);
+  if(success){
+    memset(progress, 0, sizeof(*progress));
+    progress->touch = touch;
+    progress->start_ns = touch_clock_ns();
+    progress->last_ns = progress->start_ns;
+    success = (pthread_mutex_init(&progress->mutex, NULL) == 0);
+    if(!success){
+      free(progress);
+    }
+  }
+  if(success){
+    success = (pthread_condattr_init(&attr) == 0);
+    if(success){
+      success = (pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) == 0 &&
+                 pthread_cond_init(&progress->cond, &attr) == 0);
+      pthread_condattr_destroy(&attr);
+    }
+    if(success &&
+       pthread_create(&progress->thread,
+                      NULL,
+                      touch_progress_run,
+                      progress) != 0){
+      pthread_cond_destroy(&progress->cond);
+      success = false;
+    }
+    if(success){
+      touch->progress = progress;
+    }
+    else{
+      pthread_mutex_destroy(&progress->mutex);
+      free(progress);
+    }
+  }
+}
+
+/**
+ * Stop the progress reporter thread and write the final report.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_progress_stop(struct touch *const touch){
+  struct touch_progress *progress;
+
+  progress = touch->progress;
+  if(progress){
+    pthread_mutex_lock(&progress->mutex);
+    progress->stop = true;
+    pthread_cond_signal(&progress->cond);
+    pthread_mutex_unlock(&progress->mutex);
+    pthread_join(progress->thread, NULL);
+    touch_progress_report(progress, true);
+    pthread_cond_destroy(&progress->cond);
+    pthread_mutex_destroy(&progress->mutex);
+    free(progress);
+    touch->progress = NULL;
+  }
+}
+
+/**
+ * Allocate the workers and split the paths evenly between their queues.
+ *
+ * @param[in]  touch     See @ref touch.
+ * @param[out] pool      See @ref touch_pool.
+ * @param[in]  paths     Paths to touch.
+ * @param[in]  num_paths Number of paths in @p paths.
+ * @param[in]  fn        See @ref touch_pool::fn.
+ * @retval     true      Created the workers.
+ * @retval     false     Failed to create the workers.
+ */
+static bool
+touch_pool_init(const struct touch *const touch,
+                struct touch_pool *const pool,
+                const char *const paths[],
+                const size_t num_paths,
+                void (*fn)(struct touch *const touch,
+                           const char *const path)){
+  struct touch_worker *worker;
+  size_t i;
+  bool success;
+
+  pool->paths = paths;
+  pool->ring = NULL;
+  pool->fn = fn;
+  pool->num_workers = touch->jobs;
+  if(pool->num_workers > num_paths){
+    pool->num_workers = num_paths;
+  }
+  pool->workers = malloc(pool->num_workers * sizeof(*pool->workers));
+  success = (pool->workers != NULL);
+  if(success){
+    memset(pool->workers, 0, pool->num_workers * sizeof(*pool->workers));
+  }
+  for(i = 0; success && i < pool->num_workers; i++){
+    worker = &pool->workers[i];
+    worker->touch = *touch;
+    worker->touch.status_code = EXIT_SUCCESS;
+    memset(&worker->touch.stats, 0, sizeof(worker->touch.stats));
+    worker->touch.worker = worker;
+    worker->touch.uring = NULL;
+    worker->touch.dircache = NULL;
+    worker->touch.ref_dircache = NULL;
+    worker->touch.errlog = NULL;
+    worker->touch.progress = NULL;
+    worker->touch.num_close_fds = 0;
+    if(touch->dircache){
+      worker->touch.dircache = touch_dircache_new();
+    }
+    if(touch->ref_dircache){
+      worker->touch.ref_dircache = touch_dircache_new();
+    }
+    worker->pool = pool;
+    worker->head = i * num_paths / pool->num_workers;
+    worker->tail = (i + 1) * num_paths / pool->num_workers;
+    if(pthread_mutex_init(&worker->mutex, NULL) != 0){
+      touch_dircache_free(worker->touch.dircache);
+      touch_dircache_free(worker->touch.ref_dircache);
+      while(i-- > 0){
+        pthread_mutex_destroy(&pool->workers[i].mutex);
+        touch_dircache_free(pool->workers[i].touch.dircache);
+        touch_dircache_free(pool->workers[i].touch.ref_dircache);
+      }
+      free(pool->workers);
+      success = false;
+    }
+  }
+  return success;
+}
+
+/**
+ * Start the worker threads other than the first worker.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in,out] pool  See @ref touch_pool.
+ */
+static void
+touch_pool_start(struct touch *const touch,
+                 struct touch_pool *const pool){
+  struct touch_worker *worker;
+  size_t i;
+
+  if(touch->progress){
+    pthread_mutex_lock(&touch->progress->mutex);
+    touch->progress->pool = pool;
+    pthread_mutex_unlock(&touch->progress->mutex);
+  }
+
+  for(i = 1; i < pool->num_workers; i++){
+    worker = &pool->workers[i];
+    if(pthread_create(&worker->thread, NULL, touch_worker_run, worker) == 0){
+      worker->started = true;
+    }
+  }
+}
+
+/**
+ * Run the first worker on the calling thread, wait for the other workers,
+ * and then merge their results and free the pool.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in,out] pool  See @ref touch_pool.
+ */
+static void
+touch_pool_finish(struct touch *const touch,
+                  struct touch_pool *const pool){
+  size_t i;
+
+  touch_worker_run(&pool->workers[0]);
+  for(i = 1; i < pool->num_workers; i++){
+    if(pool->workers[i].started){
+      pthread_join(pool->workers[i].thread, NULL);
+    }
+  }
+  if(touch->progress){
+    pthread_mutex_lock(&touch->progress->mutex);
+  }
+  touch_pool_merge(touch, pool);
+  if(touch->progress){
+    touch->progress->pool = NULL;
+    pthread_mutex_unlock(&touch->progress->mutex);
+  }
+  for(i = 0; i < pool->num_workers; i++){
+    pthread_mutex_destroy(&pool->workers[i].mutex);
+    touch_dircache_free(pool->workers[i].touch.dircache);
+    touch_dircache_free(pool->workers[i].touch.ref_dircache);
+  }
+  free(pool->workers);
+}
+
+/**
+ * Touch a list of paths using a pool of worker threads.
+ *
+ * The calling thread acts as the first worker, so all paths still get
+ * touched if some of the other threads fail to start.
+ *
+ * @param[in,out] touch     See @ref touch.
+ * @param[in]     paths     Paths to touch.
+ * @param[in]     num_paths Number of paths in @p paths.
+ * @param[in]     fn        See @ref touch_pool::fn.
+ * @retval        true      Touched all paths.
+ * @retval        false     Failed to set up the worker pool.
+ */
+static bool
+touch_pool_run(struct touch *const touch,
+               const char *const paths[],
+               const size_t num_paths,
+               void (*fn)(struct touch *const touch,
+                          const char *const path)){
+  struct touch_pool pool;
+  bool success;
+
+  success = touch_pool_init(touch, &pool, paths, num_paths, fn);
+  if(success){
+    touch_pool_start(touch, &pool);
+    touch_pool_finish(touch, &pool);
+  }
+  return success;
+}
+
+/**
+ * Block of memory handed out by @ref touch_arena.
+ */
+struct touch_arena_block{
+  /**
+   * Previously filled block, or NULL.
+   */
+  struct touch_arena_block *prev;
+
+  /**
+   * Number of bytes used in @ref data.
+   */
+  size_t len;
+
+  /**
+   * Number of bytes available in @ref data.
+   */
+  size_t sz;
+
+  /**
+   * Block memory, allocated right after this header.
+   */
+  char *data;
+};
+
+/**
+ * Bump-pointer allocator for strings that all get freed at once.
+ */
+struct touch_arena{
+  /**
+   * Block currently getting filled, or NULL if nothing allocated yet.
+   */
+  struct touch_arena_block *block;
+};
+
+/**
+ * Copy a string into an arena.
+ *
+ * @param[in,out] arena See @ref touch_arena.
+ * @param[in]     str   String to copy.
+ * @return              Copy of @p str, or NULL if out of memory.
+ */
+static char *
+touch_arena_strdup(struct touch_arena *const arena,
+                   const char *const str){
+  struct touch_arena_block *block;
+  char *copy;
+  size_t len;
+  size_t sz;
+
+  copy = NULL;
+  len = strlen(str) + 1;
+  block = arena->block;
+  if(block == NULL || block->sz - block->len < len){
+    sz = len > TOUCH_ARENA_BLOCK_SZ ? len : TOUCH_ARENA_BLOCK_SZ;
+    block = malloc(sizeof(*block) + sz);
+    if(block){
+      block->prev = arena->block;
+      block->len = 0;
+      block->sz = sz;
+      block->data = (char *)(block + 1);
+      arena->block = block;
+    }
+  }
+  if(block){
+    copy = &block->data[block->len];
+    memcpy(copy, str, len);
+    block->len += len;
+  }
+  return copy;
+}
+
+/**
+ * Free everything allocated from an arena.
+ *
+ * @param[in,out] arena See @ref touch_arena.
+ */
+static void
+touch_arena_free(struct touch_arena *const arena){
+  struct touch_arena_block *prev;
+
+  while(arena->block){
+    prev = arena->block->prev;
+    free(arena->block);
+    arena->block = prev;
+  }
+}
+
+/**
+ * Subdirectories collected to get walked by the worker threads.
+ */
+struct touch_subdirs{
+  /**
+   * Subdirectory paths allocated from @ref arena.
+   */
+  char **paths;
+
+  /**
+   * Holds the strings in @ref paths, which all get released once the
+   * subdirectories have been walked.
+   */
+  struct touch_arena arena;
+
+  /**
+   * Number of paths in @ref paths.
+   */
+  size_t len;
+
+  /**
+   * Number of paths allocated in @ref paths.
+   */
+  size_t sz;
+};
+
+/**
+ * Save a subdirectory path to get walked later.
+ *
+ * @param[in,out] subdirs See @ref touch_subdirs.
+ * @param[in]     path    Path to subdirectory.
+ * @retval        true    Saved the path.
+ * @retval        false   Failed to allocate memory.
+ */
+static bool
+touch_subdirs_add(struct touch_subdirs *const subdirs,
+                  const char *const path){
+  char **paths;
+  size_t sz;
+  bool added;
+
+  added = false;
+  if(subdirs->len == subdirs->sz){
+    sz = subdirs->sz * 2 + 16;
+    paths = realloc(subdirs->paths, sz * sizeof(*paths));
+    if(paths){
+      subdirs->paths = paths;
+      subdirs->sz = sz;
+    }
+  }
+  if(subdirs->len < subdirs->sz){
+    subdirs->paths[subdirs->len] = touch_arena_strdup(&subdirs->arena, path);
+    if(subdirs->paths[subdirs->len]){
+      subdirs->len += 1;
+      added = true;
+    }
+  }
+  return added;
+}
+
+static void
+touch_tree_walk(struct touch *const touch,
+                const int fd,
+                char *const path,
+                const size_t path_len,
+                struct touch_subdirs *const subdirs);
+
+/**
+ * Touch one directory entry and walk into it if it is a directory.
+ *
+ * The entry gets touched relative to the directory file descriptor using
+ * the file type from readdir(), so entries do not need a separate stat()
+ * unless the file system does not report the type.
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in]     dir_fd   Directory file descriptor containing @p ent.
+ * @param[in]     ent      Directory entry.
+ * @param[in,out] path     See @ref touch_tree_walk.
+ * @param[in]     path_len See @ref touch_tree_walk.
+ * @param[in,out] subdirs  See @ref touch_tree_walk.
+ */
+static void
+touch_tree_entry(struct touch *const touch,
+                 const int dir_fd,
+                 const struct dirent *const ent,
+                 char *const path,
+                 const size_t path_len,
+                 struct touch_subdirs *const subdirs){
+  const int oflags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+  struct stat sb;
+  size_t name_len;
+  bool is_dir;
+  int fd;
+
+  name_len = strlen(ent->d_name);
+  if(path_len + 1 + name_len >= PATH_MAX){
+    path[path_len] = '\0';
+    errno = ENAMETOOLONG;
+    touch_warn(touch, true, "%s/%s", path, ent->d_name);
+  }
+  else{
+    path[path_len] = '/';
+    memcpy(&path[path_len + 1], ent->d_name, name_len + 1);
+    if(touch->ref_root && !touch_ref_times(touch, path)){
+      /* Leave entries without a reference file alone. */
+    }
+    else if(touch->flags & TOUCH_FLAG_PLAN){
+      touch_plan_target(touch, dir_fd, ent->d_name, path, AT_SYMLINK_NOFOLLOW);
+    }
+    else if(touch_utimensat(touch,
+                            dir_fd,
+                            ent->d_name,
+                            AT_SYMLINK_NOFOLLOW) != 0){
+      touch_warn(touch, true, "utimensat on: %s", path);
+    }
+    is_dir = (ent->d_type == DT_DIR);
+    if(ent->d_type == DT_UNKNOWN &&
+       fstatat(dir_fd, ent->d_name, &sb, AT_SYMLINK_NOFOLLOW) == 0){
+      is_dir = S_ISDIR(sb.st_mode);
+    }
+    if(!is_dir){
+      /* Nothing to walk. */
+    }
+    else if(subdirs && touch_subdirs_add(subdirs, path)){
+      /* Walk later using the worker threads. */
+    }
+    else{
+      fd = openat(dir_fd, ent->d_name, oflags);
+      touch->stats.opens += 1;
+      if(fd < 0){
+        touch_warn(touch, true, "open: %s", path);
+      }
+      else{
+        touch_tree_walk(touch, fd, path, path_len + 1 + name_len, NULL);
+      }
+    }
+  }
+}
+
+/**
+ * Touch every entry in a directory and walk into its subdirectories.
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in]     fd       Open directory file descriptor, which gets closed.
+ * @param[in,out] path     Buffer of size PATH_MAX containing the directory
+ *                         path, used to build the entry paths.
+ * @param[in]     path_len Length of the directory path in @p path.
+ * @param[in,out] subdirs  Save subdirectories here instead of walking them,
+ *                         or NULL to walk them now.
+ */
+static void
+touch_tree_walk(struct touch *const touch,
+                const int fd,
+                char *const path,
+                const size_t path_len,
+                struct touch_subdirs *const subdirs){
+  DIR *dir;
+  const struct dirent *ent;
+  struct stat sb;
+
+  if(touch->durable && fstat(fd, &sb) == 0){
+    touch_durable_add(touch, sb.st_dev, fd, NULL);
+  }
+  dir = fdopendir(fd);
+  if(dir == NULL){
+    path[path_len] = '\0';
+    touch_warn(touch, true, "fdopendir: %s", path);
+    close(fd);
+  }
+  else{
+    while((ent = readdir(dir)) != NULL){
+      if(strcmp(ent->d_name, ".") != 0 && strcmp(ent->d_name, "..") != 0){
+        touch_tree_entry(touch, fd, ent, path, path_len, subdirs);
+      }
+    }
+    closedir(dir);
+  }
+}
+
+/**
+ * Open a directory operand and walk it, collecting the subdirectories
+ * instead of walking them if @p subdirs has been provided.
+ *
+ * Operands that are not directories get ignored.
+ *
+ * @param[in,out] touch   See @ref touch.
+ * @param[in]     path    Directory path.
+ * @param[in,out] subdirs See @ref touch_tree_walk.
+ */
+static void
+touch_tree_open(struct touch *const touch,
+                const char *const path,
+                struct touch_subdirs *const subdirs){
+  char *path_buf;
+  size_t path_len;
+  int fd;
+
+  fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  touch->stats.opens += 1;
+  if(fd < 0){
+    if(errno != ENOTDIR && errno != ENOENT){
+      touch_warn(touch, true, "open: %s", path);
+    }
+  }
+  else{
+    path_len = strlen(path);
+    while(path_len > 1 && path[path_len - 1] == '/'){
+      path_len -= 1;
+    }
+    path_buf = malloc(PATH_MAX);
+    if(path_buf == NULL){
+      touch_warn(touch, true, "malloc: path");
+      close(fd);
+    }
+    else if(path_len >= PATH_MAX){
+      errno = ENAMETOOLONG;
+      touch_warn(touch, true, "open: %s", path);
+      close(fd);
+    }
+    else{
+      memcpy(path_buf, path, path_len);
+      if(path_len == 1 && path[0] == '/'){
+        path_len = 0;
+      }
+      touch_tree_walk(touch, fd, path_buf, path_len, subdirs);
+    }
+    free(path_buf);
+  }
+}
+
+/**
+ * Walk a subdirectory in a worker thread.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     path  Directory path.
+ */
+static void
+touch_tree_path(struct touch *const touch,
+                const char *const path){
+  touch_tree_open(touch, path, NULL);
+}
+
+/**
+ * Touch everything inside of a directory operand (-R).
+ *
+ * With -j, the subdirectories of the operand get walked in parallel by the
+ * worker threads.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     path  Directory path.
+ */
+static void
+touch_tree(struct touch *const touch,
+           const char *const path){
+  struct touch_subdirs subdirs;
+  size_t i;
+
+  memset(&subdirs, 0, sizeof(subdirs));
+  touch_tree_open(touch, path, touch->jobs > 1 ? &subdirs : NULL);
+  if(subdirs.len > 1 &&
+     touch_pool_run(touch,
+                    (const char *const *)subdirs.paths,
+                    subdirs.len,
+                    touch_tree_path)){
+    /* Walked all subdirectories using the worker threads. */
+  }
+  else{
+    for(i = 0; i < subdirs.len; i++){
+      touch_tree_path(touch, subdirs.paths[i]);
+    }
+  }
+  touch_arena_free(&subdirs.arena);
+  free(subdirs.paths);
+}
+
+/**
+ * Target path along with the keys used to order the targets (--sort).
+ */
+struct touch_sort_key{
+  /**
+   * Target path.
+   */
+  const char *path;
+
+  /**
+   * Length of the parent directory part of @ref path, including the
+   * trailing slash, or 0 if in the current directory.
+   */
+  size_t dir_len;
+
+  /**
+   * Inode number from the parent directory, or 0 if not known.
+   */
+  ino_t ino;
+
+  /**
+   * Original position of the target.
+   */
+  size_t index;
+};
+
+/**
+ * Compare the parent directories of two targets.
+ *
+ * @param[in] a  First target.
+ * @param[in] b  Second target.
+ * @return       Less than, equal to, or greater than 0 like strcmp().
+ */
+static int
+touch_sort_dir_cmp(const struct touch_sort_key *const a,
+                   const struct touch_sort_key *const b){
+  int cmp;
+
+  cmp = memcmp(a->path, b->path, a->dir_len < b->dir_len ?
+                                 a->dir_len : b->dir_len);
+  if(cmp == 0){
+    cmp = (a->dir_len > b->dir_len) - (a->dir_len < b->dir_len);
+  }
+  return cmp;
+}
+
+/**
+ * Compare two targets in the same directory by name, for qsort() and
+ * bsearch().
+ *
+ * @param[in] a  First target.
+ * @param[in] b  Second target.
+ * @return       Less than, equal to, or greater than 0 like strcmp().
+ */
+static int
+touch_sort_name_cmp(const void *const a,
+                    const void *const b){
+  const struct touch_sort_key *key_a;
+  const struct touch_sort_key *key_b;
+
+  key_a = a;
+  key_b = b;
+  return strcmp(&key_a->path[key_a->dir_len], &key_b->path[key_b->dir_len]);
+}
+
+/**
+ * Compare two targets by parent directory and then by name, for qsort().
+ *
+ * @param[in] a  First target.
+ * @param[in] b  Second target.
+ * @return       Less than, equal to, or greater than 0 like strcmp().
+ */
+static int
+touch_sort_path_cmp(const void *const a,
+                    const void *const b){
+  int cmp;
+
+  cmp = touch_sort_dir_cmp(a, b);
+  if(cmp == 0){
+    cmp = touch_sort_name_cmp(a, b);
+  }
+  return cmp;
+}
+
+/**
+ * Compare two targets by parent directory, then by inode number with
+ * unknown inode numbers last, and then by original position, for qsort().
+ *
+ * @param[in] a  First target.
+ * @param[in] b  Second target.
+ * @return       Less than, equal to, or greater than 0.
+ */
+static int
+touch_sort_ino_cmp(const void *const a,
+                   const void *const b){
+  const struct touch_sort_key *key_a;
+  const struct touch_sort_key *key_b;
+  int cmp;
+
+  key_a = a;
+  key_b = b;
+  cmp = touch_sort_dir_cmp(key_a, key_b);
+  if(cmp != 0){
+    /* Different directories. */
+  }
+  else if(key_a->ino != key_b->ino){
+    cmp = (key_a->ino == 0 || (key_b->ino != 0 && key_a->ino > key_b->ino)) ?
+          1 : -1;
+  }
+  else{
+    cmp = (key_a->index > key_b->index) - (key_a->index < key_b->index);
+  }
+  return cmp;
+}
+
+/**
+ * Read a directory to find the inode numbers of the targets in it.
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in,out] keys     Targets in the same directory sorted by name.
+ * @param[in]     num_keys Number of targets in @p keys.
+ */
+static void
+touch_sort_scan(struct touch *const touch,
+                struct touch_sort_key *const keys,
+                const size_t num_keys){
+  const int oflags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+  char dir_path[PATH_MAX];
+  struct touch_sort_key *found;
+  struct touch_sort_key key;
+  const struct dirent *ent;
+  DIR *dir;
+  int fd;
+
+  fd = -1;
+  if(keys[0].dir_len == 0){
+    fd = open(".", oflags);
+  }
+  else if(keys[0].dir_len < sizeof(dir_path)){
+    memcpy(dir_path, keys[0].path, keys[0].dir_len);
+    dir_path[keys[0].dir_len] = '\0';
+    fd = open(dir_path, oflags);
+  }
+  touch->stats.opens += 1;
+  dir = (fd < 0) ? NULL : fdopendir(fd);
+  if(dir == NULL){
+    /* Keep the original order for this directory. */
+    if(fd >= 0){
+      close(fd);
+    }
+  }
+  else{
+    key.dir_len = 0;
+    while((ent = readdir(dir)) != NULL){
+      key.path = ent->d_name;
+      found = bsearch(&key,
+                      keys,
+                      num_keys,
+                      sizeof(*keys),
+                      touch_sort_name_cmp);
+      if(found){
+        found->ino = ent->d_ino;
+      }
+    }
+    closedir(dir);
+  }
+}
+
+/**
+ * Order the targets so that the targets in each directory get touched
+ * together (--sort).
+ *
+ * Directories with many targets get read to order their targets by inode
+ * number, which usually matches the order of the inodes on disk. Other
+ * targets keep their original order within each directory.
+ *
+ * @param[in,out] touch     See @ref touch.
+ * @param[in]     paths     Paths to touch.
+ * @param[in]     num_paths Number of paths in @p paths.
+ * @return                  Allocated list of the sorted paths, or NULL if
+ *                          failed to allocate memory.
+ */
+static const char **
+touch_sort_paths(struct touch *const touch,
+                 const char *const paths[],
+                 const size_t num_paths){
+  struct touch_sort_key *keys;
+  const char **sorted;
+  const char *slash;
+  size_t first;
+  size_t last;
+  size_t i;
+
+  sorted = NULL;
+  keys = malloc(num_paths * sizeof(*keys));
+  if(keys){
+    for(i = 0; i < num_paths; i++){
+      slash = strrchr(paths[i], '/');
+      keys[i].path = paths[i];
+      keys[i].dir_len = slash ? (size_t)(slash - paths[i]) + 1 : 0;
+      keys[i].ino = 0;
+      keys[i].index = i;
+    }
+    qsort(keys, num_paths, sizeof(*keys), touch_sort_path_cmp);
+    for(first = 0; first < num_paths; first = last){
+      last = first + 1;
+      while(last < num_paths &&
+            touch_sort_dir_cmp(&keys[first], &keys[last]) == 0){
+        last += 1;
+      }
+      if(last - first >= TOUCH_SORT_SCAN_MIN){
+        touch_sort_scan(touch, &keys[first], last - first);
+      }
+    }
+    qsort(keys, num_paths, sizeof(*keys), touch_sort_ino_cmp);
+    sorted = malloc(num_paths * sizeof(*sorted));
+    for(i = 0; sorted && i < num_paths; i++){
+      sorted[i] = keys[i].path;
+    }
+    free(keys);
+  }
+  return sorted;
+}
+
+/**
+ * Choose the function that touches each path.
+ *
+ * @param[in] touch See @ref touch.
+ * @return          Function that touches one path.
+ */
+static void
+(*touch_apply_fn(const struct touch *const touch))(struct touch *const touch,
+                                                   const char *const path){
+  void (*fn)(struct touch *const touch,
+             const char *const path);
+
+  fn = touch_path_fn(touch);
+  if(touch->flags & TOUCH_FLAG_PLAN){
+    fn = touch_plan_path;
+  }
+  else if(touch->ref_root){
+    fn = touch_ref_path;
+  }
+  else if((touch->flags & TOUCH_FLAG_NEW) &&
+          !(touch->flags & TOUCH_FLAG_NO_CREATE)){
+    fn = touch_new_path;
+  }
+  if(touch->durable){
+    fn = touch_durable_path;
+  }
+  return fn;
+}
+
+/**
+ * Touch a list of paths, using worker threads if requested by -j or the
+ * io_uring engine if requested by --io-uring.
+ *
+ * Each path gets the times of its reference file when using --ref-root,
+ * which does not use the io_uring engine since it only has one set of
+ * times for every request. The io_uring engine does not get used with
+ * --new-files either, which already creates each file using one call.
+ *
+ * @param[in,out] touch     See @ref touch.
+ * @param[in]     paths     Paths to touch.
+ * @param[in]     num_paths Number of paths in @p paths.
+ */
+static void
+touch_apply(struct touch *const touch,
+            const char *const paths[],
+            const size_t num_paths){
+  void (*fn)(struct touch *const touch,
+             const char *const path);
+  const char **sorted;
+  unsigned long start;
+  size_t i;
+
+  start = touch_stats_clock(touch);
+  sorted = NULL;
+  if((touch->flags & TOUCH_FLAG_SORT) && num_paths > 1){
+    sorted = touch_sort_paths(touch, paths, num_paths);
+  }
+  if(sorted){
+    paths = (const char *const *)sorted;
+  }
+  fn = touch_apply_fn(touch);
+  if(touch->jobs > 1 &&
+     num_paths > 1 &&
+     touch_pool_run(touch, paths, num_paths, fn)){
+    /* Touched all paths using the worker threads. */
+  }
+#ifdef TOUCH_IO_URING
+  else if(touch->uring && fn == touch_path_fn(touch)){
+    touch_uring_apply(touch, paths, num_paths);
+  }
+#endif /* TOUCH_IO_URING */
+  else{
+    for(i = 0; i < num_paths; i++){
+      fn(touch, paths[i]);
+    }
+    touch_close_flush(touch);
+  }
+  if(touch->flags & TOUCH_FLAG_RECURSIVE){
+    for(i = 0; i < num_paths; i++){
+      touch_tree(touch, paths[i]);
+    }
+  }
+  free(sorted);
+  touch->stats.fs_ns += touch_stats_clock(touch) - start;
+}
+
+/**
+ * Path component in a compiled pattern (--glob).
+ */
+struct touch_glob_comp{
+  /**
+   * One of @ref TOUCH_GLOB_LITERAL, @ref TOUCH_GLOB_ANY,
+   * @ref TOUCH_GLOB_PREFIX, @ref TOUCH_GLOB_SUFFIX,
+   * @ref TOUCH_GLOB_FNMATCH, or @ref TOUCH_GLOB_RECURSE.
+   */
+  int type;
+
+  /**
+   * Component pattern, or the literal part of the pattern for
+   * @ref TOUCH_GLOB_PREFIX and @ref TOUCH_GLOB_SUFFIX.
+   */
+  const char *str;
+
+  /**
+   * Length of @ref str.
+   */
+  size_t len;
+
+  /**
+   * Pattern starts with a '.', so it can match hidden entries.
+   */
+  bool dot;
+};
+
+/**
+ * Pattern compiled once before walking the directories it can match.
+ */
+struct touch_glob{
+  /**
+   * Function used to touch each match.
+   */
+  void (*fn)(struct touch *const touch,
+             const char *const path);
+
+  /**
+   * Path components of the pattern.
+   */
+  struct touch_glob_comp *comps;
+
+  /**
+   * Number of components in @ref comps.
+   */
+  size_t num_comps;
+
+  /**
+   * Buffer of size PATH_MAX used to build the path of each match.
+   */
+  char *path;
+};
+
+/**
+ * Check if a path contains any pattern characters (--glob).
+ *
+ * @param[in] path  Path to check.
+ * @retval    true  @p path needs to get expanded.
+ * @retval    false @p path only matches itself.
+ */
+static bool
+touch_glob_is_pattern(const char *const path){
+  return strpbrk(path, TOUCH_GLOB_META) != NULL;
+}
+
+/**
+ * Compile a pattern into path components, choosing the quickest way to
+ * match each component.
+ *
+ * @param[in]  pattern Pattern to compile.
+ * @param[out] glob    See @ref touch_glob.
+ * @param[out] buf     Memory with the size returned by
+ *                     @ref touch_glob_size.
+ */
+static void
+touch_glob_compile(const char *const pattern,
+                   struct touch_glob *const glob,
+                   char *const buf){
+  struct touch_glob_comp *comp;
+  char *str;
+  char *end;
+  size_t len;
+
+  len = strlen(pattern);
+  glob->comps = (struct touch_glob_comp *)(void *)buf;
+  glob->path = &buf[(len + 1) * sizeof(*glob->comps)];
+  str = &glob->path[PATH_MAX];
+  memcpy(str, pattern, len + 1);
+  glob->num_comps = 0;
+  while(*str){
+    end = strchr(str, '/');
+    if(end){
+      *end = '\0';
+    }
+    len = strlen(str);
+    if(len > 0){
+      comp = &glob->comps[glob->num_comps++];
+      comp->str = str;
+      comp->len = len;
+      comp->dot = (str[0] == '.');
+      if(!touch_glob_is_pattern(str)){
+        comp->type = TOUCH_GLOB_LITERAL;
+      }
+      else if(strcmp(str, "**") == 0){
+        comp->type = TOUCH_GLOB_RECURSE;
+      }
+      else if(strcmp(str, "*") == 0){
+        comp->type = TOUCH_GLOB_ANY;
+      }
+      else if(str[0] == '*' && !touch_glob_is_pattern(&str[1])){
+        comp->type = TOUCH_GLOB_SUFFIX;
+        comp->str = &str[1];
+        comp->len = len - 1;
+      }
+      else if(strcspn(str, TOUCH_GLOB_META) == len - 1 &&
+              str[len - 1] == '*'){
+        comp->type = TOUCH_GLOB_PREFIX;
+        comp->len = len - 1;
+      }
+      else{
+        comp->type = TOUCH_GLOB_FNMATCH;
+      }
+    }
+    str += len;
+    if(end){
+      str += 1;
+    }
+  }
+}
+
+/**
+ * Get the amount of memory needed to compile a pattern.
+ *
+ * @param[in] pattern Pattern to compile.
+ * @return            Size needed by @ref touch_glob_compile.
+ */
+static size_t
+touch_glob_size(const char *const pattern){
+  size_t len;
+
+  len = strlen(pattern);
+  return (len + 1) * sizeof(struct touch_glob_comp) + PATH_MAX + len + 1;
+}
+
+/**
+ * Check if a directory entry name matches a pattern component.
+ *
+ * Hidden entries only match components that start with a '.'.
+ *
+ * @param[in] comp  See @ref touch_glob_comp.
+ * @param[in] name  Directory entry name.
+ * @retval    true  @p name matches @p comp.
+ * @retval    false @p name does not match @p comp.
+ */
+static bool
+touch_glob_match(const struct touch_glob_comp *const comp,
+                 const char *const name){
+  size_t len;
+  bool match;
+
+  if(name[0] == '.' && !comp->dot){
+    match = false;
+  }
+  else if(comp->type == TOUCH_GLOB_ANY || comp->type == TOUCH_GLOB_RECURSE){
+    match = true;
+  }
+  else if(comp->type == TOUCH_GLOB_PREFIX){
+    match = (strncmp(name, comp->str, comp->len) == 0);
+  }
+  else if(comp->type == TOUCH_GLOB_SUFFIX){
+    len = strlen(name);
+    match = (len >= comp->len &&
+             memcmp(&name[len - comp->len], comp->str, comp->len) == 0);
+  }
+  else{
+    match = (fnmatch(comp->str, name, FNM_PERIOD) == 0);
+  }
+  return match;
+}
+
+/**
+ * Touch a path matching the whole pattern, and everything inside of it
+ * with -R.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     glob  See @ref touch_glob.
+ */
+static void
+touch_glob_touch(struct touch *const touch,
+                 const struct touch_glob *const glob){
+  glob->fn(touch, glob->path);
+  if(touch->flags & TOUCH_FLAG_RECURSIVE){
+    touch_tree(touch, glob->path);
+  }
+}
+
+static void
+touch_glob_walk(struct touch *const touch,
+                struct touch_glob *const glob,
+                const size_t i,
+                const int dir_fd,
+                const size_t path_len);
+
+/**
+ * Handle a directory entry matching a pattern component by touching it if
+ * it matches the whole pattern, or by walking into it otherwise.
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in,out] glob     See @ref touch_glob.
+ * @param[in]     i        Index of the matched component.
+ * @param[in]     dir_fd   Directory file descriptor containing @p name.
+ * @param[in]     name     Matching entry name.
+ * @param[in]     d_type   File type from readdir(), or DT_UNKNOWN.
+ * @param[in]     path_len Length of the directory path in
+ *                         @ref touch_glob::path.
+ */
+static void
+touch_glob_entry(struct touch *const touch,
+                 struct touch_glob *const glob,
+                 const size_t i,
+                 const int dir_fd,
+                 const char *const name,
+                 const unsigned char d_type,
+                 const size_t path_len){
+  const struct touch_glob_comp *comp;
+  struct stat sb;
+  size_t name_len;
+  size_t len;
+  bool last;
+  bool is_dir;
+  int fd;
+
+  comp = &glob->comps[i];
+  last = (i + 1 == glob->num_comps);
+  name_len = strlen(name);
+  len = path_len;
+  if(len > 0 && glob->path[len - 1] != '/'){
+    glob->path[len++] = '/';
+  }
+  if(len + name_len >= PATH_MAX){
+    glob->path[path_len] = '\0';
+    errno = ENAMETOOLONG;
+    touch_warn(touch, true, "%s/%s", glob->path, name);
+  }
+  else{
+    memcpy(&glob->path[len], name, name_len + 1);
+    len += name_len;
+    if(comp->type == TOUCH_GLOB_RECURSE){
+      if(last){
+        touch_glob_touch(touch, glob);
+      }
+      is_dir = (d_type == DT_DIR);
+      if(d_type == DT_UNKNOWN &&
+         fstatat(dir_fd, name, &sb, AT_SYMLINK_NOFOLLOW) == 0){
+        is_dir = S_ISDIR(sb.st_mode);
+      }
+      if(is_dir){
+        fd = openat(dir_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW |
+                                  O_CLOEXEC);
+        touch->stats.opens += 1;
+        if(fd < 0){
+          touch_warn(touch, true, "open: %s", glob->path);
+        }
+        else{
+          touch_glob_walk(touch, glob, i, fd, len);
+          close(fd);
+        }
+      }
+    }
+    else if(last){
+      if(comp->type != TOUCH_GLOB_LITERAL ||
+         fstatat(dir_fd, name, &sb, AT_SYMLINK_NOFOLLOW) == 0){
+        touch_glob_touch(touch, glob);
+      }
+    }
+    else if(d_type == DT_DIR || d_type == DT_LNK || d_type == DT_UNKNOWN){
+      fd = openat(dir_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      touch->stats.opens += 1;
+      if(fd >= 0){
+        touch_glob_walk(touch, glob, i + 1, fd, len);
+        close(fd);
+      }
+      else if(errno != ENOTDIR && errno != ENOENT){
+        touch_warn(touch, true, "open: %s", glob->path);
+      }
+    }
+  }
+}
+
+/**
+ * Match one pattern component against a directory.
+ *
+ * Literal components get looked up directly instead of reading the
+ * directory, so only the directories that can contain a match get read.
+ * A "**" component matches zero or more directories, without walking
+ * into hidden directories or following symbolic links.
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in,out] glob     See @ref touch_glob.
+ * @param[in]     i        Index of the component to match.
+ * @param[in]     dir_fd   Directory file descriptor, which stays open.
+ * @param[in]     path_len Length of the directory path in
+ *                         @ref touch_glob::path.
+ */
+static void
+touch_glob_walk(struct touch *const touch,
+                struct touch_glob *const glob,
+                const size_t i,
+                const int dir_fd,
+                const size_t path_len){
+  const struct touch_glob_comp *comp;
+  const struct dirent *ent;
+  DIR *dir;
+  int fd;
+
+  comp = &glob->comps[i];
+  if(comp->type == TOUCH_GLOB_LITERAL){
+    touch_glob_entry(touch, glob, i, dir_fd, comp->str, DT_UNKNOWN, path_len);
+  }
+  else{
+    if(comp->type == TOUCH_GLOB_RECURSE && i + 1 < glob->num_comps){
+      touch_glob_walk(touch, glob, i + 1, dir_fd, path_len);
+    }
+    glob->path[path_len] = '\0';
+    fd = openat(dir_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    touch->stats.opens += 1;
+    dir = NULL;
+    if(fd < 0){
+      touch_warn(touch, true, "open: %s", path_len ? glob->path : ".");
+    }
+    else{
+      dir = fdopendir(fd);
+    }
+    if(fd < 0){
+      /* Already printed an error. */
+    }
+    else if(dir == NULL){
+      touch_warn(touch, true, "fdopendir: %s", path_len ? glob->path : ".");
+      close(fd);
+    }
+    else{
+      while((ent = readdir(dir)) != NULL){
+        if(strcmp(ent->d_name, ".") != 0 &&
+           strcmp(ent->d_name, "..") != 0 &&
+           touch_glob_match(comp, ent->d_name)){
+          touch_glob_entry(touch,
+                           glob,
+                           i,
+                           fd,
+                           ent->d_name,
+                           ent->d_type,
+                           path_len);
+        }
+      }
+      closedir(dir);
+    }
+  }
+}
+
+/**
+ * Touch every existing path matching a pattern (--glob).
+ *
+ * Matches get touched while walking the directories instead of collecting
+ * them first, and get walked with -R. Patterns that do not match anything
+ * get ignored.
+ *
+ * @param[in,out] touch   See @ref touch.
+ * @param[in]     pattern Pattern to expand.
+ */
+static void
+touch_glob(struct touch *const touch,
+           const char *const pattern){
+  struct touch_glob glob;
+  char *buf;
+  unsigned long start;
+  size_t path_len;
+  int fd;
+
+  start = touch_stats_clock(touch);
+  buf = malloc(touch_glob_size(pattern));
+  if(buf == NULL){
+    touch_warn(touch, true, "malloc: pattern");
+  }
+  else{
+    glob.fn = touch_apply_fn(touch);
+    touch_glob_compile(pattern, &glob, buf);
+    fd = AT_FDCWD;
+    path_len = 0;
+    if(pattern[0] == '/'){
+      glob.path[path_len++] = '/';
+      fd = open("/", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      touch->stats.opens += 1;
+    }
+    if(fd < 0 && fd != AT_FDCWD){
+      touch_warn(touch, true, "open: /");
+    }
+    else{
+      touch_glob_walk(touch, &glob, 0, fd, path_len);
+      touch_close_flush(touch);
+    }
+    if(fd >= 0){
+      close(fd);
+    }
+    free(buf);
+  }
+  touch->stats.fs_ns += touch_stats_clock(touch) - start;
+}
+
+/**
+ * Touch the file operands, expanding any patterns when using --glob.
+ *
+ * Operands without pattern characters get touched the usual way, so they
+ * still get created if they do not exist.
+ *
+ * @param[in,out] touch     See @ref touch.
+ * @param[in]     paths     File operands.
+ * @param[in]     num_paths Number of paths in @p paths.
+ */
+static void
+touch_operands(struct touch *const touch,
+               const char *const paths[],
+               const size_t num_paths){
+  size_t first;
+  size_t i;
+
+  first = 0;
+  for(i = 0; (touch->flags & TOUCH_FLAG_GLOB) && i < num_paths; i++){
+    if(touch_glob_is_pattern(paths[i])){
+      touch_apply(touch, &paths[first], i - first);
+      touch_glob(touch, paths[i]);
+      first = i + 1;
+    }
+  }
+  touch_apply(touch, &paths[first], num_paths - first);
+}
+
+/**
+ * Release the memory of a mapped list before a position, once none of the
+ * paths before that position get used anymore.
+ *
+ * @param[in,out] list See @ref touch_list.
+ * @param[in]     end  Position in @ref touch_list::map, or NULL.
+ */
+static void
+touch_list_release(struct touch_list *const list,
+                   const char *const end){
+  size_t page_sz;
+  size_t offset;
+
+  if(list->map && end){
+    page_sz = (size_t)sysconf(_SC_PAGESIZE);
+    offset = (size_t)(end - list->map) / page_sz * page_sz;
+    if(offset > list->map_released){
+      madvise(&list->map[list->map_released],
+              offset - list->map_released,
+              MADV_DONTNEED);
+      list->map_released = offset;
+    }
+  }
+}
+
+/**
+ * Move the window of a mapped list forward to start at the partial path at
+ * the end of the current window.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in,out] list  See @ref touch_list.
+ */
+static void
+touch_list_advance(struct touch *const touch,
+                   struct touch_list *const list){
+  size_t offset;
+
+  offset = (size_t)(list->buf - list->map) + list->pos;
+  if(list->pos == 0 && list->len == TOUCH_LIST_BUF_SZ){
+    if(!list->skip){
+      touch_warn(touch, false, "path in list too long");
+    }
+    list->skip = true;
+    offset += list->len;
+  }
+  list->buf = &list->map[offset];
+  list->offset = offset;
+  list->pos = 0;
+  list->len = list->map_len - offset;
+  if(list->len > TOUCH_LIST_BUF_SZ){
+    list->len = TOUCH_LIST_BUF_SZ;
+  }
+  list->eof = (offset + list->len == list->map_len);
+}
+
+/**
+ * Refill the list buffer after moving any partial path to the beginning.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in,out] list  See @ref touch_list.
+ * @param[out]    buf   Buffer to continue reading into, which becomes the
+ *                      new @ref touch_list::buf and can be the current one.
+ *                      Ignored when the list has been mapped into memory,
+ *                      which moves the window forward instead.
+ */
+static void
+touch_list_fill(struct touch *const touch,
+                struct touch_list *const list,
+                char *const buf){
+  ssize_t bytes_read;
+  unsigned long start;
+
+  if(list->map){
+    touch_list_advance(touch, list);
+  }
+  else{
+    if(list->pos == 0 && list->len == TOUCH_LIST_BUF_SZ){
+      if(!list->skip){
+        touch_warn(touch, false, "path in list too long");
+      }
+      list->skip = true;
+      list->offset += list->len;
+      list->len = 0;
+    }
+    else{
+      memmove(buf, &list->buf[list->pos], list->len - list->pos);
+      list->offset += list->pos;
+      list->len -= list->pos;
+    }
+    list->buf = buf;
+    list->pos = 0;
+    start = touch_stats_clock(touch);
+    bytes_read = read(list->fd,
+                      &list->buf[list->len],
+                      TOUCH_LIST_BUF_SZ - list->len);
+    touch->stats.fs_ns += touch_stats_clock(touch) - start;
+    if(bytes_read < 0){
+      touch_warn(touch, true, "read list");
+      list->eof = true;
+    }
+    else if(bytes_read == 0){
+      list->eof = true;
+    }
+    else{
+      list->len += (size_t)bytes_read;
+    }
+  }
+}
+
+/**
+ * Get the next path from a list.
+ *
+ * Empty paths get skipped. Refilling the buffer moves the remaining data,
+ * which invalidates any paths previously returned, so callers holding on
+ * to those paths must disable @p refill.
+ *
+ * @param[in,out] touch  See @ref touch.
+ * @param[in,out] list   See @ref touch_list.
+ * @param[in]     refill Allow reading more data from the list.
+ * @return               NUL-terminated path inside the list buffer, or NULL
+ *                       if no more paths remain or the buffer needs a
+ *                       refill that has not been allowed.
+ */
+static char *
+touch_list_next(struct touch *const touch,
+                struct touch_list *const list,
+                const bool refill){
+  char *path;
+  char *end;
+  size_t path_len;
+  bool more;
+
+  path = NULL;
+  more = true;
+  while(path == NULL && more && (list->pos < list->len || !list->eof)){
+    end = memchr(&list->buf[list->pos], list->delim, list->len - list->pos);
+    if(end == NULL && !list->eof){
+      if(refill){
+        touch_list_release(list, &list->buf[list->pos]);
+        touch_list_fill(touch, list, list->buf);
+      }
+      else{
+        more = false;
+      }
+    }
+    else{
+      if(end == NULL){
+        end = &list->buf[list->len];
+      }
+      *end = '\0';
+      path_len = (size_t)(end - &list->buf[list->pos]);
+      if(list->skip){
+        list->skip = false;
+      }
+      else if(path_len > 0){
+        path = &list->buf[list->pos];
+      }
+      list->pos += path_len;
+      if(list->pos < list->len){
+        list->pos += 1;
+      }
+    }
+  }
+  return path;
+}
+
+/**
+ * Map a list into memory if it is a regular file larger than the read
+ * buffer.
+ *
+ * The file gets mapped over an anonymous mapping one byte larger, so the
+ * last path can get NUL-terminated even if it does not end with a
+ * delimiter and the file size is a multiple of the page size.
+ *
+ * @param[in,out] list See @ref touch_list.
+ */
+static void
+touch_list_map(struct touch_list *const list){
+  struct stat sb;
+  char *map;
+  size_t len;
+
+  if(fstat(list->fd, &sb) == 0 &&
+     S_ISREG(sb.st_mode) &&
+     sb.st_size > TOUCH_LIST_BUF_SZ &&
+     (off_t)(size_t)sb.st_size == sb.st_size){
+    len = (size_t)sb.st_size;
+    map = mmap(NULL,
+               len + 1,
+               PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS,
+               -1,
+               0);
+    if(map == MAP_FAILED){
+      /* Read the list instead. */
+    }
+    else if(mmap(map,
+                 len,
+                 PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_FIXED,
+                 list->fd,
+                 0) == MAP_FAILED){
+      munmap(map, len + 1);
+    }
+    else{
+      madvise(map, len, MADV_SEQUENTIAL);
+      list->map = map;
+      list->map_len = len;
+      list->buf = map;
+    }
+  }
+}
+
+/**
+ * Open a list and allocate its read buffer, or map it into memory.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[out]    list  See @ref touch_list.
+ * @param[in]     path  Path to the list, or "-" to read from STDIN.
+ * @param[in]     delim See @ref touch_list::delim.
+ * @retval        true  Opened the list.
+ * @retval        false Failed to open the list.
+ */
+static bool
+touch_list_open(struct touch *const touch,
+                struct touch_list *const list,
+                const char *const path,
+                const char delim){
+  bool success;
+
+  success = false;
+  memset(list, 0, sizeof(*list));
+  list->delim = delim;
+  if(strcmp(path, "-") == 0){
+    list->fd = STDIN_FILENO;
+  }
+  else{
+    list->fd = open(path, O_RDONLY);
+    touch->stats.opens += 1;
+  }
+  if(list->fd >= 0){
+    touch_list_map(list);
+  }
+  if(list->fd < 0){
+    touch_warn(touch, true, "open list: %s", path);
+  }
+  else if(list->map){
+    success = true;
+  }
+  else{
+    list->buf = malloc(TOUCH_LIST_BUF_SZ + 1);
+    if(list->buf == NULL){
+      touch_warn(touch, true, "malloc: list buffer");
+      if(list->fd != STDIN_FILENO){
+        close(list->fd);
+      }
+    }
+    else{
+      success = true;
+    }
+  }
+  return success;
+}
+
+/**
+ * Close a list opened by @ref touch_list_open.
+ *
+ * @param[in,out] list See @ref touch_list.
+ */
+static void
+touch_list_close(struct touch_list *const list){
+  if(list->map){
+    munmap(list->map, list->map_len + 1);
+  }
+  else{
+    free(list->buf);
+  }
+  if(list->fd != STDIN_FILENO){
+    close(list->fd);
+  }
+}
+
+/**
+ * Parse a number following a fixed prefix in a checkpoint.
+ *
+ * @param[in,out] parse  Position in the checkpoint, moved past the number.
+ * @param[in]     prefix Text that must come right before the number.
+ * @param[out]    value  Parsed number.
+ * @retval        true   Parsed the prefix and number.
+ * @retval        false  Missing prefix or invalid number.
+ */
+static bool
+touch_checkpoint_field(const char **const parse,
+                       const char *const prefix,
+                       unsigned long *const value){
+  char *ep;
+  size_t len;
+  bool success;
+
+  len = strlen(prefix);
+  success = (strncmp(*parse, prefix, len) == 0 &&
+             isdigit((unsigned char)(*parse)[len]));
+  if(success){
+    errno = 0;
+    *value = strtoul(&(*parse)[len], &ep, 10);
+    success = (errno == 0);
+    *parse = ep;
+  }
+  return success;
+}
+
+/**
+ * Parse a checkpoint saved by @ref touch_checkpoint_save.
+ *
+ * @param[out] checkpoint See @ref touch_checkpoint.
+ * @param[in]  buf        NUL-terminated checkpoint contents.
+ * @retval     true       Parsed the checkpoint.
+ * @retval     false      Invalid checkpoint.
+ */
+static bool
+touch_checkpoint_parse(struct touch_checkpoint *const checkpoint,
+                       const char *const buf){
+  const char *const ERRNO_KEY = ",\"errno\":{";
+  const char *parse;
+  const char *sep;
+  unsigned long slot;
+  unsigned long count;
+  bool success;
+
+  parse = buf;
+  success = (touch_checkpoint_field(&parse,
+                                    "{\"offset\":",
+                                    &checkpoint->offset) &&
+             touch_checkpoint_field(&parse,
+                                    ",\"targets\":",
+                                    &checkpoint->targets) &&
+             touch_checkpoint_field(&parse,
+                                    ",\"errors\":",
+                                    &checkpoint->errors) &&
+             checkpoint->offset <= LONG_MAX &&
+             strncmp(parse, ERRNO_KEY, strlen(ERRNO_KEY)) == 0);
+  if(success){
+    parse += strlen(ERRNO_KEY);
+  }
+  sep = "\"";
+  while(success && *parse != '}'){
+    success = (touch_checkpoint_field(&parse, sep, &slot) &&
+               slot < TOUCH_STATS_ERRNO_SZ &&
+               touch_checkpoint_field(&parse, "\":", &count));
+    if(success){
+      checkpoint->errnos[slot] = count;
+    }
+    sep = ",\"";
+  }
+  return success && strcmp(parse, "}}\n") == 0;
+}
+
+/**
+ * Load the checkpoint being resumed from @ref touch::checkpoint_path
+ * (--resume).
+ *
+ * A missing checkpoint starts from the beginning, so the same command can
+ * start a run and resume it.
+ *
+ * @param[in,out] touch      See @ref touch.
+ * @param[out]    checkpoint See @ref touch_checkpoint.
+ * @retval        true       Loaded the checkpoint, or it does not exist.
+ * @retval        false      Failed to read the checkpoint or it is invalid.
+ */
+static bool
+touch_checkpoint_load(struct touch *const touch,
+                      struct touch_checkpoint *const checkpoint){
+  char *const buf = checkpoint->buf;
+  ssize_t bytes_read;
+  int fd;
+  bool success;
+
+  success = false;
+  fd = open(touch->checkpoint_path, O_RDONLY);
+  touch->stats.opens += 1;
+  if(fd < 0 && errno == ENOENT){
+    success = true;
+  }
+  else if(fd < 0){
+    touch_warn(touch, true, "open checkpoint: %s", touch->checkpoint_path);
+  }
+  else{
+    bytes_read = read(fd, buf, TOUCH_CHECKPOINT_SZ - 1);
+    if(bytes_read < 0){
+      touch_warn(touch, true, "read checkpoint: %s", touch->checkpoint_path);
+    }
+    else{
+      buf[bytes_read] = '\0';
+      success = touch_checkpoint_parse(checkpoint, buf);
+      if(!success){
+        touch_warn(touch,
+                   false,
+                   "invalid checkpoint: %s",
+                   touch->checkpoint_path);
+      }
+    }
+    close(fd);
+  }
+  return success;
+}
+
+/**
+ * Read and throw away the start of a list that cannot seek, such as a
+ * pipe (--resume).
+ *
+ * @param[in,out] touch  See @ref touch.
+ * @param[in,out] list   See @ref touch_list.
+ * @param[in]     offset Number of bytes to throw away.
+ * @retval        true   Threw away the bytes.
+ * @retval        false  The list ended early or failed to read.
+ */
+static bool
+touch_list_discard(struct touch *const touch,
+                   struct touch_list *const list,
+                   const unsigned long offset){
+  unsigned long left;
+  ssize_t bytes_read;
+  bool success;
+
+  success = true;
+  left = offset;
+  while(success && left > 0){
+    bytes_read = read(list->fd,
+                      list->buf,
+                      (left < TOUCH_LIST_BUF_SZ) ? left : TOUCH_LIST_BUF_SZ);
+    if(bytes_read > 0){
+      left -= (unsigned long)bytes_read;
+    }
+    else if(bytes_read < 0 && errno == EINTR){
+      /* Try again. */
+    }
+    else if(bytes_read < 0){
+      touch_warn(touch, true, "read list");
+      success = false;
+    }
+    else{
+      touch_warn(touch, false, "checkpoint past end of list: %lu", offset);
+      success = false;
+    }
+  }
+  return success;
+}
+
+/**
+ * Move a list or manifest to the offset saved in the checkpoint being
+ * resumed (--resume).
+ *
+ * A list getting read seeks to the offset, and a mapped list starts its
+ * window at the offset, so the paths before it never get read. A list
+ * that cannot seek, such as a pipe, reads and throws away the paths
+ * before the offset instead.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in,out] list  See @ref touch_list.
+ * @retval        true  Moved the list to the offset, or not resuming.
+ * @retval        false Failed to load the checkpoint or move the list.
+ */
+static bool
+touch_checkpoint_seek(struct touch *const touch,
+                      struct touch_list *const list){
+  unsigned long offset;
+  bool success;
+
+  success = true;
+  if(touch->resume && touch->checkpoint == NULL){
+    /* Already reported the checkpoint failure. */
+    success = false;
+  }
+  else if(touch->resume){
+    offset = touch->checkpoint->offset;
+    if(list->map && offset > list->map_len){
+      touch_warn(touch, false, "checkpoint past end of list: %lu", offset);
+      success = false;
+    }
+    else if(list->map){
+      list->buf = &list->map[offset];
+      list->offset = offset;
+    }
+    else if(offset == 0 || lseek(list->fd, (off_t)offset, SEEK_SET) >= 0){
+      list->offset = offset;
+    }
+    else if(errno == ESPIPE){
+      success = touch_list_discard(touch, list, offset);
+      list->offset = offset;
+    }
+    else{
+      touch_warn(touch, true, "seek list");
+      success = false;
+    }
+  }
+  return success;
+}
+
+/**
+ * Write a checkpoint with the offset in the list or manifest up to which
+ * every path has been touched, along with the number of targets and errors
+ * so far (--checkpoint).
+ *
+ * The checkpoint gets written to @ref touch_checkpoint::tmp_path and
+ * renamed over @ref touch::checkpoint_path, so an interrupted run always
+ * leaves a complete checkpoint behind.
+ *
+ * @param[in,out] touch      See @ref touch.
+ * @param[in,out] checkpoint See @ref touch_checkpoint.
+ * @param[in]     offset     Offset in the list or manifest to resume at.
+ */
+static void
+touch_checkpoint_write(struct touch *const touch,
+                       struct touch_checkpoint *const checkpoint,
+                       const unsigned long offset){
+  const mode_t cm = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
+  char *const buf = checkpoint->buf;
+  const char *sep;
+  unsigned long count;
+  size_t len;
+  size_t i;
+  int fd;
+  bool saved;
+
+  len = (size_t)sprintf(buf,
+                        "{\"offset\":%lu,\"targets\":%lu,"
+                        "\"errors\":%lu,\"errno\":{",
+                        offset,
+                        checkpoint->targets + touch->stats.targets,
+                        checkpoint->errors + touch->stats.errors);
+  sep = "";
+  for(i = 0; i < TOUCH_STATS_ERRNO_SZ; i++){
+    count = checkpoint->errnos[i] + touch->stats.errnos[i];
+    if(count){
+      len += (size_t)sprintf(&buf[len],
+                             "%s\"%lu\":%lu",
+                             sep,
+                             (unsigned long)i,
+                             count);
+      sep = ",";
+    }
+  }
+  len += (size_t)sprintf(&buf[len], "}}\n");
+
+  saved = false;
+  fd = open(checkpoint->tmp_path, O_WRONLY | O_CREAT | O_TRUNC, cm);
+  touch->stats.opens += 1;
+  if(fd >= 0){
+    saved = (write(fd, buf, len) == (ssize_t)len);
+    if(close(fd) != 0){
+      saved = false;
+    }
+    if(saved && rename(checkpoint->tmp_path, touch->checkpoint_path) != 0){
+      saved = false;
+    }
+  }
+  if(!saved){
+    checkpoint->failed = true;
+    touch_warn(touch, true, "checkpoint: %s", touch->checkpoint_path);
+  }
+}
+
+/**
+ * Write a checkpoint using @ref touch_checkpoint_write once every
+ * @ref TOUCH_CHECKPOINT_INTERVAL_NS (--checkpoint).
+ *
+ * Nothing gets saved by --plan, or after failing to save a checkpoint.
+ *
+ * @param[in,out] touch  See @ref touch.
+ * @param[in]     offset Offset in the list or manifest to resume at.
+ * @param[in]     force  Save now instead of waiting for the interval.
+ */
+static void
+touch_checkpoint_save(struct touch *const touch,
+                      const unsigned long offset,
+                      const bool force){
+  struct touch_checkpoint *checkpoint;
+  unsigned long now;
+
+  checkpoint = touch->checkpoint;
+  if(checkpoint && !checkpoint->failed && !(touch->flags & TOUCH_FLAG_PLAN)){
+    now = touch_clock_ns();
+    if(force || now - checkpoint->last_ns >= TOUCH_CHECKPOINT_INTERVAL_NS){
+      checkpoint->last_ns = now;
+      touch_checkpoint_write(touch, checkpoint, offset);
+    }
+  }
+}
+
+/**
+ * Touch each path in a list using a pool of worker threads fed through a
+ * @ref touch_ring while the list gets read.
+ *
+ * The reader hands out paths pointing into the list read buffers, and
+ * only copies a partial path at the end of a buffer into the next one. A
+ * mapped list uses windows into the mapping instead of the buffers, and
+ * releases each window once the workers finish with it.
+ * When the ring is full or the next buffer is still in use, the reader
+ * touches paths itself instead of waiting. The reader overlaps with the
+ * workers, so all of the time gets counted in @ref touch_stats::fs_ns.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in,out] list  See @ref touch_list.
+ * @retval        true  Touched all paths in the list.
+ * @retval        false Failed to set up the ring or the worker pool.
+ */
+static bool
+touch_list_stream(struct touch *const touch,
+                  struct touch_list *const list){
+  struct touch_pool pool;
+  struct touch_ring *ring;
+  struct touch_ring_buf *buf;
+  struct touch_ring_buf *next;
+  const char *path;
+  size_t path_index;
+  size_t i;
+  unsigned long start;
+  unsigned long fs_ns;
+  bool more;
+  bool ring_ready;
+  bool success;
+
+  start = touch_stats_clock(touch);
+  fs_ns = touch->stats.fs_ns;
+  success = false;
+  ring_ready = false;
+  ring = malloc(sizeof(*ring));
+  if(ring){
+    for(i = 0; i < TOUCH_RING_NUM_BUFS; i++){
+      ring->bufs[i].data = NULL;
+      ring->bufs[i].refs = 0;
+    }
+    ring->bufs[0].data = list->buf;
+    if(list->map == NULL){
+      ring->bufs[1].data = malloc((TOUCH_RING_NUM_BUFS - 1) *
+                                  (TOUCH_LIST_BUF_SZ + 1));
+    }
+    for(i = 2; ring->bufs[1].data && i < TOUCH_RING_NUM_BUFS; i++){
+      ring->bufs[i].data = &ring->bufs[i - 1].data[TOUCH_LIST_BUF_SZ + 1];
+    }
+    ring_ready = touch_ring_init(ring);
+    success = (ring_ready &&
+               (list->map || ring->bufs[1].data) &&
+               touch_pool_init(touch,
+                               &pool,
+                               NULL,
+                               touch->jobs,
+                               touch_apply_fn(touch)));
+  }
+  if(success){
+    pool.ring = ring;
+    touch_pool_start(touch, &pool);
+    buf = &ring->bufs[0];
+    buf->refs = 1;
+    path_index = 0;
+    more = true;
+    while(more){
+      while((path = touch_list_next(touch, list, false)) != NULL){
+        __atomic_add_fetch(&buf->refs, 1, __ATOMIC_RELAXED);
+        while(!touch_ring_push(ring, path, path_index, buf)){
+          touch_ring_wait(&pool.workers[0]);
+        }
+        path_index += 1;
+      }
+      more = !list->eof;
+      if(more){
+        next = &ring->bufs[(size_t)(buf - ring->bufs + 1) %
+                           TOUCH_RING_NUM_BUFS];
+        while(__atomic_load_n(&next->refs, __ATOMIC_ACQUIRE) != 0){
+          touch_ring_wait(&pool.workers[0]);
+        }
+        touch_list_release(list,
+                           ring->bufs[(size_t)(next - ring->bufs + 1) %
+                                      TOUCH_RING_NUM_BUFS].data);
+        next->refs = 1;
+        touch_list_fill(touch, list, next->data);
+        next->data = list->buf;
+        __atomic_sub_fetch(&buf->refs, 1, __ATOMIC_RELEASE);
+        buf = next;
+      }
+    }
+    touch_ring_close(ring);
+    touch_pool_finish(touch, &pool);
+    touch->stats.fs_ns = fs_ns + touch_stats_clock(touch) - start;
+  }
+  if(ring_ready){
+    touch_ring_free(ring);
+  }
+  if(ring && list->map == NULL){
+    list->buf = ring->bufs[0].data;
+    free(ring->bufs[1].data);
+  }
+  free(ring);
+  return success;
+}
+
+/**
+ * Touch each path listed in @ref touch::list_path.
+ *
+ * With --checkpoint, the paths always get touched in batches, so every
+ * path before a saved offset has been touched and no worker threads are
+ * still using the list.
+ *
+ * Time not spent reading the list or touching the paths gets counted as
+ * parsing in @ref touch_stats::parse_ns.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_list_all(struct touch *const touch){
+  struct touch_list list;
+  char **batch;
+  size_t num_paths;
+  unsigned long start;
+  unsigned long fs_ns;
+
+  start = touch_stats_clock(touch);
+  fs_ns = touch->stats.fs_ns;
+  if(touch_list_open(touch, &list, touch->list_path, touch->list_delim)){
+    if(!touch_checkpoint_seek(touch, &list)){
+      /* Cannot resume the list. */
+    }
+    else if(touch->jobs > 1 &&
+            touch->checkpoint_path == NULL &&
+            !(touch->flags & (TOUCH_FLAG_SORT | TOUCH_FLAG_RECURSIVE)) &&
+            touch_list_stream(touch, &list)){
+      /* Touched all paths using the worker threads. */
+    }
+    else{
+      batch = malloc(TOUCH_BATCH_SZ * sizeof(*batch));
+      if(batch == NULL){
+        touch_warn(touch, true, "malloc: list buffer");
+      }
+      else{
+        do{
+          num_paths = 0;
+          while(num_paths < TOUCH_BATCH_SZ &&
+                (batch[num_paths] = touch_list_next(touch,
+                                                    &list,
+                                                    num_paths == 0)) != NULL){
+            num_paths += 1;
+          }
+          touch_apply(touch, (const char *const *)batch, num_paths);
+          touch_checkpoint_save(touch, list.offset + list.pos, num_paths == 0);
+        } while(num_paths > 0);
+      }
+      free(batch);
+    }
+    touch_list_close(&list);
+  }
+  touch->stats.parse_ns += touch_stats_clock(touch) - start -
+                           (touch->stats.fs_ns - fs_ns);
+}
+
+/**
+ * Convert seconds since the Epoch in the following format to a timestamp.
+ *
+ * [-]seconds[[.|,]frac]
+ *
+ * Negative times with a frac count back from the Epoch, so -1.25 is a
+ * quarter of a second after -2.
+ *
+ * @param[in,out] touch     See @ref touch.
+ * @param[in]     epoch_str String with the format described above.
+ * @param[out]    ts        Converted timestamp.
+ * @retval        true      Converted the epoch string.
+ * @retval        false     Invalid epoch string.
+ */
+static bool
+touch_epoch_to_ts(struct touch *const touch,
+                  const char *const epoch_str,
+                  struct timespec *const ts){
+  const char *parse;
+  long tv_sec;
+  long tv_nsec;
+  bool neg;
+  bool success;
+
+  parse = epoch_str;
+  neg = (*parse == '-');
+  if(neg){
+    parse += 1;
+  }
+  success = isdigit((unsigned char)*parse);
+  tv_sec = 0;
+  for(; success && isdigit((unsigned char)*parse); parse++){
+    if(tv_sec > (LONG_MAX - (*parse - '0')) / 10){
+      success = false;
+    }
+    else{
+      tv_sec = tv_sec * 10 + (*parse - '0');
+    }
+  }
+  tv_nsec = 0;
+  if(success){
+    success = touch_parse_frac(touch, &parse, &tv_nsec) && *parse == '\0';
+  }
+  if(success){
+    if(neg && tv_nsec > 0){
+      tv_sec = -tv_sec - 1;
+      tv_nsec = 1000000000L - tv_nsec;
+    }
+    else if(neg){
+      tv_sec = -tv_sec;
+    }
+    ts->tv_sec = (time_t)tv_sec;
+    ts->tv_nsec = tv_nsec;
+  }
+  return success;
+}
+
+/**
+ * Convert a manifest time in either the -d format or seconds since the
+ * Epoch to a timestamp.
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in]     time_str See @ref touch_date_time_to_ts and
+ *                         @ref touch_epoch_to_ts.
+ * @param[out]    ts       Converted timestamp.
+ * @retval        true     Converted the time string.
+ * @retval        false    Invalid time string.
+ */
+static bool
+touch_manifest_time(struct touch *const touch,
+                    const char *const time_str,
+                    struct timespec *const ts){
+  /*
+   * YYYY-MM-DD
+   *     ^
+   * 01234
+   */
+  const size_t DATE_TIME_DASH_POS = 4;
+  bool success;
+
+  if(strlen(time_str) > DATE_TIME_DASH_POS &&
+     time_str[DATE_TIME_DASH_POS] == '-'){
+    success = touch_date_time_to_ts(touch, time_str, ts);
+  }
+  else{
+    success = touch_epoch_to_ts(touch, time_str, ts);
+  }
+  return success;
+}
+
+/**
+ * Touch the path in a single manifest record using its own times.
+ *
+ * atime mtime path
+ *
+ * Both times must be separated by a single space, and the path takes up
+ * the rest of the record.
+ *
+ * @param[in,out] touch  See @ref touch.
+ * @param[in,out] record Manifest record, which gets split in place.
+ */
+static void
+touch_manifest_record(struct touch *const touch,
+                      char *const record){
+  char *mtime_str;
+  char *path;
+
+  mtime_str = strchr(record, ' ');
+  path = mtime_str ? strchr(mtime_str + 1, ' ') : NULL;
+  if(path == NULL || path[1] == '\0'){
+    touch_warn(touch, false, "invalid manifest record: %s", record);
+  }
+  else{
+    *mtime_str++ = '\0';
+    *path++ = '\0';
+    if(!touch_manifest_time(touch, record, &touch->time_am[0]) ||
+       !touch_manifest_time(touch, mtime_str, &touch->time_am[1])){
+      touch_warn(touch, false, "invalid manifest time: %s", path);
+    }
+    else{
+      touch_omit_times(touch);
+      touch_apply(touch, (const char *const *)&path, 1);
+    }
+  }
+}
+
+/**
+ * Touch each path in @ref touch::manifest_path using the times given in
+ * its record, saving a checkpoint after each record if it is due.
+ *
+ * Time not spent reading the manifest or touching the paths gets counted
+ * as parsing in @ref touch_stats::parse_ns.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_manifest_all(struct touch *const touch){
+  struct touch_list list;
+  char *record;
+  unsigned long start;
+  unsigned long fs_ns;
+
+  start = touch_stats_clock(touch);
+  fs_ns = touch->stats.fs_ns;
+  if(touch_list_open(touch, &list, touch->manifest_path, '\n')){
+    if(touch_checkpoint_seek(touch, &list)){
+      while((record = touch_list_next(touch, &list, true)) != NULL){
+        touch_manifest_record(touch, record);
+        touch_checkpoint_save(touch, list.offset + list.pos, false);
+      }
+      touch_checkpoint_save(touch, list.offset + list.pos, true);
+    }
+    touch_list_close(&list);
+  }
+  touch->stats.parse_ns += touch_stats_clock(touch) - start -
+                           (touch->stats.fs_ns - fs_ns);
+}
+
+/**
+ * Parse the number of worker threads [-j jobs].
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in]     jobs_str Number of worker threads between 1 and
+ *                         @ref TOUCH_MAX_JOBS.
+ */
+static void
+touch_parse_jobs(struct touch *const touch,
+                 const char *const jobs_str){
+  char *ep;
+  unsigned long jobs;
+
+  errno = 0;
+  jobs = strtoul(jobs_str, &ep, 10);
+  if(errno != 0 ||
+     !isdigit((unsigned char)*jobs_str) ||
+     *ep != '\0' ||
+     jobs < 1 ||
+     jobs > TOUCH_MAX_JOBS){
+    touch_warn(touch, false, "invalid number of jobs: %s", jobs_str);
+  }
+  else{
+    touch->jobs = jobs;
+  }
+}
+
+/**
+ * Parse the file descriptor getting the progress reports [--progress[=fd]].
+ *
+ * @param[in,out] touch  See @ref touch.
+ * @param[in]     fd_str Positive file descriptor number, or NULL to report
+ *                       progress to STDERR.
+ */
+static void
+touch_parse_progress(struct touch *const touch,
+                     const char *const fd_str){
+  char *ep;
+  unsigned long fd;
+
+  if(fd_str == NULL){
+    touch->progress_fd = STDERR_FILENO;
+  }
+  else{
+    errno = 0;
+    fd = strtoul(fd_str, &ep, 10);
+    if(errno != 0 ||
+       !isdigit((unsigned char)*fd_str) ||
+       *ep != '\0' ||
+       fd < 1 ||
+       fd > INT_MAX){
+      touch_warn(touch, false, "invalid progress file descriptor: %s", fd_str);
+    }
+    else{
+      touch->progress_fd = (int)fd;
+    }
+  }
+}
+
+/**
+ * Parse the maximum number of touch operations per second [--max-rate=ops].
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in]     rate_str Operations per second between 1 and one billion.
+ */
+static void
+touch_parse_max_rate(struct touch *const touch,
+                     const char *const rate_str){
+  char *ep;
+  unsigned long rate;
+
+  errno = 0;
+  rate = strtoul(rate_str, &ep, 10);
+  if(errno != 0 ||
+     !isdigit((unsigned char)*rate_str) ||
+     *ep != '\0' ||
+     rate < 1 ||
+     rate > 1000000000UL){
+    touch_warn(touch, false, "invalid rate: %s", rate_str);
+  }
+  else{
+    touch->max_rate = rate;
+  }
+}
+
+/**
+ * Parse the target utimensat() latency [--target-latency=usec].
+ *
+ * @param[in,out] touch   See @ref touch.
+ * @param[in]     lat_str Positive number of microseconds.
+ */
+static void
+touch_parse_target_latency(struct touch *const touch,
+                           const char *const lat_str){
+  char *ep;
+  unsigned long usec;
+
+  errno = 0;
+  usec = strtoul(lat_str, &ep, 10);
+  if(errno != 0 ||
+     !isdigit((unsigned char)*lat_str) ||
+     *ep != '\0' ||
+     usec < 1 ||
+     usec > ULONG_MAX / 1000UL){
+    touch_warn(touch, false, "invalid latency: %s", lat_str);
+  }
+  else{
+    touch->target_latency_ns = usec * 1000UL;
+  }
+}
+
+/**
+ * Parse the scheduling priority [--nice=level].
+ *
+ * @param[in,out] touch    See @ref touch.
+ * @param[in]     nice_str Level between -20 (highest) and 19 (lowest).
+ */
+static void
+touch_parse_nice(struct touch *const touch,
+                 const char *const nice_str){
+  char *ep;
+  long level;
+
+  errno = 0;
+  level = strtol(nice_str, &ep, 10);
+  if(errno != 0 ||
+     *nice_str == '\0' ||
+     *ep != '\0' ||
+     level < -20 ||
+     level > 19){
+    touch_warn(touch, false, "invalid nice level: %s", nice_str);
+  }
+  else{
+    touch->nice = (int)level;
+    touch->set_nice = true;
+  }
+}
+
+/**
+ * Parse the I/O priority [--ioprio=idle|level].
+ *
+ * @param[in,out] touch      See @ref touch.
+ * @param[in]     ioprio_str Either "idle" for the idle class, or a
+ *                           best-effort level between 0 (highest) and
+ *                           @ref TOUCH_IOPRIO_LEVEL_MAX (lowest).
+ */
+static void
+touch_parse_ioprio(struct touch *const touch,
+                   const char *const ioprio_str){
+  if(strcmp(ioprio_str, "idle") == 0){
+    touch->ioprio = TOUCH_IOPRIO_CLASS_IDLE << TOUCH_IOPRIO_CLASS_SHIFT;
+  }
+  else if(ioprio_str[0] >= '0' &&
+          ioprio_str[0] <= '0' + TOUCH_IOPRIO_LEVEL_MAX &&
+          ioprio_str[1] == '\0'){
+    touch->ioprio = (TOUCH_IOPRIO_CLASS_BE << TOUCH_IOPRIO_CLASS_SHIFT) |
+                    (ioprio_str[0] - '0');
+  }
+  else{
+    touch_warn(touch, false, "invalid I/O priority: %s", ioprio_str);
+  }
+}
+
+/**
+ * Parse the maximum number of error messages to print [--max-errors=num].
+ *
+ * @param[in,out] touch   See @ref touch.
+ * @param[in]     max_str Number of messages, or 0 for no limit.
+ */
+static void
+touch_parse_max_errors(struct touch *const touch,
+                       const char *const max_str){
+  char *ep;
+  unsigned long max_errors;
+
+  errno = 0;
+  max_errors = strtoul(max_str, &ep, 10);
+  if(errno != 0 || !isdigit((unsigned char)*max_str) || *ep != '\0'){
+    touch_warn(touch, false, "invalid number of errors: %s", max_str);
+  }
+  else{
+    touch->max_errors = max_errors;
+  }
+}
+
+/**
+ * Check if only one of -r, -t, -d, and --ref-root arguments have been
+ * provided if any.
+ *
+ * @param[in] touch See @ref touch.
+ * @retval    true  Valid arguments.
+ * @retval    false Invalid arguments.
+ */
+static bool
+touch_ensure_args_mutually_exclusive(const struct touch *const touch){
+  bool exclusive;
+  unsigned int flags_exclusive;
+
+  flags_exclusive = touch->flags & (TOUCH_FLAG_REF_FILE  |
+                                    TOUCH_FLAG_TIME      |
+                                    TOUCH_FLAG_DATE_TIME |
+                                    TOUCH_FLAG_REF_ROOT);
+  if(flags_exclusive                         &&
+     flags_exclusive != TOUCH_FLAG_REF_FILE  &&
+     flags_exclusive != TOUCH_FLAG_TIME      &&
+     flags_exclusive != TOUCH_FLAG_DATE_TIME &&
+     flags_exclusive != TOUCH_FLAG_REF_ROOT){
+    exclusive = false;
+  }
+  else{
+    exclusive = true;
+  }
+  return exclusive;
+}
+
+/**
+ * Print the counters as a one-line JSON object to STDERR (--stats).
+ *
+ * @param[in] stats See @ref touch_stats.
+ */
+static void
+touch_stats_print(const struct touch_stats *const stats){
+  const char *sep;
+  size_t i;
+
+  fprintf(stderr,
+          "{\"opens\":%lu,\"creats\":%lu,\"utimensat\":%lu,"
+          "\"futimens\":%lu,\"statx\":%lu,\"unchanged\":%lu,"
+          "\"enoent\":%lu,\"errors\":%lu,\"errno\":{",
+          stats->opens,
+          stats->creats,
+          stats->utimensat,
+          stats->futimens,
+          stats->statx,
+          stats->unchanged,
+          stats->enoent,
+          stats->errors);
+  sep = "";
+  for(i = 0; i < TOUCH_STATS_ERRNO_SZ; i++){
+    if(stats->errnos[i]){
+      fprintf(stderr, "%s\"%lu\":%lu", sep, (unsigned long)i, stats->errnos[i]);
+      sep = ",";
+    }
+  }
+  fprintf(stderr,
+          "},\"parse_ns\":%lu,\"fs_ns\":%lu}\n",
+          stats->parse_ns,
+          stats->fs_ns);
+}
+
+/**
+ * Set up the filesystem list used by --durable.
+ *
+ * If this fails, @ref touch_durable_sync flushes every filesystem instead.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_durable_init(struct touch *const touch){
+  struct touch_durable *durable;
+
+  durable = malloc(sizeof(*durable));
+  if(durable == NULL){
+    /* Flush every filesystem when finished. */
+  }
+  else if(pthread_mutex_init(&durable->mutex, NULL) != 0){
+    free(durable);
+  }
+  else{
+    durable->fn = touch_apply_fn(touch);
+    durable->num_fs = 0;
+    durable->sync_all = false;
+    touch->durable = durable;
+  }
+}
+
+/**
+ * Flush the filesystems holding the touched files (--durable).
+ *
+ * Each recorded filesystem gets flushed once using syncfs(), or every
+ * filesystem gets flushed using sync() if some file could not get matched
+ * to its filesystem or syncfs() is not available.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_durable_sync(struct touch *const touch){
+  struct touch_durable *durable;
+  bool sync_all;
+  size_t i;
+
+  durable = touch->durable;
+  sync_all = (durable == NULL || durable->sync_all);
+#ifndef TOUCH_SYNCFS
+  sync_all = true;
+#endif /* TOUCH_SYNCFS */
+  if(sync_all){
+    sync();
+  }
+  for(i = 0; durable && i < durable->num_fs; i++){
+#ifdef TOUCH_SYNCFS
+    if(!sync_all && syncfs(durable->fs[i].fd) != 0){
+      touch_warn(touch, true, "syncfs");
+    }
+#endif /* TOUCH_SYNCFS */
+    close(durable->fs[i].fd);
+  }
+  if(durable){
+    durable->num_fs = 0;
+    durable->sync_all = false;
+  }
+}
+
+/**
+ * Free the filesystem list used by --durable.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_durable_free(struct touch *const touch){
+  size_t i;
+
+  if(touch->durable){
+    for(i = 0; i < touch->durable->num_fs; i++){
+      close(touch->durable->fs[i].fd);
+    }
+    pthread_mutex_destroy(&touch->durable->mutex);
+    free(touch->durable);
+    touch->durable = NULL;
+  }
+}
+
+/**
+ * Set up the target counts used by --plan.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_plan_init(struct touch *const touch){
+  struct touch_plan *plan;
+
+  plan = malloc(sizeof(*plan));
+  if(plan == NULL){
+    touch_warn(touch, true, "malloc: plan");
+  }
+  else if(pthread_mutex_init(&plan->mutex, NULL) != 0){
+    touch_warn(touch, true, "pthread_mutex_init: plan");
+    free(plan);
+  }
+  else{
+    memset(plan->fs, 0, sizeof(plan->fs));
+    plan->num_fs = 0;
+    plan->sample_ns = 0;
+    plan->samples = 0;
+    touch->plan = plan;
+  }
+}
+
+/**
+ * Free the target counts used by --plan.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_plan_free(struct touch *const touch){
+  if(touch->plan){
+    pthread_mutex_destroy(&touch->plan->mutex);
+    free(touch->plan);
+    touch->plan = NULL;
+  }
+}
+
+/**
+ * Estimate the number of system calls needed to touch the counted targets,
+ * not counting the directories opened by the directory cache (--plan).
+ *
+ * @param[in] touch   See @ref touch.
+ * @param[in] targets Number of targets in each class.
+ * @return            Estimated number of system calls.
+ */
+static unsigned long
+touch_plan_syscalls(const struct touch *const touch,
+                    const unsigned long targets[TOUCH_PLAN_NUM]){
+  unsigned long new_files;
+  unsigned long check;
+  unsigned long futimens_call;
+  unsigned long syscalls;
+
+  new_files = ((touch->flags & TOUCH_FLAG_NEW) &&
+               !(touch->flags & TOUCH_FLAG_NO_CREATE)) ? 1 : 0;
+  check = (touch->flags & (TOUCH_FLAG_IF_CHANGED | TOUCH_FLAG_FORWARD)) ?
+          1 : 0;
+  futimens_call = 1;
+  if((touch->time_am[0].tv_nsec == UTIME_NOW ||
+      touch->time_am[0].tv_nsec == UTIME_OMIT) &&
+     (touch->time_am[1].tv_nsec == UTIME_NOW ||
+      touch->time_am[1].tv_nsec == UTIME_OMIT)){
+    futimens_call = 0;
+  }
+
+  /* Failed lookup, open, futimens, and close, or open and close. */
+  syscalls = targets[TOUCH_PLAN_CREATE] * (new_files ? 2 + futimens_call : 4);
+  syscalls += targets[TOUCH_PLAN_UPDATE] * (new_files + check + 1);
+  syscalls += targets[TOUCH_PLAN_UNCHANGED] * (new_files + 1);
+  syscalls += targets[TOUCH_PLAN_SKIP];
+  syscalls += targets[TOUCH_PLAN_ERROR] * (new_files + 1);
+  return syscalls;
+}
+
+/**
+ * Print the targets counted by --plan to STDOUT, grouped by filesystem,
+ * along with the estimated number of system calls and run time.
+ *
+ * The run time estimate assumes that each system call takes as long as the
+ * average sampled lookup, spread over the -j worker threads, and never
+ * goes below the time allowed by --max-rate.
+ *
+ * @param[in] touch See @ref touch.
+ */
+static void
+touch_plan_print(const struct touch *const touch){
+  const struct touch_plan *plan;
+  const struct touch_plan_fs *fs;
+  unsigned long total[TOUCH_PLAN_NUM];
+  unsigned long num_targets;
+  unsigned long targets;
+  unsigned long dirs;
+  unsigned long syscalls;
+  unsigned long latency_ns;
+  unsigned long jobs;
+  unsigned long estimate_ns;
+  unsigned long rate_ns;
+  size_t i;
+  int j;
+
+  plan = touch->plan;
+  if(plan){
+    memset(total, 0, sizeof(total));
+    num_targets = 0;
+    dirs = 0;
+    for(i = 0; i <= TOUCH_PLAN_FS_SZ; i++){
+      fs = &plan->fs[i];
+      targets = 0;
+      for(j = 0; j < TOUCH_PLAN_NUM; j++){
+        targets += fs->targets[j];
+        total[j] += fs->targets[j];
+      }
+      num_targets += targets;
+      dirs += fs->dirs;
+      if(i < plan->num_fs || (i == TOUCH_PLAN_FS_SZ && targets)){
+        if(i < plan->num_fs){
+          printf("plan: dev=%lu ", (unsigned long)fs->dev);
+        }
+        else{
+          printf("plan: dev=other ");
+        }
+        printf("dirs=%lu create=%lu update=%lu unchanged=%lu skip=%lu "
+               "error=%lu\n",
+               fs->dirs,
+               fs->targets[TOUCH_PLAN_CREATE],
+               fs->targets[TOUCH_PLAN_UPDATE],
+               fs->targets[TOUCH_PLAN_UNCHANGED],
+               fs->targets[TOUCH_PLAN_SKIP],
+               fs->targets[TOUCH_PLAN_ERROR]);
+      }
+    }
+    printf("plan: total dirs=%lu create=%lu update=%lu unchanged=%lu "
+           "skip=%lu error=%lu\n",
+           dirs,
+           total[TOUCH_PLAN_CREATE],
+           total[TOUCH_PLAN_UPDATE],
+           total[TOUCH_PLAN_UNCHANGED],
+           total[TOUCH_PLAN_SKIP],
+           total[TOUCH_PLAN_ERROR]);
+
+    syscalls = touch_plan_syscalls(touch, total) + touch->stats.opens;
+    if(touch->flags & TOUCH_FLAG_DURABLE){
+      /* Parent directory lookups and one flush for each filesystem. */
+      syscalls += dirs + plan->num_fs;
+    }
+    latency_ns = plan->samples ? plan->sample_ns / plan->samples : 0;
+    jobs = (touch->jobs > 1) ? (unsigned long)touch->jobs : 1;
+    estimate_ns = syscalls * latency_ns / jobs;
+    if(touch->max_rate){
+      rate_ns = num_targets / touch->max_rate * 1000000000UL +
+                num_targets % touch->max_rate * 1000000000UL /
+                touch->max_rate;
+      if(rate_ns > estimate_ns){
+        estimate_ns = rate_ns;
+      }
+    }
+    printf("plan: syscalls=%lu latency_ns=%lu jobs=%lu estimate_ms=%lu\n",
+           syscalls,
+           latency_ns,
+           jobs,
+           estimate_ns / 1000000UL);
+  }
+}
+
+/**
+ * Set up the state shared by all threads for --max-rate and
+ * --target-latency.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_limit_init(struct touch *const touch){
+  struct touch_limit *limit;
+
+  limit = malloc(sizeof(*limit));
+  if(limit == NULL){
+    touch_warn(touch, true, "malloc: limit");
+  }
+  else{
+    memset(limit, 0, sizeof(*limit));
+    if(touch->max_rate){
+      limit->interval_ns = 1000000000UL / touch->max_rate;
+    }
+    limit->target_ns = touch->target_latency_ns;
+    limit->window_ns = touch_clock_ns();
+    limit->max_workers = (touch->jobs > 1) ? touch->jobs : 1;
+    limit->workers = limit->max_workers;
+    touch->limit = limit;
+  }
+}
+
+/**
+ * Set up the checkpoint state, and load the checkpoint being resumed
+ * (--checkpoint and --resume).
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_checkpoint_init(struct touch *const touch){
+  const char *const TMP_SUFFIX = ".tmp";
+  struct touch_checkpoint *checkpoint;
+
+  checkpoint = malloc(sizeof(*checkpoint));
+  if(checkpoint == NULL){
+    touch_warn(touch, true, "malloc: checkpoint");
+  }
+  else{
+    memset(checkpoint, 0, sizeof(*checkpoint));
+    checkpoint->last_ns = touch_clock_ns();
+    if(strlen(touch->checkpoint_path) + strlen(TMP_SUFFIX) >=
+       sizeof(checkpoint->tmp_path)){
+      errno = ENAMETOOLONG;
+      touch_warn(touch, true, "checkpoint: %s", touch->checkpoint_path);
+      checkpoint->failed = true;
+    }
+    else{
+      sprintf(checkpoint->tmp_path,
+              "%s%s",
+              touch->checkpoint_path,
+              TMP_SUFFIX);
+    }
+    if(touch->resume && !touch_checkpoint_load(touch, checkpoint)){
+      free(checkpoint);
+    }
+    else{
+      touch->checkpoint = checkpoint;
+    }
+  }
+}
+
+/**
+ * Finish setting up a context after parsing the arguments.
+ *
+ * Set the times that do not get changed to UTIME_OMIT, use the current time
+ * if no time has been provided, and set up the optional engines.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_init(struct touch *const touch){
+  /* Use current time if the user did not specify a time. */
+  if(touch->time_am[0].tv_sec == 0){
+    touch->time_am[0].tv_nsec = UTIME_NOW;
+    touch->time_am[1].tv_nsec = UTIME_NOW;
+  }
+  touch_omit_times(touch);
+  touch->dircache = touch_dircache_new();
+  touch->errlog = malloc(sizeof(*touch->errlog));
+  if(touch->errlog){
+    memset(touch->errlog, 0, sizeof(*touch->errlog));
+  }
+  if(touch->ref_root){
+    touch->ref_dircache = touch_dircache_new();
+  }
+  if(touch->flags & TOUCH_FLAG_PLAN){
+    touch_plan_init(touch);
+  }
+  else if(touch->flags & TOUCH_FLAG_DURABLE){
+    touch_durable_init(touch);
+  }
+  if(touch->max_rate || touch->target_latency_ns){
+    touch_limit_init(touch);
+  }
+  if(touch->checkpoint_path){
+    touch_checkpoint_init(touch);
+  }
+#ifdef TOUCH_IO_URING
+  if((touch->flags & TOUCH_FLAG_IO_URING) &&
+     !(touch->flags & TOUCH_FLAG_PLAN)){
+    touch_uring_init(touch);
+  }
+#endif /* TOUCH_IO_URING */
+}
+
+/**
+ * Release the resources set up by @ref touch_init.
+ *
+ * @param[in,out] touch See @ref touch.
+ */
+static void
+touch_cleanup(struct touch *const touch){
+#ifdef TOUCH_IO_URING
+  if(touch->uring){
+    touch_uring_free(touch);
+  }
+#endif /* TOUCH_IO_URING */
+  touch_dircache_free(touch->dircache);
+  touch->dircache = NULL;
+  touch_dircache_free(touch->ref_dircache);
+  touch->ref_dircache = NULL;
+  touch_durable_free(touch);
+  touch_plan_free(touch);
+  free(touch->limit);
+  touch->limit = NULL;
+  free(touch->checkpoint);
+  touch->checkpoint = NULL;
+  touch_errlog_finish(touch);
+  free(touch->errlog);
+  touch->errlog = NULL;
+}
+
+/**
+ * Precompiled touch context used by the library interface.
+ *
+ * The time argument gets parsed once when creating the context. The
+ * directory cache only lasts for a single call, so directories can get
+ * removed, replaced, or renamed between calls. A context must only get
+ * used by one thread at a time.
+ */
+struct touch_ctx{
+  /**
+   * See @ref touch.
+   */
+  struct touch touch;
+};
+
+/**
+ * Create a touch context for updating many files with the same times.
+ *
+ * Errors get printed to STDERR in the same way as @ref touch_main.
+ * @ref TOUCH_FLAG_STATS and @ref TOUCH_FLAG_PLAN only report their results
+ * from @ref touch_main, so contexts reject them.
+ *
+ * @param[in] flags    See @ref touch_flag. At most one of
+ *                     @ref TOUCH_FLAG_DATE_TIME, @ref TOUCH_FLAG_TIME,
+ *                     @ref TOUCH_FLAG_REF_FILE, and
+ *                     @ref TOUCH_FLAG_REF_ROOT determines how @p time_str
+ *                     gets interpreted.
+ * @param[in] time_str Date time string, time string, reference file
+ *                     path, or reference root directory. Ignored if none
+ *                     of the time flags set. A reference root must stay
+ *                     valid until the context gets freed.
+ * @return             New context, or NULL if @p time_str could not get
+ *                     parsed or failed to allocate memory.
+ */
+struct touch_ctx *
+touch_ctx_new(const unsigned int flags,
+              const char *const time_str){
+  struct touch touch;
+  struct touch_ctx *ctx;
+
+  ctx = NULL;
+  memset(&touch, 0, sizeof(touch));
+  touch.flags = flags;
+  if(touch_ensure_args_mutually_exclusive(&touch) == false){
+    touch_warn(&touch, false, "-r, -t, -d, and --ref-root mutually exclusive");
+  }
+  else if(flags & (TOUCH_FLAG_STATS | TOUCH_FLAG_PLAN)){
+    touch_warn(&touch, false, "--stats and --plan not supported by touch_ctx");
+  }
+  else if((flags & (TOUCH_FLAG_REF_FILE  |
+                    TOUCH_FLAG_TIME      |
+                    TOUCH_FLAG_DATE_TIME |
+                    TOUCH_FLAG_REF_ROOT)) && time_str == NULL){
+    touch_warn(&touch, false, "time argument required");
+  }
+  else if(flags & TOUCH_FLAG_DATE_TIME){
+    touch_parse_date_time(&touch, time_str);
+  }
+  else if(flags & TOUCH_FLAG_TIME){
+    touch_parse_time(&touch, time_str);
+  }
+  else if(flags & TOUCH_FLAG_REF_FILE){
+    touch_get_time_ref_file(&touch, time_str);
+  }
+  else if(flags & TOUCH_FLAG_REF_ROOT){
+    touch.ref_root = time_str;
+  }
+  if(touch.status_code == EXIT_SUCCESS){
+    ctx = malloc(sizeof(*ctx));
+    if(ctx == NULL){
+      touch_warn(&touch, true, "malloc: touch_ctx");
+    }
+    else{
+      touch_init(&touch);
+      ctx->touch = touch;
+    }
+  }
+  return ctx;
+}
+
+/**
+ * Touch a single path using a context.
+ *
+ * @param[in,out] ctx          See @ref touch_ctx.
+ * @param[in]     path         Path to touch.
+ * @retval        EXIT_SUCCESS Successfully touched @p path.
+ * @retval        EXIT_FAILURE Error occurred.
+ */
+int
+touch_ctx_apply(struct touch_ctx *const ctx,
+                const char *const path){
+  return touch_ctx_apply_many(ctx, &path, 1);
+}
+
+/**
+ * Touch a list of paths using a context.
+ *
+ * The cached parent directories from the previous call get closed first,
+ * so paths never get resolved through a directory that has since been
+ * removed or renamed.
+ *
+ * @param[in,out] ctx          See @ref touch_ctx.
+ * @param[in]     paths        Paths to touch.
+ * @param[in]     num_paths    Number of paths in @p paths.
+ * @retval        EXIT_SUCCESS Successfully touched all paths.
+ * @retval        EXIT_FAILURE Error occurred on at least one path.
+ */
+int
+touch_ctx_apply_many(struct touch_ctx *const ctx,
+                     const char *const paths[],
+                     const size_t num_paths){
+  ctx->touch.status_code = EXIT_SUCCESS;
+  touch_dircache_reset(ctx->touch.dircache);
+  touch_dircache_reset(ctx->touch.ref_dircache);
+  touch_operands(&ctx->touch, paths, num_paths);
+  if(ctx->touch.flags & TOUCH_FLAG_DURABLE){
+    touch_durable_sync(&ctx->touch);
+  }
+  touch_errlog_finish(&ctx->touch);
+  return ctx->touch.status_code;
+}
+
+/**
+ * Free a context created by @ref touch_ctx_new.
+ *
+ * @param[in] ctx See @ref touch_ctx. Can be NULL.
+ */
+void
+touch_ctx_free(struct touch_ctx *const ctx){
+  if(ctx){
+    touch_cleanup(&ctx->touch);
+    free(ctx);
+  }
+}
+
+/**
+ * Parse the options from an argument list.
+ *
+ * Errors set @ref touch::status_code.
+ *
+ * @param[in,out] touch See @ref touch.
+ * @param[in]     argc  Number of arguments in @p argv.
+ * @param[in,out] argv  Argument list, which getopt_long() may reorder.
+ * @return              Index of the first file operand in @p argv.
+ */
+static int
+touch_parse_args(struct touch *const touch,
+                 const int argc,
+                 char *const argv[]){
+  const struct option long_options[] = {
+    {"checkpoint",      required_argument, NULL, TOUCH_OPT_CHECKPOINT},
+    {"collapse-errors", no_argument,       NULL, TOUCH_OPT_COLLAPSE},
+    {"durable",         no_argument,       NULL, TOUCH_OPT_DURABLE},
+    {"files0-from",     required_argument, NULL, TOUCH_OPT_FILES0_FROM},
+    {"forward-only",    no_argument,       NULL, TOUCH_OPT_FORWARD},
+    {"glob",            no_argument,       NULL, TOUCH_OPT_GLOB},
+    {"if-changed",      no_argument,       NULL, TOUCH_OPT_IF_CHANGED},
+    {"io-uring",        no_argument,       NULL, TOUCH_OPT_IO_URING},
+    {"manifest",        required_argument, NULL, TOUCH_OPT_MANIFEST},
+    {"ioprio",          required_argument, NULL, TOUCH_OPT_IOPRIO},
+    {"max-errors",      required_argument, NULL, TOUCH_OPT_MAX_ERRORS},
+    {"max-rate",        required_argument, NULL, TOUCH_OPT_MAX_RATE},
+    {"new-files",       no_argument,       NULL, TOUCH_OPT_NEW},
+    {"nice",            required_argument, NULL, TOUCH_OPT_NICE},
+    {"plan",            no_argument,       NULL, TOUCH_OPT_PLAN},
+    {"progress",        optional_argument, NULL, TOUCH_OPT_PROGRESS},
+    {"ref-root",        required_argument, NULL, TOUCH_OPT_REF_ROOT},
+    {"resume",          no_argument,       NULL, TOUCH_OPT_RESUME},
+    {"serve",           required_argument, NULL, TOUCH_OPT_SERVE},
+    {"sort",            no_argument,       NULL, TOUCH_OPT_SORT},
+    {"stats",           no_argument,       NULL, TOUCH_OPT_STATS},
+    {"target-latency",  required_argument, NULL, TOUCH_OPT_TARGET_LATENCY},
+    {"target-root",     required_argument, NULL, TOUCH_OPT_TARGET_ROOT},
+    {NULL,              0,                 NULL, 0}
+  };
+  int c;
+
+  while((c = getopt_long(argc,
+                         argv,
+                         "acd:f:j:mRr:t:",
+                         long_options,
+                         NULL)) != -1){
+    switch(c){
+    case 'a':
+      touch->flags |= TOUCH_FLAG_ACCESS_TIME;
+      break;
+    case 'c':
+      touch->flags |= TOUCH_FLAG_NO_CREATE;
+      break;
+    case 'd':
+      touch_parse_date_time(touch, optarg);
+      touch->flags |= TOUCH_FLAG_DATE_TIME;
+      break;
+    case 'f':
+      touch->list_path = optarg;
+      touch->list_delim = '\n';
+      break;
+    case 'j':
+      touch_parse_jobs(touch, optarg);
+      break;
+    case TOUCH_OPT_FILES0_FROM:
+      touch->list_path = optarg;
+      touch->list_delim = '\0';
+      break;
+    case TOUCH_OPT_COLLAPSE:
+      touch->flags |= TOUCH_FLAG_COLLAPSE;
+      break;
+    case TOUCH_OPT_FORWARD:
+      touch->flags |= TOUCH_FLAG_FORWARD;
+      break;
+    case TOUCH_OPT_IF_CHANGED:
+      touch->flags |= TOUCH_FLAG_IF_CHANGED;
+      break;
+    case TOUCH_OPT_IO_URING:
+      touch->flags |= TOUCH_FLAG_IO_URING;
+      break;
+    case TOUCH_OPT_MANIFEST:
+      touch->manifest_path = optarg;
+      break;
+    case TOUCH_OPT_MAX_ERRORS:
+      touch_parse_max_errors(touch, optarg);
+      break;
+    case TOUCH_OPT_NEW:
+      touch->flags |= TOUCH_FLAG_NEW;
+      break;
+    case TOUCH_OPT_REF_ROOT:
+      touch->ref_root = optarg;
+      touch->flags |= TOUCH_FLAG_REF_ROOT;
+      break;
+    case TOUCH_OPT_SERVE:
+      touch->serve_path = optarg;
+      break;
+    case TOUCH_OPT_SORT:
+      touch->flags |= TOUCH_FLAG_SORT;
+      break;
+    case TOUCH_OPT_GLOB:
+      touch->flags |= TOUCH_FLAG_GLOB;
+      break;
+    case TOUCH_OPT_DURABLE:
+      touch->flags |= TOUCH_FLAG_DURABLE;
+      break;
+    case TOUCH_OPT_PROGRESS:
+      touch_parse_progress(touch, optarg);
+      break;
+    case TOUCH_OPT_MAX_RATE:
+      touch_parse_max_rate(touch, optarg);
+      break;
+    case TOUCH_OPT_TARGET_LATENCY:
+      touch_parse_target_latency(touch, optarg);
+      break;
+    case TOUCH_OPT_NICE:
+      touch_parse_nice(touch, optarg);
+      break;
+    case TOUCH_OPT_IOPRIO:
+      touch_parse_ioprio(touch, optarg);
+      break;
+    case TOUCH_OPT_PLAN:
+      touch->flags |= TOUCH_FLAG_PLAN;
+      break;
+    case TOUCH_OPT_CHECKPOINT:
+      touch->checkpoint_path = optarg;
+      break;
+    case TOUCH_OPT_RESUME:
+      touch->resume = true;
+      break;
+    case TOUCH_OPT_STATS:
+      touch->flags |= TOUCH_FLAG_STATS;
+      break;
+    case TOUCH_OPT_TARGET_ROOT:
+      touch->target_root = optarg;
+      break;
+    case 'm':
+      touch->flags |= TOUCH_FLAG_MOD_TIME;
+      break;
+    case 'R':
+      touch->flags |= TOUCH_FLAG_RECURSIVE;
+      break;
+    case 'r':
+      touch_get_time_ref_file(touch, optarg);
+      touch->flags |= TOUCH_FLAG_REF_FILE;
+      break;
+    case 't':
+      touch_parse_time(touch, optarg);
+      touch->flags |= TOUCH_FLAG_TIME;
+      break;
+    default:
+      touch->status_code = EXIT_FAILURE;
+      break;
+    }
+  }
+  return optind;
+}
+
+/**
+ * Touch the file operands, list, and manifest using the parsed options.
  *
  * @param[in,out] touch     See @ref touch.
- * @param[in]     errno_msg Include a standard message describing errno.
- * @param[in]     fmt       Format string used by vwarnx.
+ * @param[in]     argc      Number of file operands in @p argv.
+ * @param[in]     argv      File operands.
+ * @param[out]    op_status If not NULL, gets set to '0' for each file
+ *                          operand touched successfully and '1' for each
+ *                          that failed, which touches each operand
+ *                          separately.
  */
 static void
-touch_warn(struct touch *const touch,
-            const bool errno_msg,
-            const char *const fmt, ...){
-  va_list ap;
+touch_run(struct touch *const touch,
+          const int argc,
+          char *const argv[],
+          char *const op_status){
+  int status_code;
+  int i;
 
-  touch->status_code = EXIT_FAILURE;
-  va_start(ap, fmt);
-  if(errno_msg){
-    vwarn(fmt, ap);
+  if(argc < 1 && touch->list_path == NULL && touch->manifest_path == NULL){
+    touch_warn(touch, false, "file... argument required");
   }
-  else{
-    vwarnx(fmt, ap);
+  else if(touch_ensure_args_mutually_exclusive(touch) == false){
+    touch_warn(touch, false, "-r, -t, -d, and --ref-root mutually exclusive");
+  }
+  else if(touch->ref_root && touch->manifest_path){
+    touch_warn(touch, false, "--ref-root and --manifest mutually exclusive");
+  }
+  else if(touch->target_root && touch->ref_root == NULL){
+    touch_warn(touch, false, "--target-root requires --ref-root");
+  }
+  else if(touch->checkpoint_path &&
+          (touch->list_path == NULL) == (touch->manifest_path == NULL)){
+    touch_warn(touch, false, "--checkpoint requires one list or manifest");
+  }
+  else if(touch->resume && touch->checkpoint_path == NULL){
+    touch_warn(touch, false, "--resume requires --checkpoint");
+  }
+  else if(touch->status_code == 0){
+    touch_init(touch);
+    if(touch->progress_fd > 0){
+      touch_progress_start(touch);
+    }
+    if(op_status == NULL){
+      touch_operands(touch, (const char *const *)argv, (size_t)argc);
+    }
+    for(i = 0; op_status && i < argc; i++){
+      status_code = touch->status_code;
+      touch->status_code = EXIT_SUCCESS;
+      touch_operands(touch, (const char *const *)&argv[i], 1);
+      op_status[i] = (touch->status_code == EXIT_SUCCESS) ? '0' : '1';
+      if(status_code != EXIT_SUCCESS){
+        touch->status_code = status_code;
+      }
+    }
+    if(touch->list_path){
+      touch_list_all(touch);
+    }
+    if(touch->manifest_path){
+      touch_manifest_all(touch);
+    }
+    if(touch->flags & TOUCH_FLAG_PLAN){
+      touch_plan_print(touch);
+    }
+    else if(touch->flags & TOUCH_FLAG_DURABLE){
+      touch_durable_sync(touch);
+    }
+    touch_progress_stop(touch);
+    touch_cleanup(touch);
+  }
+  if(touch->flags & TOUCH_FLAG_STATS){
+    touch_stats_print(&touch->stats);
   }
-  va_end(ap);
 }
 
 /**
- * Parse the frac part of a date_time string.
+ * Signal number that asked the server to stop, or 0 (--serve).
+ */
+static volatile sig_atomic_t g_touch_serve_signal;
+
+/**
+ * Ask the server to stop after SIGINT or SIGTERM (--serve).
  *
- * @param[in,out] touch      See @ref touch.
- * @param[in,out] time_parse Pointer to next character in parse string. This
- *                           pointer will get updated to point to the last
- *                           character after the frac.
+ * @param[in] sig Signal number.
  */
 static void
-touch_parse_frac(struct touch *const touch,
-                 const char **time_parse){
-  /*
-   * Convert the fractional second part to nanoseconds stored in tv_nsec.
-   *                          3  2  1
-   *                          ||||||||||
-   */
-  const long CONV_FRAC_NSEC = 1000000000;
-  char *ep;
-  char *frac_str;
-  size_t i;
-  double frac;
-  long tv_nsec;
+touch_serve_signal(const int sig){
+  g_touch_serve_signal = sig;
+}
 
-  if(**time_parse == '.' || **time_parse == ','){
-    frac_str = malloc(MAX_FRAC_CHAR_LEN + 1);
-    if(frac_str == NULL){
-      touch_warn(touch, true, "malloc: frac_str");
+/**
+ * Send an entire buffer to a client.
+ *
+ * @param[in] fd  Client socket.
+ * @param[in] buf Data to send.
+ * @param[in] len Number of bytes in @p buf.
+ */
+static void
+touch_serve_send(const int fd,
+                 const char *const buf,
+                 const size_t len){
+  ssize_t bytes_sent;
+  size_t pos;
+
+  pos = 0;
+  while(pos < len){
+    bytes_sent = send(fd, &buf[pos], len - pos, MSG_NOSIGNAL);
+    if(bytes_sent > 0){
+      pos += (size_t)bytes_sent;
+    }
+    else if(bytes_sent < 0 && errno == EINTR){
+      /* Try again. */
     }
     else{
-      *time_parse += 1;
-      frac_str[0] = '.';
-      for(i = 1; isdigit((*time_parse)[i - 1]) && i < MAX_FRAC_CHAR_LEN; i++){
-        frac_str[i] = (*time_parse)[i - 1];
-      }
-      frac_str[i] = '\0';
-      errno = 0;
-      frac = strtod(frac_str, &ep);
-      if(errno != 0){
-        touch_warn(touch, true, "failed to parse frac");
-      }
-      else{
-        *time_parse += (ep - frac_str - 1);
-        tv_nsec = (long)(frac * CONV_FRAC_NSEC);
-        touch->time_am[0].tv_nsec = tv_nsec;
-        touch->time_am[1].tv_nsec = tv_nsec;
-      }
-      free(frac_str);
+      pos = len;
     }
   }
 }
 
 /**
- * Parse a date time string [-d date_string] in the following format.
+ * Handle one request from a client and send the response (--serve).
  *
- * YYYY-MM-DDThh:mm:SS[[.|,]frac][tz]
+ * A request uses the same arguments as the command line, without the
+ * program name, each terminated by a NUL character. An empty argument
+ * ends the request. The response has the exit status followed by the
+ * status of each file operand in order, each as the character '0' for
+ * success or '1' for failure, followed by a newline.
  *
- * frac = nanoseconds
- * tz = blank or Z
+ * Each request gets its own context, except for the cached time zone
+ * offsets which stay warm between requests. The directory cache starts
+ * empty on each request since directories can get replaced between
+ * requests.
  *
- * @param[in,out] touch         See @ref touch.
- * @param[in]     date_time_str String with the format described above.
+ * @param[in,out] server See @ref touch.
+ * @param[in]     fd     Client socket.
+ * @param[in,out] req    Request arguments, each terminated by NUL.
+ * @param[in]     argc   Number of arguments in @p req.
  */
 static void
-touch_parse_date_time(struct touch *const touch,
-                      const char *const date_time_str){
-  /*
-   * YYYY-MM-DDThh:mm:SS
-   * 1234567890123456789
-   *         10       19
-   */
-  const size_t MIN_DATE_TIME = 19;
-  /*
-   * frac = maximum length for long type (nanoseconds)
-   * YYYY-MM-DDThh:mm:SS,fracZ
-   * 12345678901234567890 + ceil(log10(LONG_MAX)) + 1
-   *         10        20 + ceil(log10(LONG_MAX)) + 1
-   */
-  size_t MAX_DATE_TIME;
-  /*
-   * YYYY-MM-DDThh:mm:SS[.frac][tz]
-   *           ^
-   * 01234567890
-   *          10
-   */
-  const size_t DATE_TIME_T_POS = 10;
-  struct tm tm = {0};
-  size_t slen;
-  char fmt[MAX_DATE_TIME_FMT_LEN];
-  const char *time_parse;
-  time_t tv_sec;
-
-  MAX_FRAC_CHAR_LEN = ((size_t)(log10(LONG_MAX) + 1));
-  MAX_DATE_TIME = 20 + MAX_FRAC_CHAR_LEN + 1;
+touch_serve_request(struct touch *const server,
+                    const int fd,
+                    char *const req,
+                    const int argc){
+  char prog[] = "touch";
+  struct touch touch;
+  char *status;
+  char **argv;
+  char *arg;
+  int i;
+  int ops;
 
-  slen = strlen(date_time_str);
-  if(slen < MIN_DATE_TIME ||
-     slen >= MAX_DATE_TIME ||
-     (date_time_str[DATE_TIME_T_POS] != 'T' &&
-      date_time_str[DATE_TIME_T_POS] != ' ')){
-    touch_warn(touch, false, "invalid date_time");
+  argv = malloc(((size_t)argc + 2) * sizeof(*argv));
+  status = malloc((size_t)argc + 3);
+  if(argv == NULL || status == NULL){
+    touch_warn(server, true, "malloc: request");
+    touch_serve_send(fd, "1\n", 2);
   }
   else{
-    /*
-     * Set the position of the time indicator in the format string.
-     *           012345678
-     *           ||||||||| */
-    strcpy(fmt, "%Y-%m-%d %T");
-    fmt[8] = date_time_str[DATE_TIME_T_POS];
-    tm.tm_isdst = -1;
-    time_parse = strptime(date_time_str, fmt, &tm);
-    if(time_parse == NULL){
-      touch_warn(touch, true, "failed to parse date_time");
+    argv[0] = prog;
+    arg = req;
+    for(i = 1; i <= argc; i++){
+      argv[i] = arg;
+      arg += strlen(arg) + 1;
+    }
+    argv[argc + 1] = NULL;
+    if(argc == 1 && strcmp(argv[1], "--shutdown") == 0){
+      server->serve_stop = true;
+      touch_serve_send(fd, "0\n", 2);
     }
     else{
-      touch_parse_frac(touch, &time_parse);
-      if(*time_parse == 'Z'){
-        if(setenv("TZ", "UTC", 1) != 0){
-          touch_warn(touch, true, "failed to set TZ");
-        }
-        time_parse += 1;
+      memset(&touch, 0, sizeof(touch));
+      touch.tz = server->tz;
+      optind = 0;
+      i = touch_parse_args(&touch, argc + 1, argv);
+      ops = argc + 1 - i;
+      memset(&status[1], '1', (size_t)ops);
+      if(touch.serve_path){
+        touch_warn(&touch, false, "--serve not allowed in a request");
       }
-      if(touch->status_code != 0 || *time_parse != '\0'){
-        touch_warn(touch, false, "failed to parse date_time");
+      else if(touch.progress_fd > 0){
+        touch_warn(&touch, false, "--progress not allowed in a request");
       }
       else{
-        tv_sec = mktime(&tm);
-        if(tv_sec == (time_t)-1){
-          touch_warn(touch, true, "mktime");
-        }
-        touch->time_am[0].tv_sec = tv_sec;
-        touch->time_am[1].tv_sec = tv_sec;
+        touch_run(&touch, ops, &argv[i], &status[1]);
       }
+      server->tz = touch.tz;
+      status[0] = (touch.status_code == EXIT_SUCCESS) ? '0' : '1';
+      status[ops + 1] = '\n';
+      touch_serve_send(fd, status, (size_t)ops + 2);
     }
   }
+  free(argv);
+  free(status);
 }
 
 /**
- * Parse a time string [-t time] in the following format.
- *
- * [[CC]YY]MMDDhhmm[.SS]
+ * Handle all requests from one client until it disconnects (--serve).
  *
- * @param[in,out] touch    See @ref touch.
- * @param[in]     time_str String with the format described above.
+ * @param[in,out] server See @ref touch.
+ * @param[in]     fd     Client socket.
  */
 static void
-touch_parse_time(struct touch *const touch,
-                 const char *const time_str){
-  /*
-   * MMDDhhmm
-   * 12345678
-   *        8
-   */
-  const size_t MIN_TIME_LEN = 8;
-  /*
-   * CCYYMMDDhhmm.SS
-   * 123456789012345
-   *         10   15
-   */
-  const size_t MAX_TIME_LEN = 15;
-  struct tm tm;
-  char fmt[MAX_TIME_FMT_LEN];
-  size_t slen;
-  size_t slen_minus_sec;
-  const char *time_parse;
-  char *fmt_append;
-  bool has_dot;
-  time_t tv_sec;
-
-  fmt[0] = '\0';
-  memset(&tm, 0, sizeof(tm));
+touch_serve_client(struct touch *const server,
+                   const int fd){
+  ssize_t bytes_read;
+  size_t scan;
+  size_t len;
+  size_t sz;
+  char *buf;
+  char *tmp;
+  bool done;
+  int argc;
 
-  slen = strlen(time_str);
-  if(slen < MIN_TIME_LEN || slen > MAX_TIME_LEN){
-    touch_warn(touch, false, "invalid time string");
-  }
-  else{
-    slen_minus_sec = slen;
-    if(strchr(time_str, '.')){
-      has_dot = true;
-      slen_minus_sec -= 3;
-    }
-    else{
-      has_dot = false;
+  buf = NULL;
+  len = 0;
+  sz = 0;
+  scan = 0;
+  argc = 0;
+  done = false;
+  while(!done && !server->serve_stop && !g_touch_serve_signal){
+    while(scan < len && buf[scan] != '\0'){
+      scan += 1;
     }
-    fmt_append = fmt;
-    if(slen_minus_sec == 12){
-      fmt_append = stpcpy(fmt_append, "%C");
+    if(scan < len && (scan == 0 || buf[scan - 1] == '\0')){
+      /* Found the empty argument ending the request. */
+      if(scan == 0){
+        done = true;
+      }
+      else{
+        touch_serve_request(server, fd, buf, argc);
+      }
+      len -= scan + 1;
+      memmove(buf, &buf[scan + 1], len);
+      scan = 0;
+      argc = 0;
     }
-    if(slen_minus_sec >= 10){
-      fmt_append = stpcpy(fmt_append, "%y");
+    else if(scan < len){
+      argc += 1;
+      scan += 1;
     }
-    fmt_append = stpcpy(fmt_append, "%m%d%H%M");
-    if(has_dot){
-      stpcpy(fmt_append, ".%S");
+    else if(len == sz && sz == TOUCH_SERVE_MAX_SZ){
+      errno = EMSGSIZE;
+      touch_warn(server, true, "request");
+      done = true;
     }
-    time_parse = strptime(time_str, fmt, &tm);
-    if(time_parse == NULL || *time_parse != '\0'){
-      touch_warn(touch, true, "invalid time string");
+    else if(len == sz){
+      sz = sz ? sz * 2 : 4096;
+      tmp = realloc(buf, sz);
+      if(tmp == NULL){
+        touch_warn(server, true, "malloc: request");
+        done = true;
+      }
+      buf = tmp ? tmp : buf;
     }
     else{
-      tv_sec = mktime(&tm);
-      if(tv_sec == (time_t)-1){
-        touch_warn(touch, true, "mktime");
+      bytes_read = read(fd, &buf[len], sz - len);
+      if(bytes_read > 0){
+        len += (size_t)bytes_read;
+      }
+      else if(bytes_read < 0 && errno == EINTR){
+        /* Try again. */
+      }
+      else{
+        done = true;
       }
-      touch->time_am[0].tv_sec = tv_sec;
-      touch->time_am[1].tv_sec = tv_sec;
     }
   }
+  free(buf);
 }
 
 /**
- * Get the access/modification time of an existing reference file.
+ * Bind the server socket, replacing a stale socket left behind by a
+ * server that did not exit cleanly (--serve).
  *
- * @param[in,out] touch See @ref touch.
- * @param[in]     path  Path to reference file.
+ * A socket file that refuses connections has no server listening on it,
+ * so it gets removed. Anything else at the path is left alone.
+ *
+ * @param[in] fd   Server socket.
+ * @param[in] addr Address to bind to.
+ * @retval    0    Bound the socket.
+ * @retval    -1   Failed to bind the socket, errno set.
  */
-static void
-touch_get_time_ref_file(struct touch *const touch,
-                        const char *const path){
+static int
+touch_serve_bind(const int fd,
+                 const struct sockaddr_un *const addr){
   struct stat sb;
+  int probe_fd;
+  int rc;
 
-  if(stat(path, &sb) < 0){
-    touch_warn(touch, true, "stat reference file: %s", path);
-  }
-  else{
-    touch->time_am[0] = sb.st_atim;
-    touch->time_am[1] = sb.st_mtim;
+  rc = bind(fd, (const struct sockaddr *)addr, sizeof(*addr));
+  if(rc != 0 && errno == EADDRINUSE){
+    probe_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(probe_fd >= 0 &&
+       lstat(addr->sun_path, &sb) == 0 &&
+       S_ISSOCK(sb.st_mode) &&
+       connect(probe_fd,
+               (const struct sockaddr *)addr,
+               sizeof(*addr)) != 0 &&
+       errno == ECONNREFUSED &&
+       unlink(addr->sun_path) == 0){
+      rc = bind(fd, (const struct sockaddr *)addr, sizeof(*addr));
+    }
+    else{
+      errno = EADDRINUSE;
+    }
+    if(probe_fd >= 0){
+      close(probe_fd);
+    }
   }
+  return rc;
 }
 
 /**
- * Touch a file.
+ * Accept requests on a Unix socket until receiving a shutdown request,
+ * SIGINT, or SIGTERM (--serve).
+ *
+ * The signal handlers get installed without SA_RESTART so a blocked
+ * accept4() or read() returns, and the previous handlers get restored
+ * once the server stops.
  *
  * @param[in,out] touch See @ref touch.
- * @param[in]     path  Path to a file to touch.
  */
 static void
-touch_path(struct touch *const touch,
-           const char *const path){
+touch_serve(struct touch *const touch){
+  struct sigaction sa;
+  struct sigaction old_int;
+  struct sigaction old_term;
+  struct sockaddr_un addr;
   int fd;
-  const mode_t cm = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
+  int client_fd;
 
-  fd = open(path, O_RDONLY);
-  if(fd < 0){
-    if(errno != ENOENT){
-      touch_warn(touch, true, "open: %s", path);
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  fd = -1;
+  if(strlen(touch->serve_path) >= sizeof(addr.sun_path)){
+    errno = ENAMETOOLONG;
+    touch_warn(touch, true, "socket: %s", touch->serve_path);
+  }
+  else if((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0){
+    touch_warn(touch, true, "socket: %s", touch->serve_path);
+  }
+  else{
+    strcpy(addr.sun_path, touch->serve_path);
+    if(touch_serve_bind(fd, &addr) != 0 || listen(fd, SOMAXCONN) != 0){
+      touch_warn(touch, true, "bind: %s", touch->serve_path);
     }
     else{
-      if(!(touch->flags & TOUCH_FLAG_NO_CREATE)){
-        fd = creat(path, cm);
-        if(fd < 0){
-          touch_warn(touch, true, "creat: %s", path);
+      memset(&sa, 0, sizeof(sa));
+      sa.sa_handler = touch_serve_signal;
+      sigemptyset(&sa.sa_mask);
+      g_touch_serve_signal = 0;
+      sigaction(SIGINT, &sa, &old_int);
+      sigaction(SIGTERM, &sa, &old_term);
+      while(!touch->serve_stop && !g_touch_serve_signal){
+        client_fd = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+        if(client_fd >= 0){
+          touch_serve_client(touch, client_fd);
+          close(client_fd);
         }
-        else{
-          if(futimens(fd, touch->time_am) != 0){
-            touch_warn(touch, true, "futimens: %s", path);
-          }
+        else if(errno != EINTR && errno != ECONNABORTED){
+          touch_warn(touch, true, "accept: %s", touch->serve_path);
+          touch->serve_stop = true;
         }
       }
-    }
-  }
-  else{
-    if(utimensat(AT_FDCWD, path, touch->time_am, 0) != 0){
-      touch_warn(touch, true, "utimensat on: %s", path);
+      sigaction(SIGINT, &old_int, NULL);
+      sigaction(SIGTERM, &old_term, NULL);
+      unlink(touch->serve_path);
     }
   }
   if(fd >= 0){
@@ -449,112 +8404,203 @@ touch_path(struct touch *const touch,
 }
 
 /**
- * Check if only one of -r, -t, and -d arguments have been provided if any.
+ * Set the scheduling and I/O priorities of the process (--nice, --ioprio).
  *
- * @param[in] touch See @ref touch.
- * @retval    true  Valid arguments.
- * @retval    false Invalid arguments.
+ * Worker threads created afterwards inherit both priorities.
+ *
+ * @param[in,out] touch See @ref touch.
  */
-static bool
-touch_ensure_args_mutually_exclusive(const struct touch *const touch){
-  bool exclusive;
-  unsigned int flags_exclusive;
-
-  flags_exclusive = touch->flags & (TOUCH_FLAG_REF_FILE |
-                                    TOUCH_FLAG_TIME     |
-                                    TOUCH_FLAG_DATE_TIME);
-  if(flags_exclusive                        &&
-     flags_exclusive != TOUCH_FLAG_REF_FILE &&
-     flags_exclusive != TOUCH_FLAG_TIME     &&
-     flags_exclusive != TOUCH_FLAG_DATE_TIME){
-    exclusive = false;
+static void
+touch_priority_set(struct touch *const touch){
+  if(touch->set_nice && setpriority(PRIO_PROCESS, 0, touch->nice) != 0){
+    touch_warn(touch, true, "setpriority");
   }
-  else{
-    exclusive = true;
+  if(touch->ioprio){
+#ifdef TOUCH_IOPRIO
+    if(syscall(__NR_ioprio_set,
+               TOUCH_IOPRIO_WHO_PROCESS,
+               0,
+               touch->ioprio) != 0){
+      touch_warn(touch, true, "ioprio_set");
+    }
+#else /* !(TOUCH_IOPRIO) */
+    touch_warn(touch, false, "--ioprio not supported");
+#endif /* TOUCH_IOPRIO */
   }
-  return exclusive;
 }
 
 /**
  * Main entry point for touch program.
  *
  * Usage:
- * touch [-acm] [-d date_time|-r ref_file|-t time] file...
+ * touch [-acmR] [-d date_time|-r ref_file|-t time|--ref-root=dir]
+ *       [--target-root=dir] [--if-changed] [--forward-only]
+ *       [-f list|--files0-from=list] [--manifest=manifest] [-j jobs]
+ *       [--io-uring] [--new-files] [--sort] [--glob] [--durable]
+ *       [--progress[=fd]] [--max-rate=ops] [--target-latency=usec]
+ *       [--nice=level] [--ioprio=idle|level] [--plan]
+ *       [--checkpoint=file [--resume]] [--stats] [--max-errors=num]
+ *       [--collapse-errors] [file...]
+ * touch [--nice=level] [--ioprio=idle|level] --serve=socket
+ *
+ * At least one file operand, list, or manifest must be provided. Paths in a
+ * list given by -f are separated by newlines and paths in a list given by
+ * --files0-from are separated by NUL characters. Use "-" to read the list
+ * from STDIN.
+ *
+ * Each line in a manifest given by --manifest has the access time, the
+ * modification time, and the path to touch separated by single spaces.
+ * The times use either the -d format or seconds since the Epoch with an
+ * optional frac, such as "2019-01-01T09:05:00Z" or "1546333500.25".
+ *
+ * The --ref-root option gives each target the times of the file with the
+ * same relative path under the reference root, like using a different -r
+ * for each target. Targets get appended to the reference root, or if
+ * --target-root has been provided, the part of each target under the
+ * target root gets appended instead. Targets without a reference file get
+ * skipped with an error.
+ *
+ * The --if-changed option checks the times of existing files first and
+ * leaves a file alone if it already has the requested times. The
+ * --forward-only option also leaves alone any time that would move
+ * backwards, so running the same restore again never lowers a time.
+ *
+ * The -j option touches the paths using a pool of worker threads. Error
+ * messages still get printed in the same order as the paths.
+ *
+ * The --sort option touches the targets grouped by parent directory
+ * instead of in the order given. Directories with many targets get read
+ * first to touch their targets in inode number order. Error messages get
+ * printed in the order the targets get touched.
+ *
+ * The -R option also touches everything inside of directory operands.
+ *
+ * The --glob option expands file operands containing *, ?, [, or a
+ * backslash into the existing paths they match, without needing a shell
+ * or running into ARG_MAX. A "**" component matches zero or more
+ * directories. Names starting with '.' only match a '.' in the pattern,
+ * and "**" does not follow symbolic links. Matches get touched while
+ * walking the tree, and patterns that match nothing get ignored. Operands
+ * without pattern characters get touched the usual way.
+ *
+ * The --durable option flushes the touched files to storage before
+ * exiting. Each filesystem holding a touched file gets flushed once using
+ * syncfs() after all targets have been touched, which costs far less than
+ * flushing each file separately or flushing every filesystem. Every
+ * filesystem gets flushed instead if syncfs() is not available.
+ *
+ * The --io-uring option creates files using batched io_uring requests when
+ * running on a kernel that supports it, and otherwise has no effect.
+ *
+ * The --new-files option tries creating each file first, for targets that
+ * are expected to not exist yet. New files only get their times set if
+ * they differ from the current time, and get closed in batches. Files that
+ * already exist get touched the usual way. Has no effect with -c.
+ *
+ * The --serve option runs a server accepting requests on a Unix socket
+ * instead, which avoids starting a new process for each batch. Each
+ * request has the same arguments as the command line, without the program
+ * name, each terminated by a NUL character and followed by an empty
+ * argument. The response has the exit status followed by the status of
+ * each file operand, as '0' for success or '1' for failure, and a newline.
+ * A request with no arguments closes the connection, and a request with
+ * only "--shutdown" stops the server, as do SIGINT and SIGTERM. Relative
+ * paths in requests resolve against the working directory of the server,
+ * and requests cannot use --serve or --progress. A stale socket left
+ * behind at the path gets replaced. Error messages still get printed to
+ * STDERR of the server.
+ *
+ * Error messages get buffered and written to STDERR in large blocks. The
+ * --max-errors option stops printing messages after the given number of
+ * messages, and the --collapse-errors option only prints the first
+ * message for each errno value. A count of the messages that did not get
+ * printed comes at the end. Neither option changes the exit status.
+ *
+ * The --progress option reports the number of targets done, the number of
+ * errors, the rate of targets done per second since the previous report,
+ * and the number of paths waiting for a worker thread once a second while
+ * running, along with a final report when finished. The reports go to
+ * STDERR, or to the given file descriptor such as --progress=3.
+ *
+ * The --max-rate option limits the number of touch operations per second
+ * across all worker threads, so a bulk run does not take over a shared
+ * file server. The --target-latency option measures each utimensat() call
+ * and pauses worker threads while the average latency stays above the
+ * given number of microseconds, bringing them back one at a time once the
+ * server catches up. The --nice and --ioprio options set the scheduling
+ * priority and the I/O priority of the process and its worker threads,
+ * where --ioprio takes "idle" or a best-effort level from 0 to 7. Failing
+ * to set either priority stops before touching anything. Requests sent to
+ * a server ignore --nice and --ioprio, which only apply to the server
+ * itself.
+ *
+ * The --plan option finds out what touching each target would do without
+ * creating or changing anything. Each target gets counted as created,
+ * updated, unchanged, skipped by -c, or failed, and targets that would fail
+ * get reported the same way as when touching them. The counts get printed
+ * to STDOUT for each filesystem along with its number of directories,
+ * followed by the totals, the estimated number of system calls, the
+ * average time taken to look up each target, and the estimated run time
+ * for the given -j, --durable, and --max-rate options. Creating and
+ * updating each file costs about one metadata round trip per system call,
+ * so the lookup time stands in for the time taken by each call.
+ *
+ * The --checkpoint option saves the offset in the list or manifest up to
+ * which every path has been touched to the given file once a second and
+ * when finished, along with the total number of targets done and errors by
+ * errno as a one-line JSON object. The --resume option starts the list or
+ * manifest at the saved offset, so an interrupted run only pays for the
+ * remaining paths, and keeps adding to the saved totals. A missing
+ * checkpoint starts from the beginning. File operands always get touched,
+ * and a single list or manifest must be given. Lists given to -j get
+ * touched in batches while saving checkpoints. The --plan option reads a
+ * checkpoint but never saves one. A list or manifest that cannot seek,
+ * such as a pipe, still has to read the bytes before the saved offset
+ * when resuming, so it must feed the same paths in the same order.
+ *
+ * The --stats option prints a one-line JSON summary to STDERR when
+ * finished, with the number of opens, files created, utimensat and
+ * futimens calls, files checked for their times, files left unchanged,
+ * missing files, errors by errno, and the nanoseconds spent parsing and
+ * touching files.
  *
  * @param[in]     argc         Number of arguments in @p argv.
  * @param[in,out] argv         Argument list.
  * @retval        EXIT_SUCCESS Successful.
  * @retval        EXIT_FAILURE Error occurred.
  */
-TOUCH_LINKAGE int
+int
 touch_main(int argc,
            char *const argv[]){
   struct touch touch;
-  int i;
-  int c;
+  unsigned long start;
+  int ops;
 
+  start = touch_clock_ns();
   memset(&touch, 0, sizeof(touch));
-  while((c = getopt(argc, argv, "acd:mr:t:")) != -1){
-    switch(c){
-    case 'a':
-      touch.flags |= TOUCH_FLAG_ACCESS_TIME;
-      break;
-    case 'c':
-      touch.flags |= TOUCH_FLAG_NO_CREATE;
-      break;
-    case 'd':
-      touch_parse_date_time(&touch, optarg);
-      touch.flags |= TOUCH_FLAG_DATE_TIME;
-      break;
-    case 'm':
-      touch.flags |= TOUCH_FLAG_MOD_TIME;
-      break;
-    case 'r':
-      touch_get_time_ref_file(&touch, optarg);
-      touch.flags |= TOUCH_FLAG_REF_FILE;
-      break;
-    case 't':
-      touch_parse_time(&touch, optarg);
-      touch.flags |= TOUCH_FLAG_TIME;
-      break;
-    default:
-      touch.status_code = EXIT_FAILURE;
-      break;
-    }
+  ops = touch_parse_args(&touch, argc, argv);
+  argc -= ops;
+  argv += ops;
+  if(touch.flags & TOUCH_FLAG_STATS){
+    touch.stats.parse_ns = touch_clock_ns() - start;
+  }
+  if(touch.status_code == EXIT_SUCCESS){
+    touch_priority_set(&touch);
   }
-  argc -= optind;
-  argv += optind;
 
-  if(argc < 1){
-    touch_warn(&touch, false, "file... argument required");
+  if(touch.serve_path == NULL){
+    touch_run(&touch, argc, argv, NULL);
   }
-  else if(touch_ensure_args_mutually_exclusive(&touch) == false){
-    touch_warn(&touch, false, "-r, -t, and -d mutually exclusive");
+  else if(argc > 0){
+    touch_warn(&touch, false, "--serve does not take file operands");
   }
-  else if(touch.status_code == 0){
-    /* Use current time if the user did not specify a time. */
-    if(touch.time_am[0].tv_sec == 0){
-      touch.time_am[0].tv_nsec = UTIME_NOW;
-      touch.time_am[1].tv_nsec = UTIME_NOW;
-    }
-    if(!(touch.flags & TOUCH_FLAG_ACCESS_TIME) &&
-       !(touch.flags & TOUCH_FLAG_MOD_TIME)){
-      /* Update both access and modification times. */
-    }
-    else if(!(touch.flags & TOUCH_FLAG_ACCESS_TIME)){
-      touch.time_am[0].tv_nsec = UTIME_OMIT;
-    }
-    else if(!(touch.flags & TOUCH_FLAG_MOD_TIME)){
-      touch.time_am[1].tv_nsec = UTIME_OMIT;
-    }
-    for(i = 0; i < argc; i++){
-      touch_path(&touch, argv[i]);
-    }
+  else if(touch.status_code == EXIT_SUCCESS){
+    touch_serve(&touch);
   }
   return touch.status_code;
 }
 
-#ifndef TOUCH_TEST
+#if !defined(TOUCH_TEST) && !defined(TOUCH_LIB)
 /**
  * Main program entry point.
  *
@@ -567,5 +8613,5 @@ main(const int argc,
      char *const argv[]){
   return touch_main(argc, argv);
 }
-#endif /* TOUCH_TEST */
+#endif /* !(TOUCH_TEST) && !(TOUCH_LIB) */
 
@@ -0,0 +1,222 @@
+/**
+ * @file
+ * @brief Touch library
+ * @author James Humphrey (humphreyj@somnisoft.com)
+ *
+ * Update file access/modification times from within another program.
+ *
+ * This software has been placed into the public domain using CC0.
+ */
+#ifndef TOUCH_H
+#define TOUCH_H
+
+#include <stddef.h>
+
+/**
+ * @defgroup touch_flag touch flags
+ *
+ * Option flags when running touch or creating a @ref touch_ctx.
+ */
+
+/**
+ * Change file access time.
+ *
+ * Do not change modification time unless @ref TOUCH_FLAG_MOD_TIME (-m) also
+ * set.
+ *
+ * This flag corresponds to argument -a.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_ACCESS_TIME (1 << 0)
+
+/**
+ * Do not create the file if it does not already exist.
+ *
+ * This flag corresponds to argument -c.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_NO_CREATE   (1 << 1)
+
+/**
+ * Change file modification time.
+ *
+ * Do not change access time unless @ref TOUCH_FLAG_ACCESS_TIME (-a) also set.
+ *
+ * This flag corresponds to argument -m.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_MOD_TIME    (1 << 2)
+
+/**
+ * Use the time from a reference file.
+ *
+ * This flag corresponds to argument -r.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_REF_FILE    (1 << 3)
+
+/**
+ * Use the time specified in the following format.
+ *
+ * [[CC]YY]MMDDhhmm[.SS]
+ *
+ * This flag corresponds to argument -t.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_TIME        (1 << 4)
+
+/**
+ * Use the date_time specified in the following format.
+ *
+ * YYYY-MM-DDThh:mm:SS[[.|,]frac][tz]
+ *
+ * This flag corresopnds to argument -d.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_DATE_TIME   (1 << 5)
+
+/**
+ * Create files using batched io_uring requests if the kernel supports it.
+ *
+ * This flag corresponds to argument --io-uring.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_IO_URING    (1 << 6)
+
+/**
+ * Touch all files and directories inside of directory operands.
+ *
+ * Symbolic links found while walking the directories get touched instead of
+ * the files they point to, and never get followed.
+ *
+ * This flag corresponds to argument -R.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_RECURSIVE   (1 << 7)
+
+/**
+ * Print a one-line JSON summary of the file system calls made, errors by
+ * errno, and the time spent parsing and touching files.
+ *
+ * This flag corresponds to argument --stats. Not supported by
+ * touch_ctx_new().
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_STATS       (1 << 8)
+
+/**
+ * Give each target the times of its counterpart under a reference root.
+ *
+ * This flag corresponds to argument --ref-root.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_REF_ROOT    (1 << 9)
+
+/**
+ * Skip the update when an existing file already has the requested times.
+ *
+ * This flag corresponds to argument --if-changed.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_IF_CHANGED  (1 << 10)
+
+/**
+ * Never move the times of an existing file backwards.
+ *
+ * This flag corresponds to argument --forward-only.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_FORWARD     (1 << 11)
+
+/**
+ * Only print the first error for each errno value and count the rest.
+ *
+ * This flag corresponds to argument --collapse-errors.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_COLLAPSE    (1 << 12)
+
+/**
+ * Expect the targets to not exist yet and try creating them first.
+ *
+ * This flag corresponds to argument --new-files.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_NEW         (1 << 13)
+
+/**
+ * Group the targets by parent directory before touching them.
+ *
+ * This flag corresponds to argument --sort.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_SORT        (1 << 14)
+
+/**
+ * Expand file operands containing pattern characters into the existing
+ * paths they match.
+ *
+ * This flag corresponds to argument --glob.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_GLOB        (1 << 15)
+
+/**
+ * Flush the touched files to storage before returning.
+ *
+ * This flag corresponds to argument --durable.
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_DURABLE     (1 << 16)
+
+/**
+ * Find out what touching each target would do without changing anything,
+ * and print a summary along with an estimated cost.
+ *
+ * This flag corresponds to argument --plan. Not supported by
+ * touch_ctx_new().
+ *
+ * @ingroup touch_flag
+ */
+#define TOUCH_FLAG_PLAN        (1 << 17)
+
+struct touch_ctx;
+
+struct touch_ctx *
+touch_ctx_new(unsigned int flags,
+              const char *const time_str);
+
+int
+touch_ctx_apply(struct touch_ctx *const ctx,
+                const char *const path);
+
+int
+touch_ctx_apply_many(struct touch_ctx *const ctx,
+                     const char *const paths[],
+                     size_t num_paths);
+
+void
+touch_ctx_free(struct touch_ctx *const ctx);
+
+int
+touch_main(int argc,
+           char *const argv[]);
+
+#endif /* TOUCH_H */
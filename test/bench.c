@@ -0,0 +1,462 @@
+/**
+ * @file
+ * @brief Benchmark touch
+ * @author James Humphrey (humphreyj@somnisoft.com)
+ *
+ * Measure the number of system calls, throughput, and latency per file
+ * touched across a synthetic directory tree.
+ *
+ * This software has been placed into the public domain using CC0.
+ */
+
+#include <sys/stat.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "test.h"
+
+/**
+ * Default directory containing the files to touch.
+ */
+#define BENCH_DIR "/tmp/touch-bench"
+
+/**
+ * Default number of files to touch in each benchmark.
+ */
+#define BENCH_DEFAULT_NUM_FILES (10000)
+
+/**
+ * Maximum number of directories generated in the tree.
+ */
+#define BENCH_MAX_DIRS (100000)
+
+/**
+ * Maximum number of option arguments placed before the file operands.
+ */
+#define BENCH_MAX_OPTS (4)
+
+/**
+ * Maximum length of an option argument.
+ */
+#define BENCH_MAX_OPT_LEN (32)
+
+/**
+ * Number of nanoseconds in one second.
+ */
+#define BENCH_NSEC_PER_SEC (1000000000UL)
+
+/**
+ * Synthetic directory tree containing the files to touch.
+ */
+struct bench_tree{
+  /**
+   * Directories in the order they get created, starting with the root.
+   */
+  char **dirs;
+
+  /**
+   * Number of directories in @ref dirs.
+   */
+  size_t num_dirs;
+
+  /**
+   * File paths spread across the deepest directories.
+   */
+  char **files;
+
+  /**
+   * Number of files in @ref files.
+   */
+  size_t num_files;
+
+  /**
+   * Argument list passed to @ref touch_main, with room for the options
+   * followed by every path in @ref files.
+   */
+  char **argv;
+
+  /**
+   * Per-file latency measurements in nanoseconds.
+   */
+  unsigned long *latency;
+
+  /**
+   * Set if the files currently exist.
+   */
+  bool files_exist;
+};
+
+/**
+ * Benchmark mode describing the touch options to use.
+ */
+struct bench_mode{
+  /**
+   * Benchmark name.
+   */
+  const char *name;
+
+  /**
+   * See @ref touch_flag.
+   */
+  unsigned int flags;
+
+  /**
+   * Option arguments passed to @ref touch_main, terminated by NULL.
+   */
+  const char *opts[BENCH_MAX_OPTS];
+
+  /**
+   * Time argument passed to @ref touch_ctx_new.
+   */
+  const char *time_str;
+
+  /**
+   * Remove the files before each run.
+   */
+  bool missing;
+};
+
+/**
+ * Get the elapsed time in nanoseconds since @p start.
+ *
+ * @param[in] start Start time.
+ * @return          Number of nanoseconds elapsed.
+ */
+static unsigned long
+bench_elapsed_ns(const struct timespec *const start){
+  struct timespec end;
+
+  assert(clock_gettime(CLOCK_MONOTONIC, &end) == 0);
+  return (unsigned long)(end.tv_sec - start->tv_sec) * BENCH_NSEC_PER_SEC +
+         (unsigned long)end.tv_nsec - (unsigned long)start->tv_nsec;
+}
+
+/**
+ * Allocate a copy of a path joined with a name.
+ *
+ * @param[in] dir  Directory path.
+ * @param[in] name Entry name.
+ * @return         New path which must get freed.
+ */
+static char *
+bench_join(const char *const dir,
+           const char *const name){
+  char *path;
+
+  path = malloc(strlen(dir) + strlen(name) + 2);
+  assert(path);
+  sprintf(path, "%s/%s", dir, name);
+  return path;
+}
+
+/**
+ * Generate the list of directories and files in a tree.
+ *
+ * Every directory above @p depth contains @p width subdirectories, and the
+ * files get distributed evenly across the directories at the deepest level.
+ *
+ * @param[out] tree      See @ref bench_tree.
+ * @param[in]  root      Root directory of the tree.
+ * @param[in]  num_files Number of files to generate.
+ * @param[in]  depth     Number of directory levels below @p root.
+ * @param[in]  width     Number of subdirectories in each directory.
+ */
+static void
+bench_tree_init(struct bench_tree *const tree,
+                const char *const root,
+                const size_t num_files,
+                const size_t depth,
+                const size_t width){
+  char name[32];
+  size_t level_start;
+  size_t level_end;
+  size_t level;
+  size_t i;
+  size_t j;
+  size_t max_dirs;
+
+  memset(tree, 0, sizeof(*tree));
+  max_dirs = 1;
+  level_end = 1;
+  for(level = 0; level < depth; level++){
+    level_end *= width;
+    max_dirs += level_end;
+    assert(max_dirs <= BENCH_MAX_DIRS);
+  }
+  tree->dirs = malloc(max_dirs * sizeof(*tree->dirs));
+  assert(tree->dirs);
+  tree->dirs[0] = malloc(strlen(root) + 1);
+  assert(tree->dirs[0]);
+  strcpy(tree->dirs[0], root);
+  tree->num_dirs = 1;
+  level_start = 0;
+  level_end = 1;
+  for(level = 0; level < depth; level++){
+    for(i = level_start; i < level_end; i++){
+      for(j = 0; j < width; j++){
+        sprintf(name, "d%lu", (unsigned long)j);
+        tree->dirs[tree->num_dirs++] = bench_join(tree->dirs[i], name);
+      }
+    }
+    level_start = level_end;
+    level_end = tree->num_dirs;
+  }
+
+  tree->num_files = num_files;
+  tree->files = malloc(num_files * sizeof(*tree->files));
+  tree->argv = malloc((num_files + BENCH_MAX_OPTS + 1) * sizeof(*tree->argv));
+  tree->latency = malloc(num_files * sizeof(*tree->latency));
+  assert(tree->files);
+  assert(tree->argv);
+  assert(tree->latency);
+  for(i = 0; i < num_files; i++){
+    sprintf(name, "f%lu", (unsigned long)i);
+    tree->files[i] = bench_join(
+      tree->dirs[level_start + i % (level_end - level_start)],
+      name);
+  }
+  for(i = 0; i < tree->num_dirs; i++){
+    assert(mkdir(tree->dirs[i], S_IRWXU) == 0);
+  }
+}
+
+/**
+ * Remove the files in the tree if they exist.
+ *
+ * @param[in,out] tree See @ref bench_tree.
+ */
+static void
+bench_tree_remove_files(struct bench_tree *const tree){
+  size_t i;
+
+  if(tree->files_exist){
+    for(i = 0; i < tree->num_files; i++){
+      assert(remove(tree->files[i]) == 0);
+    }
+    tree->files_exist = false;
+  }
+}
+
+/**
+ * Remove the tree from the file system and free its lists.
+ *
+ * @param[in,out] tree See @ref bench_tree.
+ */
+static void
+bench_tree_free(struct bench_tree *const tree){
+  size_t i;
+
+  bench_tree_remove_files(tree);
+  for(i = tree->num_dirs; i-- > 0;){
+    assert(rmdir(tree->dirs[i]) == 0);
+    free(tree->dirs[i]);
+  }
+  for(i = 0; i < tree->num_files; i++){
+    free(tree->files[i]);
+  }
+  free(tree->dirs);
+  free(tree->files);
+  free(tree->argv);
+  free(tree->latency);
+}
+
+/**
+ * Compare two latency measurements for qsort.
+ *
+ * @param[in] v1 First latency value.
+ * @param[in] v2 Second latency value.
+ * @retval    <0 @p v1 less than @p v2.
+ * @retval    0  Latency values equal.
+ * @retval    >0 @p v1 greater than @p v2.
+ */
+static int
+bench_latency_cmp(const void *const v1,
+                  const void *const v2){
+  const unsigned long *const l1 = v1;
+  const unsigned long *const l2 = v2;
+
+  return (*l1 > *l2) - (*l1 < *l2);
+}
+
+/**
+ * Get a percentile from a sorted list of latency measurements.
+ *
+ * @param[in] tree       See @ref bench_tree.
+ * @param[in] percentile Percentile between 0 and 100.
+ * @return               Latency in microseconds.
+ */
+static double
+bench_percentile(const struct bench_tree *const tree,
+                 const size_t percentile){
+  size_t i;
+
+  i = (tree->num_files - 1) * percentile / 100;
+  return (double)tree->latency[i] / 1000.0;
+}
+
+/**
+ * Run one benchmark mode on the tree and print the results.
+ *
+ * Throughput and system calls get measured by running @ref touch_main on
+ * every file at once. The latency of each file then gets measured by
+ * running @ref touch_ctx_apply on every file one at a time.
+ *
+ * @param[in,out] tree See @ref bench_tree.
+ * @param[in]     mode See @ref bench_mode.
+ */
+static void
+bench_run(struct bench_tree *const tree,
+          const struct bench_mode *const mode){
+  char opt_buf[BENCH_MAX_OPTS][BENCH_MAX_OPT_LEN];
+  char touch_arg[] = "touch";
+  struct timespec start;
+  struct touch_ctx *ctx;
+  unsigned long syscall_ctr;
+  unsigned long elapsed;
+  size_t argc;
+  size_t i;
+
+  if(mode->missing){
+    bench_tree_remove_files(tree);
+  }
+  argc = 0;
+  tree->argv[argc++] = touch_arg;
+  for(i = 0; mode->opts[i]; i++){
+    assert(strlen(mode->opts[i]) < BENCH_MAX_OPT_LEN);
+    strcpy(opt_buf[i], mode->opts[i]);
+    tree->argv[argc++] = opt_buf[i];
+  }
+  memcpy(&tree->argv[argc],
+         tree->files,
+         tree->num_files * sizeof(*tree->files));
+  argc += tree->num_files;
+
+  syscall_ctr = g_test_seam_syscall_ctr;
+  optind = 0;
+  assert(clock_gettime(CLOCK_MONOTONIC, &start) == 0);
+  assert(touch_main((int)argc, tree->argv) == EXIT_SUCCESS);
+  elapsed = bench_elapsed_ns(&start);
+  syscall_ctr = g_test_seam_syscall_ctr - syscall_ctr;
+  if(!(mode->flags & TOUCH_FLAG_NO_CREATE)){
+    tree->files_exist = true;
+  }
+
+  if(mode->missing){
+    bench_tree_remove_files(tree);
+  }
+  ctx = touch_ctx_new(mode->flags, mode->time_str);
+  assert(ctx);
+  for(i = 0; i < tree->num_files; i++){
+    assert(clock_gettime(CLOCK_MONOTONIC, &start) == 0);
+    assert(touch_ctx_apply(ctx, tree->files[i]) == EXIT_SUCCESS);
+    tree->latency[i] = bench_elapsed_ns(&start);
+  }
+  touch_ctx_free(ctx);
+  if(!(mode->flags & TOUCH_FLAG_NO_CREATE)){
+    tree->files_exist = true;
+  }
+  qsort(tree->latency,
+        tree->num_files,
+        sizeof(*tree->latency),
+        bench_latency_cmp);
+
+  printf("%-10s %8lu files %6.2f syscalls/file %10.0f files/sec "
+         "p50 %8.2f us p99 %8.2f us\n",
+         mode->name,
+         (unsigned long)tree->num_files,
+         (double)syscall_ctr / (double)tree->num_files,
+         (double)tree->num_files * (double)BENCH_NSEC_PER_SEC /
+         (double)(elapsed ? elapsed : 1),
+         bench_percentile(tree, 50),
+         bench_percentile(tree, 99));
+}
+
+/**
+ * Benchmark touch on newly created and existing files.
+ *
+ * Usage: bench [-g] [-n num_files] [-l depth] [-w width] [-p dir]
+ *
+ * The directory given by -p must not exist. Use a directory on tmpfs to
+ * measure the overhead of touch itself, or a directory on a real disk to
+ * include the file system costs. The -g option touches each path using the
+ * generic touch_path() instead of the apply kernel chosen for the mode, to
+ * compare the two.
+ *
+ * @param[in] argc Number of arguments in @p argv.
+ * @param[in] argv Argument list.
+ * @retval    0    Benchmark completed.
+ */
+int
+main(int argc,
+     char *argv[]){
+  const struct bench_mode MODES[] = {
+    {"create",     0,                    {NULL},                 NULL, true},
+    {"create-new", TOUCH_FLAG_NEW,       {"--new-files", NULL},  NULL, true},
+    {"existing",   0,                    {NULL},                 NULL, false},
+    {"existing-c", TOUCH_FLAG_NO_CREATE, {"-c", NULL},           NULL, false},
+    {"ref-file",   TOUCH_FLAG_REF_FILE,
+                   {"-r", "/etc/hosts", NULL},
+                   "/etc/hosts", false},
+    {"date-time",  TOUCH_FLAG_DATE_TIME,
+                   {"-d", "2019-01-01T09:05:00", NULL},
+                   "2019-01-01T09:05:00", false},
+    {"if-changed", TOUCH_FLAG_IF_CHANGED | TOUCH_FLAG_DATE_TIME,
+                   {"--if-changed", "-d", "2019-01-01T09:05:00", NULL},
+                   "2019-01-01T09:05:00", false},
+    {"missing-c",  TOUCH_FLAG_NO_CREATE, {"-c", NULL},           NULL, true}
+  };
+  struct bench_tree tree;
+  const char *root;
+  size_t num_files;
+  size_t depth;
+  size_t width;
+  size_t i;
+  int c;
+
+  root = BENCH_DIR;
+  num_files = BENCH_DEFAULT_NUM_FILES;
+  depth = 0;
+  width = 1;
+  while((c = getopt(argc, argv, "gl:n:p:w:")) != -1){
+    switch(c){
+    case 'g':
+      g_test_seam_apply_kernels = 0;
+      break;
+    case 'l':
+      depth = strtoul(optarg, NULL, 10);
+      break;
+    case 'n':
+      num_files = strtoul(optarg, NULL, 10);
+      break;
+    case 'p':
+      root = optarg;
+      break;
+    case 'w':
+      width = strtoul(optarg, NULL, 10);
+      break;
+    default:
+      fprintf(stderr,
+              "usage: bench [-g] [-n num_files] [-l depth] [-w width] "
+              "[-p dir]\n");
+      return 1;
+    }
+  }
+  assert(num_files > 0);
+  assert(width > 0);
+
+  printf("%s: depth %lu width %lu\n",
+         root,
+         (unsigned long)depth,
+         (unsigned long)width);
+  bench_tree_init(&tree, root, num_files, depth, width);
+  for(i = 0; i < sizeof(MODES) / sizeof(MODES[0]); i++){
+    bench_run(&tree, &MODES[i]);
+  }
+  bench_tree_free(&tree);
+  return 0;
+}
@@ -6,57 +6,423 @@
  * This software has been placed into the public domain using CC0.
  */
 
+#include <sys/stat.h>
 #include <assert.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "test.h"
 
 /**
- * Number of arguments sent to the touch program.
+ * Scratch directory holding the fuzz input and the touched files.
  */
-#define ARGC (4)
+#define FUZZ_DIR "/tmp/touch-fuzz"
 
 /**
- * Fuzz test the date_time string.
- *
- * Usage: fuzz-driver
+ * Directory the touch program runs in, which only holds touched files.
+ */
+#define FUZZ_ROOT FUZZ_DIR "/root"
+
+/**
+ * File holding the list or manifest given to the touch program.
+ */
+#define FUZZ_INPUT FUZZ_DIR "/input"
+
+/**
+ * File collecting the error messages from the touch program.
+ */
+#define FUZZ_STDERR FUZZ_DIR "/stderr"
+
+/**
+ * Time given by -d to every path in a list.
+ */
+#define FUZZ_LIST_TIME "2001-02-03T04:05:06Z"
+
+/**
+ * Maximum number of arguments sent to the touch program.
+ */
+#define FUZZ_ARGC_MAX (8)
+
+/**
+ * Number of bytes of slack given to every input by -l, so the fixed cost of
+ * starting a run does not flag small inputs.
+ */
+#define FUZZ_SLACK_BYTES (1000)
+
+/**
+ * Start of the statistics line printed by --stats.
+ */
+#define FUZZ_STATS_LINE "{\"opens\":"
+
+/**
+ * Input format getting fuzzed.
+ */
+enum fuzz_mode{
+  /**
+   * Input is the date_time string given to -d.
+   */
+  FUZZ_MODE_DATE,
+
+  /**
+   * Input is a list of paths given to -f.
+   */
+  FUZZ_MODE_LIST,
+
+  /**
+   * Input is a list of paths given to --files0-from.
+   */
+  FUZZ_MODE_LIST0,
+
+  /**
+   * Input is a manifest given to --manifest.
+   */
+  FUZZ_MODE_MANIFEST
+};
+
+/**
+ * Result of running the touch program on the fuzz input.
+ */
+struct fuzz_result{
+  /**
+   * Exit status from @ref touch_main.
+   */
+  int status;
+
+  /**
+   * Number of files in @ref FUZZ_ROOT after the run.
+   */
+  size_t num_files;
+
+  /**
+   * Hash of the name and times of each file in @ref FUZZ_ROOT, which does
+   * not depend on the order of the directory entries.
+   */
+  unsigned long files_hash;
+
+  /**
+   * Error messages printed by the run, without the statistics line.
+   */
+  char *err;
+
+  /**
+   * Time spent parsing reported by --stats.
+   */
+  unsigned long parse_ns;
+};
+
+/**
+ * Read an entire stream into a NUL-terminated buffer.
  *
- * @retval 0 All tests passed.
+ * @param[in,out] fp  Stream to read.
+ * @param[out]    len Number of bytes read, not counting the NUL.
+ * @return            Allocated contents, free with free().
  */
-int
-main(void){
-  const char *const PATH_TMP_FILE = "/tmp/touch-fuzz.txt";
-  char *argv[ARGC];
-  FILE *fp;
-  char *date_time;
+static char *
+fuzz_read(FILE *const fp,
+          size_t *const len){
+  char *data;
   size_t bufsz;
-  size_t buflen;
   size_t bytes_read;
-  size_t i;
-  size_t arg_alloc_sz;
 
-  fp = stdin;
-  date_time = NULL;
+  data = NULL;
   bufsz = 0;
-  buflen = 0;
+  *len = 0;
   do{
     bufsz += 1000;
-    date_time = realloc(date_time, bufsz);
-    assert(date_time);
-    bytes_read = fread(&date_time[buflen], 1, bufsz - buflen, fp);
-    buflen += bytes_read;
+    data = realloc(data, bufsz);
+    assert(data);
+    bytes_read = fread(&data[*len], 1, bufsz - *len - 1, fp);
+    *len += bytes_read;
     assert(ferror(fp) == 0);
   } while(!feof(fp));
-  date_time[buflen] = '\0';
-
-  argv[0] = "touch";
-  argv[1] = "-d";
-  argv[2] = date_time;
-  argv[3] = PATH_TMP_FILE;
-  touch_main(ARGC, argv);
-  free(date_time);
-  return 0;
+  data[*len] = '\0';
+  return data;
 }
 
+/**
+ * Hash a string into an existing FNV-1a hash.
+ *
+ * @param[in] hash Hash so far.
+ * @param[in] str  String to add.
+ * @return         Updated hash.
+ */
+static unsigned long
+fuzz_hash(unsigned long hash,
+          const char *const str){
+  size_t i;
+
+  for(i = 0; str[i]; i++){
+    hash = (hash ^ (unsigned char)str[i]) * 16777619UL;
+  }
+  return hash;
+}
+
+/**
+ * Remove every file in @ref FUZZ_ROOT, optionally recording them first.
+ *
+ * @param[out] result Records the files if not NULL.
+ */
+static void
+fuzz_root_clear(struct fuzz_result *const result){
+  char times[100];
+  DIR *dir;
+  struct dirent *ent;
+  struct stat sb;
+
+  dir = opendir(FUZZ_ROOT);
+  assert(dir);
+  while((ent = readdir(dir)) != NULL){
+    if(strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0){
+      /* Skip the directory itself and its parent. */
+    }
+    else{
+      assert(lstat(ent->d_name, &sb) == 0);
+      if(result){
+        sprintf(times,
+                "/%ld.%ld/%ld.%ld",
+                (long)sb.st_atim.tv_sec,
+                sb.st_atim.tv_nsec,
+                (long)sb.st_mtim.tv_sec,
+                sb.st_mtim.tv_nsec);
+        result->num_files += 1;
+        result->files_hash += fuzz_hash(fuzz_hash(2166136261UL,
+                                                  ent->d_name),
+                                        times);
+      }
+      assert(unlink(ent->d_name) == 0);
+    }
+  }
+  assert(closedir(dir) == 0);
+}
+
+/**
+ * Run the touch program with its error messages going to @ref FUZZ_STDERR.
+ *
+ * @param[in]  argc   Number of arguments in @p argv.
+ * @param[in]  argv   Arguments for @ref touch_main.
+ * @param[in]  fast   Set to use the fixed-layout date time parser when the
+ *                    string allows it, or clear to always use strptime().
+ * @param[out] result Result of the run.
+ */
+static void
+fuzz_touch(const int argc,
+           char *const argv[],
+           const int fast,
+           struct fuzz_result *const result){
+  FILE *fp;
+  char *stats;
+  size_t len;
+  int err_fd;
+  int saved_fd;
+
+  memset(result, 0, sizeof(*result));
+  fuzz_root_clear(NULL);
+  err_fd = open(FUZZ_STDERR, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  assert(err_fd >= 0);
+  fflush(stderr);
+  saved_fd = dup(STDERR_FILENO);
+  assert(saved_fd >= 0);
+  assert(dup2(err_fd, STDERR_FILENO) == STDERR_FILENO);
+  assert(close(err_fd) == 0);
+  g_test_seam_date_time_fast = fast;
+  optind = 0;
+  result->status = touch_main(argc, argv);
+  fflush(stderr);
+  assert(dup2(saved_fd, STDERR_FILENO) == STDERR_FILENO);
+  assert(close(saved_fd) == 0);
+  fuzz_root_clear(result);
+
+  fp = fopen(FUZZ_STDERR, "r");
+  assert(fp);
+  result->err = fuzz_read(fp, &len);
+  assert(fclose(fp) == 0);
+  stats = strstr(result->err, FUZZ_STATS_LINE);
+  while(stats && strstr(stats + 1, "\n" FUZZ_STATS_LINE)){
+    stats = strstr(stats + 1, "\n" FUZZ_STATS_LINE) + 1;
+  }
+  if(stats){
+    sscanf(strstr(stats, "\"parse_ns\":"), "\"parse_ns\":%lu",
+           &result->parse_ns);
+    *stats = '\0';
+  }
+}
+
+/**
+ * Build the arguments for one of the paths through the touch program.
+ *
+ * @param[in]  mode      See @ref fuzz_mode.
+ * @param[in]  input     Fuzz input.
+ * @param[in]  reference Set for the reference path, or clear for the fast
+ *                       path.
+ * @param[out] argv      Arguments for @ref touch_main.
+ * @return               Number of arguments in @p argv.
+ */
+static int
+fuzz_args(const enum fuzz_mode mode,
+          char *const input,
+          const bool reference,
+          char *argv[]){
+  int argc;
+
+  argc = 0;
+  argv[argc++] = "touch";
+  argv[argc++] = "--stats";
+  if(mode == FUZZ_MODE_DATE){
+    argv[argc++] = "-d";
+    argv[argc++] = input;
+    argv[argc++] = "file";
+  }
+  else if(mode == FUZZ_MODE_MANIFEST){
+    argv[argc++] = "--manifest=" FUZZ_INPUT;
+  }
+  else{
+    argv[argc++] = "-d";
+    argv[argc++] = FUZZ_LIST_TIME;
+    if(!reference){
+      argv[argc++] = "-j";
+      argv[argc++] = "4";
+    }
+    if(mode == FUZZ_MODE_LIST){
+      argv[argc++] = "-f";
+      argv[argc++] = FUZZ_INPUT;
+    }
+    else{
+      argv[argc++] = "--files0-from=" FUZZ_INPUT;
+    }
+  }
+  assert(argc <= FUZZ_ARGC_MAX);
+  argv[argc] = NULL;
+  return argc;
+}
+
+/**
+ * Write the fuzz input to @ref FUZZ_INPUT.
+ *
+ * Every '/' gets replaced so each path stays inside of @ref FUZZ_ROOT.
+ *
+ * @param[in,out] input Fuzz input.
+ * @param[in]     len   Number of bytes in @p input.
+ */
+static void
+fuzz_write_input(char *const input,
+                 const size_t len){
+  FILE *fp;
+  size_t i;
+
+  for(i = 0; i < len; i++){
+    if(input[i] == '/'){
+      input[i] = '_';
+    }
+  }
+  fp = fopen(FUZZ_INPUT, "w");
+  assert(fp);
+  assert(fwrite(input, 1, len, fp) == len);
+  assert(fclose(fp) == 0);
+}
+
+/**
+ * Print the usage and exit.
+ */
+static void
+fuzz_usage(void){
+  fprintf(stderr,
+          "usage: fuzz-driver [-m date|list|list0|manifest] "
+          "[-l max_ns_per_byte]\n");
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * Fuzz test the date_time string, list, or manifest read from STDIN.
+ *
+ * Each input goes through both a fast path and a reference path, which
+ * must agree on the exit status, error messages, and resulting file times:
+ *   - date and manifest: the fixed-layout date time parser and strptime().
+ *   - list and list0: -j 4, which streams the list through the workers and
+ *     maps large lists, and a single-threaded run.
+ *
+ * The parse time of the fast path reported by --stats gets printed for
+ * each input. If it goes over -l nanoseconds for each byte of input plus
+ * @ref FUZZ_SLACK_BYTES, the input gets flagged by aborting so the fuzzer
+ * keeps it with the crashes.
+ *
+ * Usage: fuzz-driver [-m date|list|list0|manifest] [-l max_ns_per_byte]
+ *
+ * @param[in] argc Number of arguments in @p argv.
+ * @param[in] argv Argument list.
+ * @retval    0    All tests passed.
+ */
+int
+main(int argc,
+     char *argv[]){
+  const char *const MODE_NAME[] = {"date", "list", "list0", "manifest"};
+  const size_t NUM_MODES = sizeof(MODE_NAME) / sizeof(MODE_NAME[0]);
+  char *touch_argv[FUZZ_ARGC_MAX + 1];
+  struct fuzz_result fast;
+  struct fuzz_result ref;
+  enum fuzz_mode mode;
+  char *input;
+  size_t len;
+  size_t i;
+  unsigned long max_ns_per_byte;
+  int touch_argc;
+  int c;
+
+  mode = FUZZ_MODE_DATE;
+  max_ns_per_byte = 0;
+  while((c = getopt(argc, argv, "l:m:")) != -1){
+    if(c == 'l'){
+      max_ns_per_byte = strtoul(optarg, NULL, 10);
+    }
+    else if(c == 'm'){
+      for(i = 0; i < NUM_MODES && strcmp(optarg, MODE_NAME[i]) != 0; i++){
+        /* Find the mode by name. */
+      }
+      if(i == NUM_MODES){
+        fuzz_usage();
+      }
+      mode = (enum fuzz_mode)i;
+    }
+    else{
+      fuzz_usage();
+    }
+  }
+
+  input = fuzz_read(stdin, &len);
+  mkdir(FUZZ_DIR, 0700);
+  mkdir(FUZZ_ROOT, 0700);
+  assert(chdir(FUZZ_ROOT) == 0);
+  if(mode != FUZZ_MODE_DATE){
+    fuzz_write_input(input, len);
+  }
+
+  touch_argc = fuzz_args(mode, input, false, touch_argv);
+  fuzz_touch(touch_argc, touch_argv, 1, &fast);
+  touch_argc = fuzz_args(mode, input, true, touch_argv);
+  fuzz_touch(touch_argc, touch_argv, 0, &ref);
+  assert(fast.status == ref.status);
+  assert(fast.num_files == ref.num_files);
+  assert(fast.files_hash == ref.files_hash);
+  assert(strcmp(fast.err, ref.err) == 0);
+
+  printf("%s: %lu bytes, parse_ns %lu\n",
+         MODE_NAME[mode],
+         (unsigned long)len,
+         fast.parse_ns);
+  if(max_ns_per_byte &&
+     fast.parse_ns > max_ns_per_byte * (len + FUZZ_SLACK_BYTES)){
+    fprintf(stderr,
+            "fuzz-driver: slow input: %lu ns for %lu bytes\n",
+            fast.parse_ns,
+            (unsigned long)len);
+    abort();
+  }
+  free(fast.err);
+  free(ref.err);
+  free(input);
+  return 0;
+}
@@ -6,42 +6,105 @@
  * This software has been placed into the public domain using CC0.
  */
 
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "test.h"
 
+/**
+ * Set to zero to touch every path using the generic touch_path().
+ */
+int g_test_seam_apply_kernels = 1;
+
+/**
+ * Set to zero to parse every date time string with strptime().
+ */
+int g_test_seam_date_time_fast = 1;
+
 /**
  * Error counter for @ref test_seam_futimens.
  */
 int g_test_seam_err_ctr_futimens = -1;
 
+/**
+ * Error counter for @ref test_seam_localtime_r.
+ */
+int g_test_seam_err_ctr_localtime_r = -1;
+
 /**
  * Error counter for @ref test_seam_malloc.
  */
 int g_test_seam_err_ctr_malloc = -1;
 
 /**
- * Error counter for @ref test_seam_mktime.
+ * Error counter for @ref test_seam_mmap.
+ */
+int g_test_seam_err_ctr_mmap = -1;
+
+/**
+ * Error counter for @ref test_seam_open.
  */
-int g_test_seam_err_ctr_mktime = -1;
+int g_test_seam_err_ctr_open = -1;
 
 /**
- * Error counter for @ref test_seam_setenv.
+ * Error counter for @ref test_seam_pthread_create.
  */
-int g_test_seam_err_ctr_setenv = -1;
+int g_test_seam_err_ctr_pthread_create = -1;
 
 /**
- * Error counter for @ref test_seam_strtod.
+ * Error counter for @ref test_seam_syncfs.
  */
-int g_test_seam_err_ctr_strtod = -1;
+int g_test_seam_err_ctr_syncfs = -1;
+
+/**
+ * Error counter for @ref test_seam_io_uring_enter, counting the calls that
+ * submit requests.
+ */
+int g_test_seam_err_ctr_io_uring_enter = -1;
 
 /**
  * Error counter for @ref test_seam_utimensat.
  */
 int g_test_seam_err_ctr_utimensat = -1;
 
+/**
+ * Nanoseconds between saving checkpoints.
+ */
+unsigned long g_test_seam_checkpoint_interval_ns = 1000000000UL;
+
+/**
+ * Nanoseconds between progress reports.
+ */
+unsigned long g_test_seam_progress_interval_ns = 1000000000UL;
+
+/**
+ * Nanoseconds between adjustments of the number of running workers.
+ */
+unsigned long g_test_seam_limit_window_ns = 100000000UL;
+
+/**
+ * Bits cleared from the mask returned by @ref test_seam_statx.
+ */
+unsigned int g_test_seam_statx_drop = 0;
+
+/**
+ * Nanoseconds each utimensat() call sleeps for, below one second.
+ */
+unsigned long g_test_seam_utimensat_delay_ns = 0;
+
+/**
+ * Number of file system calls made through the test seams.
+ *
+ * The benchmark driver uses this to report system calls per file.
+ */
+unsigned long g_test_seam_syscall_ctr = 0;
+
 /**
  * Decrement an error counter until it reaches -1.
  *
@@ -70,6 +133,19 @@ test_seam_dec_err_ctr(int *const err_ctr){
   return reached_end;
 }
 
+/**
+ * Count calls to close().
+ *
+ * @param[in] fd File descriptor to close.
+ * @retval    0  Successfully closed file descriptor.
+ * @retval    -1 Failed to close file descriptor.
+ */
+int
+test_seam_close(int fd){
+  g_test_seam_syscall_ctr += 1;
+  return close(fd);
+}
+
 /**
  * Control when futimens() fails.
  *
@@ -83,6 +159,7 @@ test_seam_futimens(int fd,
                    const struct timespec times[2]){
   int rc;
 
+  g_test_seam_syscall_ctr += 1;
   if(test_seam_dec_err_ctr(&g_test_seam_err_ctr_futimens)){
     errno = EINVAL;
     rc = -1;
@@ -93,6 +170,71 @@ test_seam_futimens(int fd,
   return rc;
 }
 
+/**
+ * Control when the io_uring_enter() system call fails.
+ *
+ * Only calls submitting requests count toward the error counter, so the
+ * count does not depend on how many calls it takes to reap the
+ * completions.
+ *
+ * @param[in] fd           io_uring file descriptor.
+ * @param[in] to_submit    Number of requests to submit.
+ * @param[in] min_complete Number of completions to wait for.
+ * @param[in] flags        io_uring_enter() flags.
+ * @return                 Number of requests submitted, or -1 on failure.
+ */
+long
+test_seam_io_uring_enter(int fd,
+                         unsigned int to_submit,
+                         unsigned int min_complete,
+                         unsigned int flags){
+  long rc;
+
+  g_test_seam_syscall_ctr += 1;
+  if(to_submit > 0 &&
+     test_seam_dec_err_ctr(&g_test_seam_err_ctr_io_uring_enter)){
+    errno = EIO;
+    rc = -1;
+  }
+  else{
+#ifdef __NR_io_uring_enter
+    rc = syscall(__NR_io_uring_enter,
+                 fd,
+                 to_submit,
+                 min_complete,
+                 flags,
+                 NULL,
+                 0);
+#else /* !(__NR_io_uring_enter) */
+    errno = ENOSYS;
+    rc = -1;
+#endif /* __NR_io_uring_enter */
+  }
+  return rc;
+}
+
+/**
+ * Control when localtime_r() fails.
+ *
+ * @param[in]  timer  Seconds since the Epoch.
+ * @param[out] result Broken-down local time.
+ * @return            @p result, or NULL if error.
+ */
+struct tm *
+test_seam_localtime_r(const time_t *timer,
+                      struct tm *result){
+  struct tm *tm;
+
+  if(test_seam_dec_err_ctr(&g_test_seam_err_ctr_localtime_r)){
+    errno = EOVERFLOW;
+    tm = NULL;
+  }
+  else{
+    tm = localtime_r(timer, result);
+  }
+  return tm;
+}
+
 /**
  * Control when malloc() fails.
  *
@@ -115,74 +257,166 @@ test_seam_malloc(size_t size){
 }
 
 /**
- * Control when mktime() fails.
+ * Control when mmap() fails.
  *
- * @param[in] timeptr Broken-down time structure.
- * @return            Time since the epoch, or (time_t)-1 if error.
+ * @param[in] addr  Requested address.
+ * @param[in] len   Size of the mapping.
+ * @param[in] prot  Memory protection.
+ * @param[in] flags Mapping flags.
+ * @param[in] fd    File to map, or -1 for an anonymous mapping.
+ * @param[in] off   Offset in @p fd.
+ * @return          Address of the mapping, or MAP_FAILED if error.
  */
-time_t
-test_seam_mktime(struct tm *timeptr){
-  time_t time_since_epoch;
+void *
+test_seam_mmap(void *addr,
+               size_t len,
+               int prot,
+               int flags,
+               int fd,
+               off_t off){
+  void *map;
 
-  if(test_seam_dec_err_ctr(&g_test_seam_err_ctr_mktime)){
-    errno = EOVERFLOW;
-    time_since_epoch = (time_t)-1;
+  if(test_seam_dec_err_ctr(&g_test_seam_err_ctr_mmap)){
+    errno = ENOMEM;
+    map = MAP_FAILED;
+  }
+  else{
+    map = mmap(addr, len, prot, flags, fd, off);
+  }
+  return map;
+}
+
+/**
+ * Control when open() fails.
+ *
+ * @param[in] path  File to open.
+ * @param[in] oflag Open flags.
+ * @param[in] ...   Permission bits if creating the file.
+ * @return          File descriptor, or -1 if error.
+ */
+int
+test_seam_open(const char *path,
+               int oflag, ...){
+  va_list ap;
+  mode_t mode;
+  int fd;
+
+  va_start(ap, oflag);
+  mode = (oflag & O_CREAT) ? (mode_t)va_arg(ap, int) : 0;
+  va_end(ap);
+  g_test_seam_syscall_ctr += 1;
+  if(test_seam_dec_err_ctr(&g_test_seam_err_ctr_open)){
+    errno = EACCES;
+    fd = -1;
   }
   else{
-    time_since_epoch = mktime(timeptr);
+    fd = open(path, oflag, mode);
   }
-  return time_since_epoch;
+  return fd;
 }
 
 /**
- * Control when setenv() fails.
+ * Count calls to openat().
  *
- * @param[in] envname   Environment variable name.
- * @param[in] envval    Set environment variable to this value.
- * @param[in] overwrite Overwrite the existing environment variable value.
- * @retval    0         Successfully set environment variable.
- * @retval    -1        Failed to set environment variable.
+ * @param[in] fd    Open @p path relative to this directory.
+ * @param[in] path  File to open.
+ * @param[in] oflag Open flags.
+ * @param[in] ...   Permission bits if creating the file.
+ * @return          File descriptor, or -1 if error.
  */
 int
-test_seam_setenv(const char *envname,
-                 const char *envval,
-                 int overwrite){
+test_seam_openat(int fd,
+                 const char *path,
+                 int oflag, ...){
+  va_list ap;
+  mode_t mode;
+
+  va_start(ap, oflag);
+  mode = (oflag & O_CREAT) ? (mode_t)va_arg(ap, int) : 0;
+  va_end(ap);
+  g_test_seam_syscall_ctr += 1;
+  return openat(fd, path, oflag, mode);
+}
+
+/**
+ * Control when pthread_create() fails.
+ *
+ * @param[out] thread        Thread ID.
+ * @param[in]  attr          Thread attributes.
+ * @param[in]  start_routine Thread entry point.
+ * @param[in]  arg           Argument passed to @p start_routine.
+ * @retval     0             Successfully created thread.
+ * @retval     EAGAIN        Failed to create thread.
+ */
+int
+test_seam_pthread_create(pthread_t *thread,
+                         const pthread_attr_t *attr,
+                         void *(*start_routine)(void *),
+                         void *arg){
   int rc;
 
-  if(test_seam_dec_err_ctr(&g_test_seam_err_ctr_setenv)){
-    errno = EINVAL;
-    rc = -1;
+  if(test_seam_dec_err_ctr(&g_test_seam_err_ctr_pthread_create)){
+    rc = EAGAIN;
   }
   else{
-    rc = setenv(envname, envval, overwrite);
+    rc = pthread_create(thread, attr, start_routine, arg);
   }
   return rc;
 }
 
+#ifdef STATX_MTIME
 /**
- * Convert a string to a double value.
+ * Control which fields statx() reports.
  *
- * @param[in]  nptr   String to convert to double.
- * @param[out] endptr Points to last character in @p nptr after parse.
- * @return            Double value or 0 if error (check errno).
+ * @param[in]  dirfd Directory file descriptor that @p path is relative to.
+ * @param[in]  path  Path to the file.
+ * @param[in]  flags AT_* flags.
+ * @param[in]  mask  STATX_* fields requested.
+ * @param[out] stx   File status.
+ * @retval     0     Successfully got the file status.
+ * @retval     -1    Failed to get the file status.
  */
-double
-test_seam_strtod(const char *nptr,
-                 char **endptr){
-  double d;
+int
+test_seam_statx(int dirfd,
+                const char *path,
+                int flags,
+                unsigned int mask,
+                struct statx *stx){
+  int rc;
 
-  if(test_seam_dec_err_ctr(&g_test_seam_err_ctr_strtod)){
-    errno = ERANGE;
-    d = 0;
+  g_test_seam_syscall_ctr += 1;
+  rc = statx(dirfd, path, flags, mask, stx);
+  if(rc == 0){
+    stx->stx_mask &= ~g_test_seam_statx_drop;
+  }
+  return rc;
+}
+#endif /* STATX_MTIME */
+
+/**
+ * Control when syncfs() fails.
+ *
+ * @param[in] fd File descriptor on the filesystem to flush.
+ * @retval    0  Successfully flushed the filesystem.
+ * @retval    -1 Failed to flush the filesystem.
+ */
+int
+test_seam_syncfs(int fd){
+  int rc;
+
+  g_test_seam_syscall_ctr += 1;
+  if(test_seam_dec_err_ctr(&g_test_seam_err_ctr_syncfs)){
+    errno = EIO;
+    rc = -1;
   }
   else{
-    d = strtod(nptr, endptr);
+    rc = syncfs(fd);
   }
-  return d;
+  return rc;
 }
 
 /**
- * Control when utimensat() fails.
+ * Control when utimensat() fails, and optionally make it slower.
  *
  * @param[in] fd    Change @p path relative to this directory.
  * @param[in] path  Change times on this file.
@@ -196,13 +430,20 @@ test_seam_utimensat(int fd,
                     const char *path,
                     const struct timespec times[2],
                     int flag){
+  struct timespec ts;
   int rc;
 
+  g_test_seam_syscall_ctr += 1;
   if(test_seam_dec_err_ctr(&g_test_seam_err_ctr_utimensat)){
     errno = EINVAL;
     rc = -1;
   }
   else{
+    if(g_test_seam_utimensat_delay_ns){
+      ts.tv_sec = 0;
+      ts.tv_nsec = (long)g_test_seam_utimensat_delay_ns;
+      nanosleep(&ts, NULL);
+    }
     rc = utimensat(fd, path, times, flag);
   }
   return rc;
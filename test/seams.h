@@ -14,42 +14,104 @@
  * Redefine these functions to internal test seams.
  */
 #undef clock_gettime
+#undef close
 #undef futimens
+#undef localtime_r
 #undef malloc
-#undef mktime
-#undef setenv
-#undef strtod
+#undef mmap
+#undef open
+#undef openat
+#undef pthread_create
+#undef statx
+#undef syncfs
 #undef utimensat
+#undef TOUCH_URING_ENTER
+
+/**
+ * Inject a test seam to replace close().
+ */
+#define close         test_seam_close
 
 /**
  * Inject a test seam to replace futimens().
  */
 #define futimens      test_seam_futimens
 
+/**
+ * Inject a test seam to replace localtime_r().
+ */
+#define localtime_r   test_seam_localtime_r
+
 /**
  * Inject a test seam to replace malloc().
  */
 #define malloc        test_seam_malloc
 
 /**
- * Inject a test seam to replace mktime().
+ * Inject a test seam to replace mmap().
+ */
+#define mmap          test_seam_mmap
+
+/**
+ * Inject a test seam to replace open().
  */
-#define mktime        test_seam_mktime
+#define open          test_seam_open
 
 /**
- * Inject a test seam to replace setenv().
+ * Inject a test seam to replace openat().
  */
-#define setenv        test_seam_setenv
+#define openat        test_seam_openat
 
 /**
- * Inject a test seam to replace strtod().
+ * Inject a test seam to replace pthread_create().
  */
-#define strtod        test_seam_strtod
+#define pthread_create test_seam_pthread_create
+
+/**
+ * Inject a test seam to replace statx(), leaving alone struct statx.
+ */
+#define statx(dirfd, path, flags, mask, stx) \
+  test_seam_statx(dirfd, path, flags, mask, stx)
+
+/**
+ * Inject a test seam to replace syncfs().
+ */
+#define syncfs        test_seam_syncfs
 
 /**
  * Inject a test seam to replace utimensat().
  */
 #define utimensat     test_seam_utimensat
 
+/**
+ * Inject a test seam to replace the io_uring_enter() system call.
+ */
+#define TOUCH_URING_ENTER test_seam_io_uring_enter
+
+/**
+ * Let the test suite turn off the apply kernels.
+ */
+#define TOUCH_APPLY_KERNELS (g_test_seam_apply_kernels)
+
+/**
+ * Let the test suite turn off the fixed-layout date time parser.
+ */
+#define TOUCH_DATE_TIME_FAST (g_test_seam_date_time_fast)
+
+/**
+ * Let the test suite shorten the interval between progress reports.
+ */
+#define TOUCH_PROGRESS_INTERVAL_NS (g_test_seam_progress_interval_ns)
+
+/**
+ * Let the test suite adjust the number of running workers after every call.
+ */
+#define TOUCH_LIMIT_WINDOW_NS (g_test_seam_limit_window_ns)
+
+/**
+ * Let the test suite save a checkpoint after every batch or record.
+ */
+#define TOUCH_CHECKPOINT_INTERVAL_NS (g_test_seam_checkpoint_interval_ns)
+
 #endif /* TOUCH_TEST_SEAMS_H */
 
@@ -6,7 +6,14 @@
  * This software has been placed into the public domain using CC0.
  */
 
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -31,6 +38,16 @@
  */
 #define PATH_REF_FILE "/etc/hosts"
 
+/**
+ * Path to a second file to touch when testing multiple files.
+ */
+#define PATH_TMP_FILE_2 "/tmp/test-touch-2.txt"
+
+/**
+ * Path to a list of files to touch (-f and --files0-from).
+ */
+#define PATH_TMP_LIST "/tmp/test-touch-list.txt"
+
 /**
  * Number of arguments in @ref g_argv.
  */
@@ -157,6 +174,99 @@ test_touch_main(const bool a,
   assert(rc == expect_exit_status);
 }
 
+/**
+ * Write data to a file, replacing any existing contents.
+ *
+ * @param[in] path Path to file.
+ * @param[in] data Data to write.
+ * @param[in] len  Number of bytes in @p data.
+ */
+static void
+test_write_file(const char *const path,
+                const char *const data,
+                const size_t len){
+  FILE *fp;
+
+  fp = fopen(path, "w");
+  assert(fp);
+  assert(fwrite(data, 1, len, fp) == len);
+  assert(fclose(fp) == 0);
+}
+
+/**
+ * Call @ref touch_main with a single list option.
+ *
+ * @param[in] list_arg           List option and argument, for example
+ *                               "-f" followed by a path or
+ *                               "--files0-from=path".
+ * @param[in] list_path          Path to list if @p list_arg does not include
+ *                               it, otherwise NULL.
+ * @param[in] expect_exit_status Expected exit code from @ref touch_main.
+ */
+static void
+test_touch_main_list(const char *const list_arg,
+                     const char *const list_path,
+                     const int expect_exit_status){
+  g_argc = 0;
+  strcpy(g_argv[g_argc++], "touch");
+  strcpy(g_argv[g_argc++], list_arg);
+  if(list_path){
+    strcpy(g_argv[g_argc++], list_path);
+  }
+  optind = 0;
+  assert(touch_main(g_argc, g_argv) == expect_exit_status);
+}
+
+/**
+ * Call @ref touch_main with an argument list.
+ *
+ * @param[in] expect_exit_status Expected exit code from @ref touch_main.
+ * @param[in] arg_list           Arguments following the program name.
+ *                               Terminate list using NULL.
+ */
+static void
+test_touch_main_args(const int expect_exit_status,
+                     const char *const arg_list, ...){
+  va_list ap;
+  const char *arg;
+
+  g_argc = 0;
+  strcpy(g_argv[g_argc++], "touch");
+  va_start(ap, arg_list);
+  for(arg = arg_list; arg; arg = va_arg(ap, const char *const)){
+    strcpy(g_argv[g_argc++], arg);
+  }
+  va_end(ap);
+  optind = 0;
+  assert(touch_main(g_argc, g_argv) == expect_exit_status);
+}
+
+/**
+ * Read an entire file into a NUL-terminated buffer.
+ *
+ * @param[in] path Path to file.
+ * @return         Allocated file contents, free with free().
+ */
+static char *
+test_read_file(const char *const path){
+  FILE *fp;
+  char *data;
+  long len;
+
+  fp = fopen(path, "r");
+  assert(fp);
+  assert(fseek(fp, 0, SEEK_END) == 0);
+  len = ftell(fp);
+  assert(len >= 0);
+  rewind(fp);
+  data = malloc((size_t)len + 1);
+  assert(data);
+  assert(fread(data, 1, (size_t)len, fp) == (size_t)len);
+  data[len] = '\0';
+  assert(fclose(fp) == 0);
+  return data;
+}
+
 /**
  * Run the touch command and return the time info of the touched file.
  *
@@ -252,6 +362,24 @@ test_touch_posix_examples(void){
   test_assert_tm(tm, 2007, 11, 12, 10, 15, 30);
   assert(tv_nsec == 2000000);
 
+  /* Fractional second exact to the nanosecond. */
+  test_touch_main_get_result(NULL,
+                             NULL,
+                             "2007-11-12T10:15:30.999999999Z",
+                             NULL,
+                             &tm,
+                             &tv_nsec);
+  assert(tv_nsec == 999999999);
+
+  /* Digits past nanoseconds get truncated. */
+  test_touch_main_get_result(NULL,
+                             NULL,
+                             "2007-11-12T10:15:30.123456789987654321Z",
+                             NULL,
+                             &tm,
+                             &tv_nsec);
+  assert(tv_nsec == 123456789);
+
   /* Time without second specifier. */
   test_touch_main_get_result(NULL,
                              "200711121015",
@@ -382,6 +510,47 @@ test_touch_ref_file_all(void){
                   NULL);
 }
 
+/**
+ * Check that the fixed-layout date time parser and strptime() convert a
+ * date time string to the same time.
+ *
+ * @param[in] date_time          See @ref TOUCH_FLAG_DATE_TIME.
+ * @param[in] expect_exit_status Expected exit code from @ref touch_main.
+ */
+static void
+test_touch_date_time_fast_check(const char *const date_time,
+                                const int expect_exit_status){
+  struct stat sb_fast;
+  struct stat sb_slow;
+
+  test_remove_tmp_file();
+  test_touch_main_args(expect_exit_status,
+                       "-d",
+                       date_time,
+                       PATH_TMP_FILE,
+                       NULL);
+  memset(&sb_fast, 0, sizeof(sb_fast));
+  if(expect_exit_status == EXIT_SUCCESS){
+    assert(stat(PATH_TMP_FILE, &sb_fast) == 0);
+  }
+  test_remove_tmp_file();
+  g_test_seam_date_time_fast = 0;
+  test_touch_main_args(expect_exit_status,
+                       "-d",
+                       date_time,
+                       PATH_TMP_FILE,
+                       NULL);
+  g_test_seam_date_time_fast = 1;
+  memset(&sb_slow, 0, sizeof(sb_slow));
+  if(expect_exit_status == EXIT_SUCCESS){
+    assert(stat(PATH_TMP_FILE, &sb_slow) == 0);
+  }
+  test_remove_tmp_file();
+  assert(memcmp(&sb_fast.st_mtim,
+                &sb_slow.st_mtim,
+                sizeof(sb_fast.st_mtim)) == 0);
+}
+
 /**
  * Test scenarios with [-d date_time].
  */
@@ -450,31 +619,31 @@ test_touch_date_time_all(void){
                   PATH_TMP_FILE,
                   NULL);
 
-  /* setenv: Failed to set TZ environment variable. */
-  g_test_seam_err_ctr_setenv = 0;
+  /* localtime_r: Failed to get the offset at the start of the interval. */
+  g_test_seam_err_ctr_localtime_r = 0;
   test_touch_main(false,
                   false,
                   false,
                   NULL,
                   NULL,
-                  "2007-11-12T10:15:30Z",
+                  "2007-11-12T10:15:30",
                   EXIT_FAILURE,
                   PATH_TMP_FILE,
                   NULL);
-  g_test_seam_err_ctr_setenv = -1;
 
-  /* mktime.*/
-  g_test_seam_err_ctr_mktime = 0;
+  /* localtime_r: Failed to get the offset at the end of the interval. */
+  g_test_seam_err_ctr_localtime_r = 1;
   test_touch_main(false,
                   false,
                   false,
                   NULL,
                   NULL,
-                  "2007-11-12T10:15:30Z",
+                  "2007-11-12T10:15:30",
                   EXIT_FAILURE,
                   PATH_TMP_FILE,
                   NULL);
-  g_test_seam_err_ctr_mktime = -1;
+
+  g_test_seam_err_ctr_localtime_r = -1;
 
   /* Invalid frac. */
   test_touch_main(false,
@@ -487,31 +656,110 @@ test_touch_date_time_all(void){
                   PATH_TMP_FILE,
                   NULL);
 
-  /* malloc: Failed to allocate frac_str. */
-  g_test_seam_err_ctr_malloc = 0;
+  /* Missing frac digits. */
   test_touch_main(false,
                   false,
                   false,
                   NULL,
                   NULL,
-                  "2007-11-12T10:15:30,002",
+                  "2007-11-12T10:15:30.Z",
                   EXIT_FAILURE,
                   PATH_TMP_FILE,
                   NULL);
-  g_test_seam_err_ctr_malloc = -1;
 
-  /* strtod: Failed to parse frac. */
-  g_test_seam_err_ctr_strtod = 0;
+  /* Too many frac digits. */
   test_touch_main(false,
                   false,
                   false,
                   NULL,
                   NULL,
-                  "2007-11-12T10:15:30,002",
+                  "2007-11-12T10:15:30.0000000000000000001",
                   EXIT_FAILURE,
                   PATH_TMP_FILE,
                   NULL);
-  g_test_seam_err_ctr_strtod = -1;
+
+  /* Both date time parsers must agree. */
+  test_touch_date_time_fast_check("2007-11-12T10:15:30", EXIT_SUCCESS);
+  test_touch_date_time_fast_check("2019-01-01 09:05:00Z", EXIT_SUCCESS);
+  test_touch_date_time_fast_check("2007-11-12T10:15:30,12345", EXIT_SUCCESS);
+  test_touch_date_time_fast_check("2000-02-29T23:59:59.1234567891Z",
+                                  EXIT_SUCCESS);
+  test_touch_date_time_fast_check("0000-01-01T00:00:00Z", EXIT_SUCCESS);
+  test_touch_date_time_fast_check("9999-12-31T23:59:59Z", EXIT_SUCCESS);
+
+  /* Irregular layouts that fall back to strptime(). */
+  test_touch_date_time_fast_check("2007-11-12T10:15:60Z", EXIT_SUCCESS);
+  test_touch_date_time_fast_check("2007-11-12T10:15: 1Z", EXIT_SUCCESS);
+  test_touch_date_time_fast_check("2007-13-12T10:15:30Z", EXIT_FAILURE);
+  test_touch_date_time_fast_check("2007-11-00T10:15:30Z", EXIT_FAILURE);
+  test_touch_date_time_fast_check("2007-11-12T24:15:30Z", EXIT_FAILURE);
+  test_touch_date_time_fast_check("2007-11-12T10:60:30Z", EXIT_FAILURE);
+  test_touch_date_time_fast_check("2007/11-12T10:15:30Z", EXIT_FAILURE);
+  test_touch_date_time_fast_check("2007-11-12T10:15:30+", EXIT_FAILURE);
+  test_touch_date_time_fast_check("2007-11-12T10:15:30.1a", EXIT_FAILURE);
+  test_touch_date_time_fast_check("2007-11-12T10:15:30ZZ", EXIT_FAILURE);
+}
+
+/**
+ * Convert a local date time in the current time zone and check the result.
+ *
+ * @param[in] date_time          See @ref TOUCH_FLAG_DATE_TIME.
+ * @param[in] localtime_r_ctr    Make localtime_r() fail after this many
+ *                               calls, or -1 to never fail.
+ * @param[in] expect_exit_status Expected exit code from @ref touch_main.
+ * @param[in] expect_sec         Expected seconds since the Epoch.
+ */
+static void
+test_touch_tz_check(const char *const date_time,
+                    const int localtime_r_ctr,
+                    const int expect_exit_status,
+                    const time_t expect_sec){
+  struct stat sb;
+
+  g_test_seam_err_ctr_localtime_r = localtime_r_ctr;
+  test_touch_main_args(expect_exit_status,
+                       "-d",
+                       date_time,
+                       PATH_TMP_FILE,
+                       NULL);
+  g_test_seam_err_ctr_localtime_r = -1;
+  if(expect_exit_status == EXIT_SUCCESS){
+    assert(stat(PATH_TMP_FILE, &sb) == 0);
+    assert(sb.st_mtim.tv_sec == expect_sec);
+  }
+  test_remove_tmp_file();
+}
+
+/**
+ * Test local time conversions in a time zone with daylight saving time.
+ */
+static void
+test_touch_tz_all(void){
+  /* Daylight saving time starts at 02:07 to test unaligned transitions. */
+  assert(setenv("TZ", "EST5EDT,M3.2.0/2:07,M11.1.0", 1) == 0);
+
+  /* Standard and daylight saving time. */
+  test_touch_tz_check("2019-01-01T12:00:00", -1, EXIT_SUCCESS, 1546362000);
+  test_touch_tz_check("2019-07-01T12:00:00", -1, EXIT_SUCCESS, 1561996800);
+  test_touch_tz_check("2019-07-01T12:00:00Z", -1, EXIT_SUCCESS, 1561982400);
+
+  /* Skipped local time moves forward. */
+  test_touch_tz_check("2019-03-10T02:30:00", -1, EXIT_SUCCESS, 1552203000);
+
+  /* Repeated local time uses the first occurrence. */
+  test_touch_tz_check("2019-11-03T01:30:00", -1, EXIT_SUCCESS, 1572759000);
+
+  /* Interval containing the transition gets converted exactly. */
+  test_touch_tz_check("2019-03-10T02:00:00", -1, EXIT_SUCCESS, 1552201200);
+  test_touch_tz_check("2019-03-10T02:00:00", 4, EXIT_FAILURE, 0);
+
+  /* localtime_r: Failed to check the offset after converting. */
+  test_touch_tz_check("2019-01-01T12:00:00", 2, EXIT_FAILURE, 0);
+
+  /* localtime_r: Failed to check the offset of a skipped local time. */
+  test_touch_tz_check("2019-03-10T02:30:00", 4, EXIT_FAILURE, 0);
+
+  assert(unsetenv("TZ") == 0);
 }
 
 /**
@@ -541,8 +789,8 @@ test_touch_time_all(void){
                   PATH_TMP_FILE,
                   NULL);
 
-  /* mktime.*/
-  g_test_seam_err_ctr_mktime = 0;
+  /* localtime_r: Failed to get the local time zone offset. */
+  g_test_seam_err_ctr_localtime_r = 0;
   test_touch_main(false,
                   false,
                   false,
@@ -552,7 +800,7 @@ test_touch_time_all(void){
                   EXIT_FAILURE,
                   PATH_TMP_FILE,
                   NULL);
-  g_test_seam_err_ctr_mktime = -1;
+  g_test_seam_err_ctr_localtime_r = -1;
 }
 
 /**
@@ -587,7 +835,6 @@ test_touch_directory(void){
  */
 static void
 test_touch_multi_files(void){
-  const char *const PATH_TMP_FILE_2 = "/tmp/test-touch-2.txt";
   struct stat sb_tmp_1;
   struct stat sb_tmp_2;
 
@@ -613,6 +860,2925 @@ test_touch_multi_files(void){
   assert(remove(PATH_TMP_FILE_2) == 0);
 }
 
+/**
+ * Update an existing file that has write permission but no read permission.
+ */
+static void
+test_touch_write_only_file(void){
+  struct stat sb;
+  int fd;
+  unsigned long syscall_ctr;
+
+  test_remove_tmp_file();
+  fd = creat(PATH_TMP_FILE, S_IWUSR);
+  assert(fd >= 0);
+  assert(close(fd) == 0);
+  syscall_ctr = g_test_seam_syscall_ctr;
+  test_touch_main(false,
+                  false,
+                  false,
+                  NULL,
+                  NULL,
+                  "2019-01-01T09:05:00",
+                  EXIT_SUCCESS,
+                  PATH_TMP_FILE,
+                  NULL);
+  assert(g_test_seam_syscall_ctr - syscall_ctr == 1);
+  assert(stat(PATH_TMP_FILE, &sb) == 0);
+  assert(memcmp(&sb.st_atim, &sb.st_mtim, sizeof(sb.st_atim)) == 0);
+  test_remove_tmp_file();
+}
+
+/**
+ * Check that both temporary files exist and then remove them.
+ */
+static void
+test_assert_remove_tmp_files(void){
+  assert(test_file_exists(PATH_TMP_FILE));
+  assert(test_file_exists(PATH_TMP_FILE_2));
+  test_remove_tmp_file();
+  assert(remove(PATH_TMP_FILE_2) == 0);
+}
+
+/**
+ * Test scenarios with [-f list] and [--files0-from=list].
+ */
+static void
+test_touch_list_all(void){
+  const char LIST_NL[] = PATH_TMP_FILE "\n\n" PATH_TMP_FILE_2;
+  const char LIST_NUL[] = PATH_TMP_FILE "\0" PATH_TMP_FILE_2 "\0";
+  const size_t LONG_PATH_LEN = (1 << 20) + 100;
+  char *list_long;
+  int fd_stdin;
+  int fd_list;
+
+  /* Newline-separated list without a trailing newline. */
+  test_write_file(PATH_TMP_LIST, LIST_NL, sizeof(LIST_NL) - 1);
+  test_touch_main_list("-f", PATH_TMP_LIST, EXIT_SUCCESS);
+  test_assert_remove_tmp_files();
+
+  /* NUL-separated list. */
+  test_write_file(PATH_TMP_LIST, LIST_NUL, sizeof(LIST_NUL) - 1);
+  test_touch_main_list("--files0-from=" PATH_TMP_LIST, NULL, EXIT_SUCCESS);
+  test_assert_remove_tmp_files();
+
+  /* Read list from STDIN. */
+  fd_stdin = dup(STDIN_FILENO);
+  assert(fd_stdin >= 0);
+  fd_list = open(PATH_TMP_LIST, O_RDONLY);
+  assert(fd_list >= 0);
+  assert(dup2(fd_list, STDIN_FILENO) == STDIN_FILENO);
+  assert(close(fd_list) == 0);
+  test_touch_main_list("--files0-from=-", NULL, EXIT_SUCCESS);
+  assert(dup2(fd_stdin, STDIN_FILENO) == STDIN_FILENO);
+  assert(close(fd_stdin) == 0);
+  test_assert_remove_tmp_files();
+
+  /* Path in list too long, continue with the next path. */
+  list_long = malloc(LONG_PATH_LEN + sizeof(PATH_TMP_FILE));
+  assert(list_long);
+  memset(list_long, 'a', LONG_PATH_LEN);
+  list_long[LONG_PATH_LEN - 1] = '\n';
+  memcpy(&list_long[LONG_PATH_LEN], PATH_TMP_FILE, sizeof(PATH_TMP_FILE));
+  test_write_file(PATH_TMP_LIST,
+                  list_long,
+                  LONG_PATH_LEN + sizeof(PATH_TMP_FILE) - 1);
+  free(list_long);
+  test_touch_main_list("-f", PATH_TMP_LIST, EXIT_FAILURE);
+  assert(test_file_exists(PATH_TMP_FILE));
+  test_remove_tmp_file();
+
+  /* mmap: Read the list with a path too long instead of mapping it. */
+  g_test_seam_err_ctr_mmap = 0;
+  test_touch_main_list("-f", PATH_TMP_LIST, EXIT_FAILURE);
+  g_test_seam_err_ctr_mmap = -1;
+  assert(test_file_exists(PATH_TMP_FILE));
+  test_remove_tmp_file();
+
+  /* malloc: Failed to allocate list buffer. */
+  g_test_seam_err_ctr_malloc = 2;
+  test_touch_main_list("-f", PATH_TMP_LIST, EXIT_FAILURE);
+  g_test_seam_err_ctr_malloc = -1;
+  assert(test_file_exists(PATH_TMP_FILE) == false);
+  assert(remove(PATH_TMP_LIST) == 0);
+
+  /* List does not exist. */
+  test_touch_main_list("-f", PATH_NOEXIST, EXIT_FAILURE);
+
+  /* read: List is a directory. */
+  test_touch_main_list("-f", "/tmp", EXIT_FAILURE);
+}
+
+/**
+ * Check the modification year of a file without following symbolic links.
+ *
+ * @param[in] path        File path.
+ * @param[in] expect_year Expected modification year.
+ */
+static void
+test_assert_mtime_year(const char *const path,
+                       const int expect_year){
+  struct stat sb;
+  struct tm *tm;
+
+  assert(lstat(path, &sb) == 0);
+  tm = localtime(&sb.st_mtim.tv_sec);
+  assert(tm);
+  assert(tm->tm_year + 1900 == expect_year);
+}
+
+/**
+ * Test reading large lists mapped into memory.
+ */
+static void
+test_touch_list_map_all(void){
+  const char LINE[] = PATH_TMP_FILE "\n";
+  const size_t LIST_LEN = 2 << 20;
+  const size_t LINE_LEN = sizeof(LINE) - 1;
+  const size_t LAST_LEN = sizeof(PATH_TMP_FILE_2) - 1;
+  char *list;
+  size_t pad;
+  size_t i;
+
+  /*
+   * Size the list to a multiple of the page size, ending in a path with no
+   * delimiter, with paths crossing each window boundary.
+   */
+  list = malloc(LIST_LEN);
+  assert(list);
+  pad = (LIST_LEN - LAST_LEN) % LINE_LEN;
+  memset(list, '/', pad);
+  for(i = pad; i < LIST_LEN - LAST_LEN; i += LINE_LEN){
+    memcpy(&list[i], LINE, LINE_LEN);
+  }
+  memcpy(&list[LIST_LEN - LAST_LEN], PATH_TMP_FILE_2, LAST_LEN);
+  test_write_file(PATH_TMP_LIST, list, LIST_LEN);
+  free(list);
+
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-d",
+                       "2019-01-01T09:05:00",
+                       "-f",
+                       PATH_TMP_LIST,
+                       NULL);
+  test_assert_mtime_year(PATH_TMP_FILE, 2019);
+  test_assert_mtime_year(PATH_TMP_FILE_2, 2019);
+
+  /* Hand the mapped paths to the workers. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-j",
+                       "3",
+                       "-d",
+                       "2018-01-01T09:05:00",
+                       "-f",
+                       PATH_TMP_LIST,
+                       NULL);
+  test_assert_mtime_year(PATH_TMP_FILE, 2018);
+  test_assert_mtime_year(PATH_TMP_FILE_2, 2018);
+
+  /* mmap: Read the list instead if either mapping fails. */
+  for(i = 0; i < 2; i++){
+    g_test_seam_err_ctr_mmap = (int)i;
+    test_touch_main_args(EXIT_SUCCESS,
+                         "-d",
+                         "2017-01-01T09:05:00",
+                         "-f",
+                         PATH_TMP_LIST,
+                         NULL);
+    g_test_seam_err_ctr_mmap = -1;
+    test_assert_mtime_year(PATH_TMP_FILE, 2017);
+    test_assert_mtime_year(PATH_TMP_FILE_2, 2017);
+  }
+  test_assert_remove_tmp_files();
+  assert(remove(PATH_TMP_LIST) == 0);
+}
+
+/**
+ * Test scenarios with [-j jobs].
+ */
+static void
+test_touch_jobs_all(void){
+  const char *const PATH_TMP_STDERR = "/tmp/test-touch-stderr.txt";
+  const char LIST_NUL[] = PATH_TMP_FILE "\0" PATH_TMP_FILE_2 "\0";
+  char *err_out;
+  char *err_1;
+  char *err_2;
+  char *err_3;
+  int fd_stderr;
+  int fd_err;
+
+  /* Touch files using multiple workers. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-j",
+                       "4",
+                       PATH_TMP_FILE,
+                       PATH_TMP_FILE_2,
+                       NULL);
+  test_assert_remove_tmp_files();
+
+  /* Touch files from a list using multiple workers. */
+  test_write_file(PATH_TMP_LIST, LIST_NUL, sizeof(LIST_NUL) - 1);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-j",
+                       "2",
+                       "--files0-from=" PATH_TMP_LIST,
+                       NULL);
+  test_assert_remove_tmp_files();
+  assert(remove(PATH_TMP_LIST) == 0);
+
+  /* Errors from workers get printed in path order. */
+  fd_stderr = dup(STDERR_FILENO);
+  assert(fd_stderr >= 0);
+  fd_err = open(PATH_TMP_STDERR, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
+  assert(fd_err >= 0);
+  assert(dup2(fd_err, STDERR_FILENO) == STDERR_FILENO);
+  assert(close(fd_err) == 0);
+  test_touch_main_args(EXIT_FAILURE,
+                       "-j",
+                       "3",
+                       "/noexist-1.txt",
+                       PATH_TMP_FILE,
+                       "/noexist-2.txt",
+                       PATH_TMP_FILE_2,
+                       "/noexist-3.txt",
+                       NULL);
+  assert(dup2(fd_stderr, STDERR_FILENO) == STDERR_FILENO);
+  assert(close(fd_stderr) == 0);
+  test_assert_remove_tmp_files();
+  err_out = test_read_file(PATH_TMP_STDERR);
+  assert(remove(PATH_TMP_STDERR) == 0);
+  err_1 = strstr(err_out, "creat: /noexist-1.txt: Permission denied\n");
+  err_2 = strstr(err_out, "creat: /noexist-2.txt: Permission denied\n");
+  err_3 = strstr(err_out, "creat: /noexist-3.txt: Permission denied\n");
+  assert(err_1 && err_2 && err_3);
+  assert(err_1 < err_2 && err_2 < err_3);
+  free(err_out);
+
+  /* Touch all files even if the worker threads fail to start. */
+  g_test_seam_err_ctr_pthread_create = 0;
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-j",
+                       "2",
+                       PATH_TMP_FILE,
+                       PATH_TMP_FILE_2,
+                       NULL);
+  g_test_seam_err_ctr_pthread_create = -1;
+  test_assert_remove_tmp_files();
+
+  /* malloc: Fall back to touching files without workers. */
+  g_test_seam_err_ctr_malloc = 2;
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-j",
+                       "2",
+                       PATH_TMP_FILE,
+                       PATH_TMP_FILE_2,
+                       NULL);
+  g_test_seam_err_ctr_malloc = -1;
+  test_assert_remove_tmp_files();
+
+  /* Invalid number of jobs. */
+  test_touch_main_args(EXIT_FAILURE, "-j", "0", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE, "-j", "1025", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE, "-j", "a", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE, "-j", "2a", PATH_TMP_FILE, NULL);
+  assert(test_file_exists(PATH_TMP_FILE) == false);
+}
+
+/**
+ * Test scenarios with [--io-uring].
+ */
+static void
+test_touch_io_uring_all(void){
+  const char LIST_NUL[] = PATH_TMP_FILE "\0" PATH_TMP_FILE_2 "\0";
+  struct stat sb;
+  struct tm *tm;
+
+  /* Create files. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--io-uring",
+                       PATH_TMP_FILE,
+                       PATH_TMP_FILE_2,
+                       NULL);
+
+  /* Update existing files. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--io-uring",
+                       "-c",
+                       PATH_TMP_FILE,
+                       PATH_TMP_FILE_2,
+                       NULL);
+  test_assert_remove_tmp_files();
+
+  /* Do not create files. */
+  test_touch_main_args(EXIT_SUCCESS, "--io-uring", "-c", PATH_TMP_FILE, NULL);
+  assert(test_file_exists(PATH_TMP_FILE) == false);
+
+  /* Create files that need explicit times. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--io-uring",
+                       "-d",
+                       "2019-01-01T09:05:00",
+                       PATH_TMP_FILE,
+                       PATH_TMP_FILE_2,
+                       NULL);
+  assert(stat(PATH_TMP_FILE_2, &sb) == 0);
+  assert(memcmp(&sb.st_atim, &sb.st_mtim, sizeof(sb.st_atim)) == 0);
+  tm = localtime(&sb.st_mtim.tv_sec);
+  assert(tm);
+  test_assert_tm(tm, 2019, 1, 1, 9, 5, 0);
+  test_assert_remove_tmp_files();
+
+  /* Create files from a list. */
+  test_write_file(PATH_TMP_LIST, LIST_NUL, sizeof(LIST_NUL) - 1);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--io-uring",
+                       "--files0-from=" PATH_TMP_LIST,
+                       NULL);
+  test_assert_remove_tmp_files();
+  assert(remove(PATH_TMP_LIST) == 0);
+
+  /* Unable to create or update files. */
+  test_touch_main_args(EXIT_FAILURE,
+                       "--io-uring",
+                       PATH_NOEXIST,
+                       "/etc/hosts",
+                       PATH_TMP_FILE,
+                       NULL);
+  assert(test_file_exists(PATH_TMP_FILE));
+  test_remove_tmp_file();
+
+  /* Fail to update file after creating it - futimens. */
+  g_test_seam_err_ctr_futimens = 0;
+  test_touch_main_args(EXIT_FAILURE,
+                       "--io-uring",
+                       "-d",
+                       "2019-01-01T09:05:00",
+                       PATH_TMP_FILE,
+                       NULL);
+  g_test_seam_err_ctr_futimens = -1;
+  test_remove_tmp_file();
+}
+
+/**
+ * Touch files in the same directories to use the directory cache.
+ */
+static void
+test_touch_dircache_all(void){
+  const char *const PATH_TMP_DIR = "/tmp/test-touch-dircache";
+  const unsigned int NUM_DIRS = 18;
+  char path[100];
+  char *list;
+  char *list_append;
+  unsigned long syscall_ctr;
+  unsigned int i;
+
+  assert(mkdir(PATH_TMP_DIR, S_IRWXU) == 0);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "/tmp/test-touch-dircache/1",
+                       "/tmp/test-touch-dircache/2",
+                       "/tmp/test-touch-dircache/3",
+                       "/tmp/test-touch-dircache/4",
+                       NULL);
+
+  /* Open the directory on the second file, then reuse it. */
+  syscall_ctr = g_test_seam_syscall_ctr;
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-c",
+                       "/tmp/test-touch-dircache/1",
+                       "/tmp/test-touch-dircache/2",
+                       "/tmp/test-touch-dircache/3",
+                       "/tmp/test-touch-dircache/4",
+                       NULL);
+  assert(g_test_seam_syscall_ctr - syscall_ctr == 6);
+
+  /* open: Fall back to using the full path. */
+  g_test_seam_err_ctr_open = 0;
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-c",
+                       "/tmp/test-touch-dircache/1",
+                       "/tmp/test-touch-dircache/2",
+                       "/tmp/test-touch-dircache/3",
+                       NULL);
+  g_test_seam_err_ctr_open = -1;
+  for(i = 1; i <= 4; i++){
+    sprintf(path, "%s/%u", PATH_TMP_DIR, i);
+    assert(remove(path) == 0);
+  }
+
+  /* Replace the least recently used directories. */
+  list = malloc(NUM_DIRS * 2 * sizeof(path));
+  assert(list);
+  list_append = list;
+  for(i = 0; i < NUM_DIRS; i++){
+    sprintf(path, "%s/%u", PATH_TMP_DIR, i);
+    assert(mkdir(path, S_IRWXU) == 0);
+    list_append += sprintf(list_append, "%s/a\n%s/b\n", path, path);
+  }
+  test_write_file(PATH_TMP_LIST, list, (size_t)(list_append - list));
+  free(list);
+  test_touch_main_args(EXIT_SUCCESS, "-f", PATH_TMP_LIST, NULL);
+  assert(remove(PATH_TMP_LIST) == 0);
+  for(i = 0; i < NUM_DIRS; i++){
+    sprintf(path, "%s/%u/a", PATH_TMP_DIR, i);
+    assert(remove(path) == 0);
+    sprintf(path, "%s/%u/b", PATH_TMP_DIR, i);
+    assert(remove(path) == 0);
+    sprintf(path, "%s/%u", PATH_TMP_DIR, i);
+    assert(rmdir(path) == 0);
+  }
+  assert(rmdir(PATH_TMP_DIR) == 0);
+}
+
+/**
+ * Test scenarios with [-R].
+ */
+static void
+test_touch_recursive_all(void){
+  const char *const TREE_DIRS[] = {
+    "/tmp/test-touch-tree",
+    "/tmp/test-touch-tree/a",
+    "/tmp/test-touch-tree/b",
+    "/tmp/test-touch-tree/b/c"
+  };
+  const char *const TREE_FILES[] = {
+    "/tmp/test-touch-tree/a/1",
+    "/tmp/test-touch-tree/a/2",
+    "/tmp/test-touch-tree/b/c/3",
+    "/tmp/test-touch-tree/l"
+  };
+  const size_t NUM_TREE = sizeof(TREE_DIRS) / sizeof(TREE_DIRS[0]);
+  struct stat sb_ref;
+  struct stat sb_ref_after;
+  size_t i;
+
+  assert(stat(PATH_REF_FILE, &sb_ref) == 0);
+  for(i = 0; i < NUM_TREE; i++){
+    assert(mkdir(TREE_DIRS[i], S_IRWXU) == 0);
+  }
+  test_touch_main_args(EXIT_SUCCESS,
+                       TREE_FILES[0],
+                       TREE_FILES[1],
+                       TREE_FILES[2],
+                       NULL);
+  assert(symlink(PATH_REF_FILE, TREE_FILES[3]) == 0);
+
+  /* Touch the whole tree without following the symbolic link. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-R",
+                       "-d",
+                       "2019-01-01T09:05:00",
+                       "/tmp/test-touch-tree/",
+                       NULL);
+  for(i = 0; i < NUM_TREE; i++){
+    test_assert_mtime_year(TREE_DIRS[i], 2019);
+    test_assert_mtime_year(TREE_FILES[i], 2019);
+  }
+  assert(stat(PATH_REF_FILE, &sb_ref_after) == 0);
+  assert(memcmp(&sb_ref.st_mtim,
+                &sb_ref_after.st_mtim,
+                sizeof(sb_ref.st_mtim)) == 0);
+
+  /* Walk the subdirectories using worker threads. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-R",
+                       "-j",
+                       "2",
+                       "-d",
+                       "2018-01-01T09:05:00",
+                       TREE_DIRS[0],
+                       NULL);
+  for(i = 0; i < NUM_TREE; i++){
+    test_assert_mtime_year(TREE_DIRS[i], 2018);
+    test_assert_mtime_year(TREE_FILES[i], 2018);
+  }
+
+  /* Operands that are not directories. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-R",
+                       "-d",
+                       "2017-01-01T09:05:00",
+                       TREE_FILES[0],
+                       NULL);
+  test_assert_mtime_year(TREE_FILES[0], 2017);
+  test_assert_mtime_year(TREE_FILES[1], 2018);
+
+  /* open: Unable to read subdirectory. */
+  assert(chmod(TREE_DIRS[2], S_IWUSR | S_IXUSR) == 0);
+  test_touch_main_args(EXIT_FAILURE, "-R", TREE_DIRS[0], NULL);
+  test_touch_main_args(EXIT_FAILURE, "-R", "-j", "2", TREE_DIRS[0], NULL);
+  test_touch_main_args(EXIT_FAILURE, "-R", TREE_DIRS[2], NULL);
+  assert(chmod(TREE_DIRS[2], S_IRWXU) == 0);
+
+  for(i = 0; i < NUM_TREE; i++){
+    assert(remove(TREE_FILES[i]) == 0);
+  }
+  for(i = NUM_TREE; i-- > 0;){
+    assert(rmdir(TREE_DIRS[i]) == 0);
+  }
+}
+
+/**
+ * Test scenarios with [--ref-root=dir] and [--target-root=dir].
+ */
+static void
+test_touch_ref_root_all(void){
+  const char *const TREE_DIRS[] = {
+    "/tmp/test-touch-src",
+    "/tmp/test-touch-src/a",
+    "/tmp/test-touch-dst",
+    "/tmp/test-touch-dst/a"
+  };
+  const char *const TREE_FILES[] = {
+    "/tmp/test-touch-src/1",
+    "/tmp/test-touch-src/a/2",
+    "/tmp/test-touch-dst/1",
+    "/tmp/test-touch-dst/a/2",
+    "/tmp/test-touch-dst/a/3"
+  };
+  const size_t NUM_DIRS = sizeof(TREE_DIRS) / sizeof(TREE_DIRS[0]);
+  const size_t NUM_FILES = sizeof(TREE_FILES) / sizeof(TREE_FILES[0]);
+  struct touch_ctx *ctx;
+  size_t i;
+
+  for(i = 0; i < NUM_DIRS; i++){
+    assert(mkdir(TREE_DIRS[i], S_IRWXU) == 0);
+  }
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-d",
+                       "2017-01-01T09:05:00",
+                       TREE_FILES[0],
+                       NULL);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-d",
+                       "2016-01-01T09:05:00",
+                       TREE_FILES[1],
+                       TREE_DIRS[1],
+                       NULL);
+
+  /* Map each target under the target root to the reference root. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--ref-root=/tmp/test-touch-src/",
+                       "--target-root=/tmp/test-touch-dst/",
+                       TREE_FILES[2],
+                       TREE_FILES[3],
+                       NULL);
+  test_assert_mtime_year(TREE_FILES[2], 2017);
+  test_assert_mtime_year(TREE_FILES[3], 2016);
+
+  /* Only the modification times using worker threads. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-d",
+                       "2015-01-01T09:05:00",
+                       TREE_FILES[0],
+                       TREE_FILES[1],
+                       NULL);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-m",
+                       "-j",
+                       "2",
+                       "--ref-root=/tmp/test-touch-src",
+                       "--target-root=/tmp/test-touch-dst",
+                       TREE_FILES[2],
+                       TREE_FILES[3],
+                       NULL);
+  test_assert_mtime_year(TREE_FILES[2], 2015);
+  test_assert_mtime_year(TREE_FILES[3], 2015);
+
+  /* Append relative targets to the reference root. */
+  assert(chdir(TREE_DIRS[2]) == 0);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-d",
+                       "2014-01-01T09:05:00",
+                       TREE_FILES[0],
+                       NULL);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--ref-root=/tmp/test-touch-src",
+                       "./1",
+                       NULL);
+  test_assert_mtime_year(TREE_FILES[2], 2014);
+
+  /* Walk a tree skipping the entries without a reference file. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-d",
+                       "2013-01-01T09:05:00",
+                       TREE_FILES[4],
+                       NULL);
+  test_touch_main_args(EXIT_FAILURE,
+                       "-R",
+                       "--ref-root=/tmp/test-touch-src",
+                       "a",
+                       NULL);
+  test_assert_mtime_year(TREE_DIRS[3], 2016);
+  test_assert_mtime_year(TREE_FILES[3], 2015);
+  test_assert_mtime_year(TREE_FILES[4], 2013);
+
+  /* Library interface. */
+  ctx = touch_ctx_new(TOUCH_FLAG_REF_ROOT, "/tmp/test-touch-src");
+  assert(ctx);
+  assert(touch_ctx_apply(ctx, "a/2") == EXIT_SUCCESS);
+  assert(touch_ctx_apply(ctx, "a/3") == EXIT_FAILURE);
+  touch_ctx_free(ctx);
+  assert(touch_ctx_new(TOUCH_FLAG_REF_ROOT, NULL) == NULL);
+  assert(chdir("/") == 0);
+
+  /* Targets without a reference file do not get created. */
+  assert(remove(TREE_FILES[4]) == 0);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--ref-root=/tmp/test-touch-src",
+                       "--target-root=/tmp/test-touch-dst",
+                       TREE_FILES[4],
+                       NULL);
+  assert(!test_file_exists(TREE_FILES[4]));
+
+  /* Targets outside of the target root. */
+  test_touch_main_args(EXIT_FAILURE,
+                       "--ref-root=/tmp/test-touch-src",
+                       "--target-root=/tmp/test-touch-dst/a",
+                       TREE_FILES[2],
+                       NULL);
+
+  test_touch_main_args(EXIT_FAILURE,
+                       "--ref-root=/tmp/test-touch-src",
+                       "--target-root=/",
+                       "1",
+                       NULL);
+
+  /* A target root of "/" holds every absolute target. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--ref-root=/",
+                       "--target-root=/",
+                       TREE_FILES[2],
+                       NULL);
+  test_assert_mtime_year(TREE_FILES[2], 2014);
+
+  /* Invalid combinations of arguments. */
+  test_touch_main_args(EXIT_FAILURE,
+                       "--ref-root=/tmp/test-touch-src",
+                       "-r",
+                       PATH_REF_FILE,
+                       TREE_FILES[2],
+                       NULL);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--ref-root=/tmp/test-touch-src",
+                       "--manifest=" PATH_TMP_LIST,
+                       NULL);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--target-root=/tmp/test-touch-dst",
+                       TREE_FILES[2],
+                       NULL);
+
+  for(i = 0; i < NUM_FILES - 1; i++){
+    assert(remove(TREE_FILES[i]) == 0);
+  }
+  for(i = NUM_DIRS; i-- > 0;){
+    assert(rmdir(TREE_DIRS[i]) == 0);
+  }
+}
+
+/**
+ * Test scenarios with [--if-changed] and [--forward-only].
+ */
+static void
+test_touch_if_changed_all(void){
+  struct stat sb;
+  struct stat sb_after;
+
+  /* Missing files still get created. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--if-changed",
+                       "-d",
+                       "2019-01-01T09:05:00",
+                       PATH_TMP_FILE,
+                       NULL);
+  test_assert_mtime_year(PATH_TMP_FILE, 2019);
+
+  /* Files that already have the times do not get updated. */
+  assert(stat(PATH_TMP_FILE, &sb) == 0);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--if-changed",
+                       "-d",
+                       "2019-01-01T09:05:00",
+                       PATH_TMP_FILE,
+                       NULL);
+  assert(stat(PATH_TMP_FILE, &sb_after) == 0);
+  assert(memcmp(&sb.st_ctim, &sb_after.st_ctim, sizeof(sb.st_ctim)) == 0);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--if-changed",
+                       "-d",
+                       "2018-01-01T09:05:00",
+                       PATH_TMP_FILE,
+                       NULL);
+  test_assert_mtime_year(PATH_TMP_FILE, 2018);
+
+  /* Only move each time forward. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--forward-only",
+                       "-d",
+                       "2017-01-01T09:05:00",
+                       PATH_TMP_FILE,
+                       NULL);
+  test_assert_mtime_year(PATH_TMP_FILE, 2018);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-a",
+                       "-d",
+                       "2021-01-01T09:05:00",
+                       PATH_TMP_FILE,
+                       NULL);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--forward-only",
+                       "-d",
+                       "2020-01-01T09:05:00",
+                       PATH_TMP_FILE,
+                       NULL);
+  assert(stat(PATH_TMP_FILE, &sb) == 0);
+  test_assert_mtime_year(PATH_TMP_FILE, 2020);
+  assert(sb.st_atim.tv_sec > sb.st_mtim.tv_sec);
+
+  /* Current time compared against a time in the future. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-d",
+                       "2100-01-01T09:05:00",
+                       PATH_TMP_FILE,
+                       NULL);
+  test_touch_main_args(EXIT_SUCCESS, "--forward-only", PATH_TMP_FILE, NULL);
+  test_assert_mtime_year(PATH_TMP_FILE, 2100);
+  test_touch_main_args(EXIT_SUCCESS, "--if-changed", PATH_TMP_FILE, NULL);
+  assert(stat(PATH_TMP_FILE, &sb) == 0);
+  assert(sb.st_mtim.tv_sec < 4102477500);
+
+#ifdef STATX_MTIME
+  /* Times the filesystem does not report always get set. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-d",
+                       "2016-06-01T09:05:00",
+                       PATH_TMP_FILE,
+                       NULL);
+  g_test_seam_statx_drop = STATX_MTIME;
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--forward-only",
+                       "-d",
+                       "2015-06-01T09:05:00",
+                       PATH_TMP_FILE,
+                       NULL);
+  g_test_seam_statx_drop = 0;
+  assert(stat(PATH_TMP_FILE, &sb) == 0);
+  test_assert_mtime_year(PATH_TMP_FILE, 2015);
+  assert(sb.st_atim.tv_sec > sb.st_mtim.tv_sec);
+#endif /* STATX_MTIME */
+
+  /* Failed to check the times. */
+  assert(mkdir("/tmp/test-touch-dir", S_IWUSR) == 0);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--if-changed",
+                       "/tmp/test-touch-dir/file",
+                       NULL);
+  assert(rmdir("/tmp/test-touch-dir") == 0);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--forward-only",
+                       "-d",
+                       "2100-01-01T09:05:00",
+                       PATH_REF_FILE,
+                       NULL);
+  test_remove_tmp_file();
+}
+
+/**
+ * Call @ref touch_main with an argument list and capture the output written
+ * to a file descriptor.
+ *
+ * @param[in] fd                 STDOUT_FILENO or STDERR_FILENO.
+ * @param[in] expect_exit_status Expected exit code from @ref touch_main.
+ * @param[in] arg_list           Arguments following the program name.
+ * @param[in] ap                 Remaining arguments, terminated by NULL.
+ * @return                       Allocated output, free with free().
+ */
+static char *
+test_touch_main_output(const int fd,
+                       const int expect_exit_status,
+                       const char *const arg_list,
+                       va_list ap){
+  const char *const PATH_TMP_OUTPUT = "/tmp/test-touch-output.txt";
+  const char *arg;
+  char *out;
+  int fd_saved;
+  int fd_out;
+
+  fflush(stdout);
+  fd_saved = dup(fd);
+  assert(fd_saved >= 0);
+  fd_out = open(PATH_TMP_OUTPUT, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
+  assert(fd_out >= 0);
+  assert(dup2(fd_out, fd) == fd);
+  assert(close(fd_out) == 0);
+  g_argc = 0;
+  strcpy(g_argv[g_argc++], "touch");
+  for(arg = arg_list; arg; arg = va_arg(ap, const char *const)){
+    strcpy(g_argv[g_argc++], arg);
+  }
+  optind = 0;
+  assert(touch_main(g_argc, g_argv) == expect_exit_status);
+  fflush(stdout);
+  assert(dup2(fd_saved, fd) == fd);
+  assert(close(fd_saved) == 0);
+  out = test_read_file(PATH_TMP_OUTPUT);
+  assert(remove(PATH_TMP_OUTPUT) == 0);
+  return out;
+}
+
+/**
+ * Call @ref touch_main with an argument list and capture STDERR.
+ *
+ * @param[in] expect_exit_status Expected exit code from @ref touch_main.
+ * @param[in] arg_list           Arguments following the program name.
+ *                               Terminate list using NULL.
+ * @return                       Allocated STDERR output, free with free().
+ */
+static char *
+test_touch_main_stderr(const int expect_exit_status,
+                       const char *const arg_list, ...){
+  va_list ap;
+  char *err_out;
+
+  va_start(ap, arg_list);
+  err_out = test_touch_main_output(STDERR_FILENO,
+                                   expect_exit_status,
+                                   arg_list,
+                                   ap);
+  va_end(ap);
+  return err_out;
+}
+
+/**
+ * Call @ref touch_main with an argument list and capture STDOUT.
+ *
+ * @param[in] expect_exit_status Expected exit code from @ref touch_main.
+ * @param[in] arg_list           Arguments following the program name.
+ *                               Terminate list using NULL.
+ * @return                       Allocated STDOUT output, free with free().
+ */
+static char *
+test_touch_main_stdout(const int expect_exit_status,
+                       const char *const arg_list, ...){
+  va_list ap;
+  char *out;
+
+  va_start(ap, arg_list);
+  out = test_touch_main_output(STDOUT_FILENO,
+                               expect_exit_status,
+                               arg_list,
+                               ap);
+  va_end(ap);
+  return out;
+}
+
+/**
+ * Test falling back to the POSIX calls when io_uring_enter fails while
+ * opening the new files or closing them [--io-uring].
+ */
+static void
+test_touch_io_uring_fail_all(void){
+  char *err_out;
+  char *err;
+  int fd_before;
+  int fd_after;
+  int i;
+
+  for(i = 0; i < 2; i++){
+    fd_before = open("/dev/null", O_RDONLY);
+    assert(fd_before >= 0);
+    assert(close(fd_before) == 0);
+    g_test_seam_err_ctr_io_uring_enter = i;
+    err_out = test_touch_main_stderr(EXIT_FAILURE,
+                                     "--io-uring",
+                                     "--stats",
+                                     "-d",
+                                     "2019-01-01T09:05:00",
+                                     PATH_NOEXIST,
+                                     PATH_TMP_FILE,
+                                     NULL);
+    g_test_seam_err_ctr_io_uring_enter = -1;
+    fd_after = open("/dev/null", O_RDONLY);
+    assert(fd_after == fd_before);
+    assert(close(fd_after) == 0);
+    err = strstr(err_out, "creat: " PATH_NOEXIST ": ");
+    assert(err);
+    assert(strstr(err + 1, "creat: ") == NULL);
+    assert(strstr(err_out, "io_uring_enter: "));
+    assert(strstr(err_out, "\"creats\":1,"));
+    assert(strstr(err_out, "\"errors\":2,"));
+    free(err_out);
+    test_assert_mtime_year(PATH_TMP_FILE, 2019);
+    test_remove_tmp_file();
+  }
+}
+
+/**
+ * Count the number of lines in a string.
+ *
+ * @param[in] str String with lines ending in newlines.
+ * @return        Number of newlines in @p str.
+ */
+static size_t
+test_count_lines(const char *str){
+  size_t lines;
+
+  for(lines = 0; (str = strchr(str, '\n')) != NULL; str++){
+    lines += 1;
+  }
+  return lines;
+}
+
+/**
+ * Test scenarios with [--max-errors=num] and [--collapse-errors].
+ */
+static void
+test_touch_errlog_all(void){
+  const char *const prog = program_invocation_short_name;
+  const size_t NUM_LONG = 2000;
+  char expect[300];
+  char *err_out;
+  char *list;
+  size_t list_len;
+  size_t i;
+
+  /* All messages get buffered and printed in order. */
+  err_out = test_touch_main_stderr(EXIT_FAILURE,
+                                   PATH_NOEXIST,
+                                   "/etc/hosts",
+                                   "/noexist.2",
+                                   NULL);
+  sprintf(expect,
+          "%s: creat: %s: %s\n"
+          "%s: utimensat on: /etc/hosts: %s\n"
+          "%s: creat: /noexist.2: %s\n",
+          prog, PATH_NOEXIST, strerror(EACCES),
+          prog, strerror(EACCES),
+          prog, strerror(EACCES));
+  assert(strcmp(err_out, expect) == 0);
+  free(err_out);
+
+  /* Only print the first message. */
+  err_out = test_touch_main_stderr(EXIT_FAILURE,
+                                   "--max-errors=1",
+                                   "/etc/hosts",
+                                   PATH_NOEXIST,
+                                   "/noexist.2",
+                                   NULL);
+  sprintf(expect,
+          "%s: utimensat on: /etc/hosts: %s\n"
+          "%s: 2 more errors not shown\n",
+          prog, strerror(EACCES),
+          prog);
+  assert(strcmp(err_out, expect) == 0);
+  free(err_out);
+
+  /* Collapse repeated errno values, including from worker threads. */
+  err_out = test_touch_main_stderr(EXIT_FAILURE,
+                                   "--collapse-errors",
+                                   "-j",
+                                   "2",
+                                   PATH_NOEXIST,
+                                   "/noexist.2",
+                                   "/noexist.3",
+                                   "/noexist/4",
+                                   NULL);
+  sprintf(expect,
+          "%s: creat: %s: %s\n"
+          "%s: creat: /noexist/4: %s\n"
+          "%s: 2 more errors like the above: %s\n",
+          prog, PATH_NOEXIST, strerror(EACCES),
+          prog, strerror(ENOENT),
+          prog, strerror(EACCES));
+  assert(strcmp(err_out, expect) == 0);
+  free(err_out);
+  err_out = test_touch_main_stderr(EXIT_FAILURE,
+                                   "--collapse-errors",
+                                   "--max-errors=1",
+                                   "-j",
+                                   "3",
+                                   "/etc/hosts",
+                                   "/etc/passwd",
+                                   "/noexist.3",
+                                   "/noexist/4",
+                                   PATH_NOEXIST,
+                                   NULL);
+  sprintf(expect,
+          "%s: utimensat on: /etc/hosts: %s\n"
+          "%s: 3 more errors like the above: %s\n"
+          "%s: 1 more errors not shown\n",
+          prog, strerror(EACCES),
+          prog, strerror(EACCES),
+          prog);
+  assert(strcmp(err_out, expect) == 0);
+  free(err_out);
+
+  /* Messages that do not fit in the buffer get written in blocks. */
+  list = malloc(NUM_LONG * 100);
+  assert(list);
+  list_len = 0;
+  for(i = 0; i < NUM_LONG; i++){
+    list_len += (size_t)sprintf(&list[list_len],
+                                "/noexist/%080lu\n",
+                                (unsigned long)i);
+  }
+  test_write_file(PATH_TMP_LIST, list, list_len);
+  free(list);
+  err_out = test_touch_main_stderr(EXIT_FAILURE, "-f", PATH_TMP_LIST, NULL);
+  assert(remove(PATH_TMP_LIST) == 0);
+  assert(test_count_lines(err_out) == NUM_LONG);
+  sprintf(expect,
+          "/noexist/%080lu: %s\n",
+          (unsigned long)NUM_LONG - 1,
+          strerror(ENOENT));
+  assert(strstr(err_out, expect));
+  free(err_out);
+
+  /* malloc: Print the messages right away. */
+  g_test_seam_err_ctr_malloc = 1;
+  err_out = test_touch_main_stderr(EXIT_FAILURE, PATH_NOEXIST, NULL);
+  g_test_seam_err_ctr_malloc = -1;
+  assert(test_count_lines(err_out) == 1);
+  free(err_out);
+
+  /* Invalid number of errors. */
+  test_touch_main_args(EXIT_FAILURE, "--max-errors=", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE, "--max-errors=-1", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE, "--max-errors=1a", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--max-errors=99999999999999999999",
+                       PATH_TMP_FILE,
+                       NULL);
+  assert(!test_file_exists(PATH_TMP_FILE));
+}
+
+/**
+ * Test scenarios with [--new-files].
+ */
+static void
+test_touch_new_files_all(void){
+  const char *const TREE_DIR = "/tmp/test-touch-new";
+  const size_t NUM_NEW = 150;
+  char path[100];
+  struct stat sb;
+  char *list;
+  size_t list_len;
+  size_t i;
+
+  /* Create several batches of new files, using worker threads. */
+  assert(mkdir(TREE_DIR, S_IRWXU) == 0);
+  list = malloc(NUM_NEW * sizeof(path));
+  assert(list);
+  list_len = 0;
+  for(i = 0; i < NUM_NEW; i++){
+    list_len += (size_t)sprintf(&list[list_len],
+                                "%s/%lu\n",
+                                TREE_DIR,
+                                (unsigned long)i);
+  }
+  test_write_file(PATH_TMP_LIST, list, list_len);
+  free(list);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--new-files",
+                       "-j",
+                       "3",
+                       "-f",
+                       PATH_TMP_LIST,
+                       NULL);
+  for(i = 0; i < NUM_NEW; i++){
+    sprintf(path, "%s/%lu", TREE_DIR, (unsigned long)i);
+    assert(remove(path) == 0);
+  }
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--new-files",
+                       "-d",
+                       "2019-01-01T09:05:00",
+                       "-f",
+                       PATH_TMP_LIST,
+                       NULL);
+  assert(remove(PATH_TMP_LIST) == 0);
+  for(i = 0; i < NUM_NEW; i++){
+    sprintf(path, "%s/%lu", TREE_DIR, (unsigned long)i);
+    test_assert_mtime_year(path, 2019);
+    assert(remove(path) == 0);
+  }
+  assert(rmdir(TREE_DIR) == 0);
+
+  /* Existing files get touched without getting truncated. */
+  test_write_file(PATH_TMP_FILE, "abc", 3);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--new-files",
+                       "-d",
+                       "2018-01-01T09:05:00",
+                       PATH_TMP_FILE,
+                       PATH_TMP_FILE_2,
+                       NULL);
+  assert(stat(PATH_TMP_FILE, &sb) == 0);
+  assert(sb.st_size == 3);
+  test_assert_mtime_year(PATH_TMP_FILE, 2018);
+  test_assert_mtime_year(PATH_TMP_FILE_2, 2018);
+  test_assert_remove_tmp_files();
+
+  /* Do not create files with -c. */
+  test_touch_main_args(EXIT_SUCCESS, "--new-files", "-c", PATH_TMP_FILE, NULL);
+  assert(!test_file_exists(PATH_TMP_FILE));
+
+  /* creat: Unable to create file. */
+  test_touch_main_args(EXIT_FAILURE, "--new-files", PATH_NOEXIST, NULL);
+
+  /* futimens: Failed to set the times. */
+  g_test_seam_err_ctr_futimens = 0;
+  test_touch_main_args(EXIT_FAILURE,
+                       "--new-files",
+                       "-d",
+                       "2018-01-01T09:05:00",
+                       PATH_TMP_FILE,
+                       NULL);
+  g_test_seam_err_ctr_futimens = -1;
+  test_remove_tmp_file();
+}
+
+/**
+ * Test scenarios with [--sort].
+ */
+static void
+test_touch_sort_all(void){
+  const char *const TREE_DIR = "/tmp/test-touch-sort";
+  const size_t NUM_SORT = 40;
+  const char *const prog = program_invocation_short_name;
+  char expect[300];
+  char path[100];
+  char *err_out;
+  char *list;
+  size_t list_len;
+  size_t i;
+
+  /* Targets get touched grouped by directory. */
+  err_out = test_touch_main_stderr(EXIT_FAILURE,
+                                   "--sort",
+                                   "/noexist.2",
+                                   "/etc/hosts",
+                                   "/noexist.3",
+                                   NULL);
+  sprintf(expect,
+          "%s: creat: /noexist.2: %s\n"
+          "%s: creat: /noexist.3: %s\n"
+          "%s: utimensat on: /etc/hosts: %s\n",
+          prog, strerror(EACCES),
+          prog, strerror(EACCES),
+          prog, strerror(EACCES));
+  assert(strcmp(err_out, expect) == 0);
+  free(err_out);
+
+  /* Order a large directory by inode number. */
+  assert(mkdir(TREE_DIR, S_IRWXU) == 0);
+  list = malloc((NUM_SORT * 2 + 1) * sizeof(path));
+  assert(list);
+  list_len = 0;
+  for(i = 0; i < NUM_SORT; i++){
+    list_len += (size_t)sprintf(&list[list_len],
+                                "%s/%lu\n%s\n",
+                                TREE_DIR,
+                                (unsigned long)(NUM_SORT - i),
+                                i % 2 ? PATH_TMP_FILE : PATH_TMP_FILE_2);
+  }
+  test_write_file(PATH_TMP_LIST, list, list_len);
+  test_touch_main_args(EXIT_SUCCESS, "-f", PATH_TMP_LIST, NULL);
+  list_len += (size_t)sprintf(&list[list_len], "%s/new\n", TREE_DIR);
+  test_write_file(PATH_TMP_LIST, list, list_len);
+  free(list);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--sort",
+                       "-d",
+                       "2019-01-01T09:05:00",
+                       "-f",
+                       PATH_TMP_LIST,
+                       NULL);
+  for(i = 1; i <= NUM_SORT; i++){
+    sprintf(path, "%s/%lu", TREE_DIR, (unsigned long)i);
+    test_assert_mtime_year(path, 2019);
+  }
+  sprintf(path, "%s/new", TREE_DIR);
+  test_assert_mtime_year(path, 2019);
+  test_assert_mtime_year(PATH_TMP_FILE, 2019);
+
+  /* Directory cannot get read, keep the original order. */
+  assert(chmod(TREE_DIR, S_IWUSR | S_IXUSR) == 0);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--sort",
+                       "-j",
+                       "2",
+                       "-d",
+                       "2018-01-01T09:05:00",
+                       "-f",
+                       PATH_TMP_LIST,
+                       NULL);
+  assert(chmod(TREE_DIR, S_IRWXU) == 0);
+  test_assert_mtime_year(path, 2018);
+
+  /* malloc: Touch the targets in the original order. */
+  g_test_seam_err_ctr_malloc = 2;
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--sort",
+                       "-d",
+                       "2017-01-01T09:05:00",
+                       PATH_TMP_FILE_2,
+                       PATH_TMP_FILE,
+                       NULL);
+  g_test_seam_err_ctr_malloc = 3;
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--sort",
+                       "-d",
+                       "2016-01-01T09:05:00",
+                       path,
+                       PATH_TMP_FILE,
+                       NULL);
+  g_test_seam_err_ctr_malloc = -1;
+  test_assert_mtime_year(PATH_TMP_FILE_2, 2017);
+  test_assert_mtime_year(PATH_TMP_FILE, 2016);
+  test_assert_remove_tmp_files();
+  assert(remove(PATH_TMP_LIST) == 0);
+  assert(remove(path) == 0);
+  for(i = 1; i <= NUM_SORT; i++){
+    sprintf(path, "%s/%lu", TREE_DIR, (unsigned long)i);
+    assert(remove(path) == 0);
+  }
+  assert(rmdir(TREE_DIR) == 0);
+}
+
+/**
+ * Path to the socket used when testing [--serve=socket].
+ */
+#define PATH_TMP_SOCK "/tmp/test-touch.sock"
+
+/**
+ * Run the server in a separate thread.
+ *
+ * @param[in,out] arg Set to the exit status of @ref touch_main.
+ * @retval        NULL Always.
+ */
+static void *
+test_touch_serve_thread(void *const arg){
+  char arg_0[] = "touch";
+  char arg_1[] = "--serve=" PATH_TMP_SOCK;
+  char *argv[3];
+
+  argv[0] = arg_0;
+  argv[1] = arg_1;
+  argv[2] = NULL;
+  optind = 0;
+  *(int *)arg = touch_main(2, argv);
+  return NULL;
+}
+
+/**
+ * Connect to the server, waiting for it to start if needed.
+ *
+ * @return Connected socket.
+ */
+static int
+test_serve_connect(void){
+  const struct timespec delay = {0, 10000000};
+  struct sockaddr_un addr;
+  int fd;
+  int i;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, PATH_TMP_SOCK);
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  assert(fd >= 0);
+  for(i = 0;
+      connect(fd, (const struct sockaddr *)&addr, sizeof(addr)) != 0;
+      i++){
+    assert(i < 500);
+    nanosleep(&delay, NULL);
+  }
+  return fd;
+}
+
+/**
+ * Send a request to the server and check the response.
+ *
+ * @param[in] fd     Connected socket.
+ * @param[in] req    Request data.
+ * @param[in] len    Number of bytes in @p req.
+ * @param[in] expect Expected response.
+ */
+static void
+test_serve_request(const int fd,
+                   const char *const req,
+                   const size_t len,
+                   const char *const expect){
+  char resp[100];
+  size_t resp_len;
+  ssize_t bytes_read;
+
+  assert(write(fd, req, len) == (ssize_t)len);
+  resp_len = 0;
+  do{
+    bytes_read = read(fd, &resp[resp_len], sizeof(resp) - resp_len - 1);
+    assert(bytes_read > 0);
+    resp_len += (size_t)bytes_read;
+  } while(resp[resp_len - 1] != '\n');
+  resp[resp_len] = '\0';
+  assert(strcmp(resp, expect) == 0);
+}
+
+/**
+ * Test scenarios with [--serve=socket].
+ */
+static void
+test_touch_serve_all(void){
+  const char REQ_TOUCH[] =
+    "-d\0" "2019-01-01T09:05:00\0" PATH_TMP_FILE "\0" PATH_NOEXIST "\0";
+  const char REQ_NO_CREATE[] = "-c\0" PATH_TMP_FILE_2 "\0" PATH_TMP_FILE "\0";
+  const char REQ_SERVE[] = "--serve=" PATH_TMP_SOCK "\0";
+  const char REQ_INVALID[] = "-j\0" "0\0" PATH_TMP_FILE "\0";
+  const char REQ_PROGRESS[] = "--progress=1\0" PATH_TMP_FILE "\0";
+  const char REQ_SHUTDOWN[] = "--shutdown\0";
+  struct sockaddr_un addr;
+  pthread_t thread;
+  char buf[100];
+  int status;
+  int fd;
+
+  assert(pthread_create(&thread, NULL, test_touch_serve_thread, &status) == 0);
+
+  /* Several requests on the same connection. */
+  fd = test_serve_connect();
+  test_serve_request(fd, REQ_TOUCH, sizeof(REQ_TOUCH), "101\n");
+  test_assert_mtime_year(PATH_TMP_FILE, 2019);
+  test_serve_request(fd, REQ_NO_CREATE, sizeof(REQ_NO_CREATE), "000\n");
+  assert(!test_file_exists(PATH_TMP_FILE_2));
+  test_serve_request(fd, REQ_SERVE, sizeof(REQ_SERVE), "1\n");
+  test_serve_request(fd, REQ_INVALID, sizeof(REQ_INVALID), "11\n");
+  test_serve_request(fd, REQ_PROGRESS, sizeof(REQ_PROGRESS), "11\n");
+
+  /* Empty request closes the connection. */
+  assert(write(fd, "", 1) == 1);
+  assert(read(fd, buf, sizeof(buf)) == 0);
+  assert(close(fd) == 0);
+
+  /* Client disconnects in the middle of a request. */
+  fd = test_serve_connect();
+  assert(write(fd, "-c", 2) == 2);
+  assert(close(fd) == 0);
+
+  /* Stop the server. */
+  fd = test_serve_connect();
+  test_serve_request(fd, REQ_SHUTDOWN, sizeof(REQ_SHUTDOWN), "0\n");
+  assert(close(fd) == 0);
+  assert(pthread_join(thread, NULL) == 0);
+  assert(status == EXIT_SUCCESS);
+  assert(!test_file_exists(PATH_TMP_SOCK));
+
+  /* Replace a stale socket and stop the server with SIGTERM. */
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, PATH_TMP_SOCK);
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  assert(fd >= 0);
+  assert(bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) == 0);
+  assert(close(fd) == 0);
+  assert(test_file_exists(PATH_TMP_SOCK));
+  assert(pthread_create(&thread, NULL, test_touch_serve_thread, &status) == 0);
+  fd = test_serve_connect();
+  test_serve_request(fd, REQ_NO_CREATE, sizeof(REQ_NO_CREATE), "000\n");
+  assert(pthread_kill(thread, SIGTERM) == 0);
+  assert(pthread_join(thread, NULL) == 0);
+  assert(close(fd) == 0);
+  assert(status == EXIT_SUCCESS);
+  assert(!test_file_exists(PATH_TMP_SOCK));
+
+  /* Leave alone a file that is not a socket. */
+  test_touch_main_args(EXIT_FAILURE, "--serve=" PATH_TMP_FILE, NULL);
+  assert(test_file_exists(PATH_TMP_FILE));
+  test_remove_tmp_file();
+
+  /* Unable to start the server. */
+  test_touch_main_args(EXIT_FAILURE, "--serve=/noexist/sock", NULL);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--serve=/tmp/aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+                       "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+                       "aaaaaaaaaaaaaaaaaaaaaaaa",
+                       NULL);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--serve=" PATH_TMP_SOCK,
+                       PATH_TMP_FILE,
+                       NULL);
+  test_touch_main_args(EXIT_FAILURE, "--serve=" PATH_TMP_SOCK, "-z", NULL);
+}
+
+/**
+ * Test that idle workers sleep instead of polling while a slow reader
+ * feeds the list through STDIN, using less than half of one core.
+ */
+static void
+test_touch_jobs_ring_slow(void){
+  const struct timespec delay = {0, 20000000L};
+  const char LINE[] = PATH_TMP_FILE "\n";
+  const int NUM_LINES = 10;
+  struct rusage ru_start;
+  struct rusage ru_end;
+  struct timespec wall_start;
+  struct timespec wall_end;
+  long cpu_us;
+  long wall_us;
+  int fds[2];
+  int stdin_fd;
+  int status;
+  int i;
+  pid_t pid;
+
+  assert(pipe(fds) == 0);
+  pid = fork();
+  assert(pid >= 0);
+  if(pid == 0){
+    close(fds[0]);
+    for(i = 0; i < NUM_LINES; i++){
+      nanosleep(&delay, NULL);
+      assert(write(fds[1], LINE, sizeof(LINE) - 1) ==
+             (ssize_t)(sizeof(LINE) - 1));
+    }
+    _exit(0);
+  }
+  close(fds[1]);
+  stdin_fd = dup(STDIN_FILENO);
+  assert(stdin_fd >= 0);
+  assert(dup2(fds[0], STDIN_FILENO) == STDIN_FILENO);
+  close(fds[0]);
+  assert(getrusage(RUSAGE_SELF, &ru_start) == 0);
+  assert(clock_gettime(CLOCK_MONOTONIC, &wall_start) == 0);
+  test_touch_main_args(EXIT_SUCCESS, "-j", "8", "-f", "-", NULL);
+  assert(clock_gettime(CLOCK_MONOTONIC, &wall_end) == 0);
+  assert(getrusage(RUSAGE_SELF, &ru_end) == 0);
+  assert(dup2(stdin_fd, STDIN_FILENO) == STDIN_FILENO);
+  close(stdin_fd);
+  assert(waitpid(pid, &status, 0) == pid);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  cpu_us = (ru_end.ru_utime.tv_sec - ru_start.ru_utime.tv_sec +
+            ru_end.ru_stime.tv_sec - ru_start.ru_stime.tv_sec) * 1000000L +
+           (ru_end.ru_utime.tv_usec - ru_start.ru_utime.tv_usec) +
+           (ru_end.ru_stime.tv_usec - ru_start.ru_stime.tv_usec);
+  wall_us = (wall_end.tv_sec - wall_start.tv_sec) * 1000000L +
+            (wall_end.tv_nsec - wall_start.tv_nsec) / 1000;
+  assert(cpu_us < wall_us / 2);
+  test_remove_tmp_file();
+}
+
+/**
+ * Test streaming a large list to the [-j jobs] workers.
+ */
+static void
+test_touch_jobs_ring_all(void){
+  const size_t NUM_PATHS = 1300;
+  const size_t PATH_LEN = 4000;
+  const size_t NOEXIST_1 = 7;
+  const size_t NOEXIST_2 = 1200;
+  char *list;
+  char *line;
+  char *err_out;
+  char *err_1;
+  char *err_2;
+  size_t i;
+
+  /*
+   * Pad each path with slashes so the list spans more list buffers than
+   * the reader cycles through.
+   */
+  list = malloc(NUM_PATHS * (PATH_LEN + 1));
+  assert(list);
+  for(i = 0; i < NUM_PATHS; i++){
+    line = &list[i * (PATH_LEN + 1)];
+    memset(line, '/', PATH_LEN);
+    line[PATH_LEN] = '\n';
+    if(i == NOEXIST_1){
+      memcpy(&line[PATH_LEN - 14], "/noexist-1.txt", 14);
+    }
+    else if(i == NOEXIST_2){
+      memcpy(&line[PATH_LEN - 14], "/noexist-2.txt", 14);
+    }
+    else if(i % 2){
+      memcpy(&line[PATH_LEN - (sizeof(PATH_TMP_FILE) - 1)],
+             PATH_TMP_FILE,
+             sizeof(PATH_TMP_FILE) - 1);
+    }
+    else{
+      memcpy(&line[PATH_LEN - (sizeof(PATH_TMP_FILE_2) - 1)],
+             PATH_TMP_FILE_2,
+             sizeof(PATH_TMP_FILE_2) - 1);
+    }
+  }
+  test_write_file(PATH_TMP_LIST, list, NUM_PATHS * (PATH_LEN + 1));
+  free(list);
+
+  /* Errors from the workers get printed in list order. */
+  err_out = test_touch_main_stderr(EXIT_FAILURE,
+                                   "-j",
+                                   "4",
+                                   "-d",
+                                   "2019-01-01T09:05:00",
+                                   "-f",
+                                   PATH_TMP_LIST,
+                                   NULL);
+  test_assert_mtime_year(PATH_TMP_FILE, 2019);
+  test_assert_mtime_year(PATH_TMP_FILE_2, 2019);
+  assert(test_count_lines(err_out) == 2);
+  err_1 = strstr(err_out, "/noexist-1.txt: Permission denied\n");
+  err_2 = strstr(err_out, "/noexist-2.txt: Permission denied\n");
+  assert(err_1 && err_2 && err_1 < err_2);
+  free(err_out);
+
+  /* Reader touches all paths even if the worker threads fail to start. */
+  g_test_seam_err_ctr_pthread_create = 0;
+  test_touch_main_args(EXIT_FAILURE,
+                       "-j",
+                       "2",
+                       "-d",
+                       "2018-01-01T09:05:00",
+                       "-f",
+                       PATH_TMP_LIST,
+                       NULL);
+  g_test_seam_err_ctr_pthread_create = -1;
+  test_assert_mtime_year(PATH_TMP_FILE, 2018);
+  test_assert_mtime_year(PATH_TMP_FILE_2, 2018);
+
+  /* malloc: Fall back to reading the list in batches. */
+  for(i = 3; i <= 5; i++){
+    g_test_seam_err_ctr_malloc = (int)i;
+    test_touch_main_args(EXIT_FAILURE,
+                         "-j",
+                         "2",
+                         "-d",
+                         "2017-01-01T09:05:00",
+                         "-f",
+                         PATH_TMP_LIST,
+                         NULL);
+    g_test_seam_err_ctr_malloc = -1;
+    test_assert_mtime_year(PATH_TMP_FILE, 2017);
+    test_assert_mtime_year(PATH_TMP_FILE_2, 2017);
+  }
+  test_assert_remove_tmp_files();
+  assert(remove(PATH_TMP_LIST) == 0);
+  test_touch_jobs_ring_slow();
+}
+
+/**
+ * Walk a tree with [-R] [-j jobs] in a child process.
+ *
+ * @param[in] tree_dir Directory to walk.
+ * @return             Maximum resident set size of the child in kilobytes.
+ */
+static long
+test_touch_tree_rss(const char *const tree_dir){
+  struct rusage ru;
+  pid_t pid;
+  long rss;
+  int pipe_fd[2];
+  int status;
+
+  assert(pipe(pipe_fd) == 0);
+  pid = fork();
+  assert(pid >= 0);
+  if(pid == 0){
+    test_touch_main_args(EXIT_SUCCESS, "-R", "-j", "2", tree_dir, NULL);
+    assert(getrusage(RUSAGE_SELF, &ru) == 0);
+    rss = ru.ru_maxrss;
+    assert(write(pipe_fd[1], &rss, sizeof(rss)) == sizeof(rss));
+    _exit(EXIT_SUCCESS);
+  }
+  assert(close(pipe_fd[1]) == 0);
+  assert(read(pipe_fd[0], &rss, sizeof(rss)) == sizeof(rss));
+  assert(close(pipe_fd[0]) == 0);
+  assert(waitpid(pid, &status, 0) == pid);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+  return rss;
+}
+
+/**
+ * Test that memory used by [-R] [-j jobs] does not grow with the number
+ * of entries in the tree.
+ */
+static void
+test_touch_tree_rss_all(void){
+  const char *const TREE_DIR = "/tmp/test-touch-rss";
+  const size_t NUM_DIRS = 64;
+  const size_t NUM_FILES_SMALL = 16;
+  const size_t NUM_FILES_LARGE = 320;
+  char path[100];
+  long rss_small;
+  long rss_large;
+  size_t i;
+  size_t j;
+
+  rss_small = 0;
+  assert(mkdir(TREE_DIR, S_IRWXU) == 0);
+  for(i = 0; i < NUM_DIRS; i++){
+    sprintf(path, "%s/%lu", TREE_DIR, (unsigned long)i);
+    assert(mkdir(path, S_IRWXU) == 0);
+  }
+  for(j = 0; j < NUM_FILES_LARGE; j++){
+    if(j == NUM_FILES_SMALL){
+      rss_small = test_touch_tree_rss(TREE_DIR);
+    }
+    for(i = 0; i < NUM_DIRS; i++){
+      sprintf(path, "%s/%lu/%lu", TREE_DIR, (unsigned long)i,
+              (unsigned long)j);
+      test_write_file(path, "", 0);
+    }
+  }
+  rss_large = test_touch_tree_rss(TREE_DIR);
+  assert(rss_large - rss_small < 1024);
+  for(i = 0; i < NUM_DIRS; i++){
+    for(j = 0; j < NUM_FILES_LARGE; j++){
+      sprintf(path, "%s/%lu/%lu", TREE_DIR, (unsigned long)i,
+              (unsigned long)j);
+      assert(remove(path) == 0);
+    }
+    sprintf(path, "%s/%lu", TREE_DIR, (unsigned long)i);
+    assert(rmdir(path) == 0);
+  }
+  assert(rmdir(TREE_DIR) == 0);
+}
+
+/**
+ * Test scenarios with [--glob].
+ */
+static void
+test_touch_glob_all(void){
+  const char *const GLOB_DIRS[] = {
+    "/tmp/test-touch-glob",
+    "/tmp/test-touch-glob/a",
+    "/tmp/test-touch-glob/a/b",
+    "/tmp/test-touch-glob/c",
+    "/tmp/test-touch-glob/.h"
+  };
+  const char *const GLOB_FILES[] = {
+    "/tmp/test-touch-glob/a/1.stamp",
+    "/tmp/test-touch-glob/a/2.txt",
+    "/tmp/test-touch-glob/a/.3.stamp",
+    "/tmp/test-touch-glob/a/b/4.stamp",
+    "/tmp/test-touch-glob/c/5.stamp",
+    "/tmp/test-touch-glob/.h/6.stamp"
+  };
+  const char *const GLOB_LINK = "/tmp/test-touch-glob/l";
+  const size_t NUM_DIRS = sizeof(GLOB_DIRS) / sizeof(GLOB_DIRS[0]);
+  const size_t NUM_FILES = sizeof(GLOB_FILES) / sizeof(GLOB_FILES[0]);
+  char *err_out;
+  size_t i;
+
+  for(i = 0; i < NUM_DIRS; i++){
+    assert(mkdir(GLOB_DIRS[i], S_IRWXU) == 0);
+  }
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-d",
+                       "2015-01-01T09:05:00",
+                       GLOB_FILES[0],
+                       GLOB_FILES[1],
+                       GLOB_FILES[2],
+                       GLOB_FILES[3],
+                       GLOB_FILES[4],
+                       GLOB_FILES[5],
+                       NULL);
+  assert(symlink(GLOB_DIRS[1], GLOB_LINK) == 0);
+
+  /*
+   * Match in any subdirectory, skipping hidden names and the symbolic
+   * link to a directory.
+   */
+  err_out = test_touch_main_stderr(EXIT_SUCCESS,
+                                   "--glob",
+                                   "--stats",
+                                   "-d",
+                                   "2019-01-01T09:05:00",
+                                   "/tmp/test-touch-glob/**/*.stamp",
+                                   NULL);
+  assert(strstr(err_out, "\"creats\":0,\"utimensat\":3,"));
+  free(err_out);
+  test_assert_mtime_year(GLOB_FILES[0], 2019);
+  test_assert_mtime_year(GLOB_FILES[3], 2019);
+  test_assert_mtime_year(GLOB_FILES[4], 2019);
+  test_assert_mtime_year(GLOB_FILES[1], 2015);
+  test_assert_mtime_year(GLOB_FILES[2], 2015);
+  test_assert_mtime_year(GLOB_FILES[5], 2015);
+
+  /* Patterns matched using fnmatch(), a prefix, and a literal. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--glob",
+                       "-d",
+                       "2018-01-01T09:05:00",
+                       "/tmp/test-touch-glob/a/?.*",
+                       "/tmp/test-touch-glob/*/b/4*",
+                       NULL);
+  test_assert_mtime_year(GLOB_FILES[0], 2018);
+  test_assert_mtime_year(GLOB_FILES[1], 2018);
+  test_assert_mtime_year(GLOB_FILES[3], 2018);
+  test_assert_mtime_year(GLOB_FILES[4], 2019);
+
+  /* Relative pattern and a hidden directory named in the pattern. */
+  assert(chdir(GLOB_DIRS[0]) == 0);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--glob",
+                       "-d",
+                       "2017-01-01T09:05:00",
+                       "c/[0-9].stamp",
+                       ".h/*",
+                       NULL);
+  assert(chdir("/") == 0);
+  test_assert_mtime_year(GLOB_FILES[4], 2017);
+  test_assert_mtime_year(GLOB_FILES[5], 2017);
+
+  /*
+   * Operands without pattern characters still get created, and patterns
+   * without matches get ignored.
+   */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--glob",
+                       PATH_TMP_FILE,
+                       "/tmp/test-touch-glob/*/noexist-*",
+                       "/tmp/test-touch-glob/noexist/*",
+                       "/tmp/test-touch-glob/a/1.stamp/*",
+                       NULL);
+  assert(test_file_exists(PATH_TMP_FILE));
+  test_remove_tmp_file();
+
+  /* Touch everything inside of matching directories with -R. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--glob",
+                       "-R",
+                       "-d",
+                       "2016-01-01T09:05:00",
+                       "/tmp/test-touch-glob/[a]",
+                       NULL);
+  test_assert_mtime_year(GLOB_DIRS[1], 2016);
+  test_assert_mtime_year(GLOB_FILES[2], 2016);
+  test_assert_mtime_year(GLOB_FILES[3], 2016);
+  test_assert_mtime_year(GLOB_FILES[4], 2017);
+
+  /* open: Unable to read directory. */
+  assert(chmod(GLOB_DIRS[3], S_IWUSR | S_IXUSR) == 0);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--glob",
+                       "/tmp/test-touch-glob/c/*",
+                       NULL);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--glob",
+                       "/tmp/test-touch-glob/**/x",
+                       NULL);
+  assert(chmod(GLOB_DIRS[3], S_IRWXU) == 0);
+
+  /* malloc: Failed to compile pattern. */
+  g_test_seam_err_ctr_malloc = 2;
+  test_touch_main_args(EXIT_FAILURE,
+                       "--glob",
+                       "/tmp/test-touch-glob/*",
+                       NULL);
+  g_test_seam_err_ctr_malloc = -1;
+
+  assert(remove(GLOB_LINK) == 0);
+  for(i = 0; i < NUM_FILES; i++){
+    assert(remove(GLOB_FILES[i]) == 0);
+  }
+  for(i = NUM_DIRS; i-- > 0;){
+    assert(rmdir(GLOB_DIRS[i]) == 0);
+  }
+}
+
+/**
+ * Test scenarios with [--durable].
+ */
+static void
+test_touch_durable_all(void){
+  const char *const DURABLE_DIRS[] = {
+    "/tmp/test-touch-durable",
+    "/tmp/test-touch-durable/a",
+    "/tmp/test-touch-durable/b"
+  };
+  const char *const DURABLE_FILES[] = {
+    "/tmp/test-touch-durable/a/1",
+    "/tmp/test-touch-durable/a/2",
+    "/tmp/test-touch-durable/b/3"
+  };
+  const size_t NUM_DIRS = sizeof(DURABLE_DIRS) / sizeof(DURABLE_DIRS[0]);
+  const size_t NUM_FILES = sizeof(DURABLE_FILES) / sizeof(DURABLE_FILES[0]);
+  const char *const PATH_SHM = "/dev/shm/test-touch-durable";
+  const char *const PATH_LINK = "/tmp/test-touch-durable/link";
+  struct touch_ctx *ctx;
+  struct stat sb_shm;
+  struct stat sb_tmp;
+  size_t i;
+
+  for(i = 0; i < NUM_DIRS; i++){
+    assert(mkdir(DURABLE_DIRS[i], S_IRWXU) == 0);
+  }
+
+  /*
+   * Files in different directories on the same filesystem only flush the
+   * filesystem once, so failing the second syncfs() has no effect.
+   */
+  g_test_seam_err_ctr_syncfs = 1;
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--durable",
+                       "-d",
+                       "2019-01-01T09:05:00",
+                       DURABLE_FILES[0],
+                       DURABLE_FILES[1],
+                       DURABLE_FILES[2],
+                       NULL);
+  for(i = 0; i < NUM_FILES; i++){
+    test_assert_mtime_year(DURABLE_FILES[i], 2019);
+  }
+
+  /* Same with worker threads and -R. */
+  g_test_seam_err_ctr_syncfs = 1;
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--durable",
+                       "-j",
+                       "2",
+                       "-d",
+                       "2018-01-01T09:05:00",
+                       DURABLE_FILES[0],
+                       DURABLE_FILES[2],
+                       NULL);
+  test_assert_mtime_year(DURABLE_FILES[0], 2018);
+  test_assert_mtime_year(DURABLE_FILES[2], 2018);
+  g_test_seam_err_ctr_syncfs = 1;
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--durable",
+                       "-R",
+                       "-d",
+                       "2017-01-01T09:05:00",
+                       DURABLE_DIRS[0],
+                       NULL);
+  for(i = 0; i < NUM_FILES; i++){
+    test_assert_mtime_year(DURABLE_FILES[i], 2017);
+  }
+
+  /* Relative paths and a missing parent directory. */
+  assert(chdir(DURABLE_DIRS[1]) == 0);
+  g_test_seam_err_ctr_syncfs = 1;
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--durable",
+                       "-c",
+                       "-d",
+                       "2016-01-01T09:05:00",
+                       "1",
+                       "noexist/1",
+                       "2",
+                       NULL);
+  assert(chdir("/") == 0);
+  test_assert_mtime_year(DURABLE_FILES[0], 2016);
+  test_assert_mtime_year(DURABLE_FILES[1], 2016);
+
+  /*
+   * Symbolic links into another filesystem flush the filesystem of the
+   * target, which is every filesystem unless the target is a directory.
+   */
+  assert(stat("/dev/shm", &sb_shm) == 0);
+  assert(stat(DURABLE_DIRS[0], &sb_tmp) == 0);
+  if(sb_shm.st_dev != sb_tmp.st_dev){
+    assert(symlink(PATH_SHM, PATH_LINK) == 0);
+    g_test_seam_err_ctr_syncfs = 0;
+    test_touch_main_args(EXIT_SUCCESS, "--durable", PATH_LINK, NULL);
+    assert(g_test_seam_err_ctr_syncfs == 0);
+    assert(remove(PATH_SHM) == 0);
+    assert(mkdir(PATH_SHM, S_IRWXU) == 0);
+    g_test_seam_err_ctr_syncfs = 1;
+    test_touch_main_args(EXIT_FAILURE, "--durable", PATH_LINK, NULL);
+    g_test_seam_err_ctr_syncfs = -1;
+    assert(rmdir(PATH_SHM) == 0);
+    assert(remove(PATH_LINK) == 0);
+  }
+
+  /* syncfs: Failed to flush the filesystem. */
+  g_test_seam_err_ctr_syncfs = 0;
+  test_touch_main_args(EXIT_FAILURE,
+                       "--durable",
+                       DURABLE_FILES[0],
+                       NULL);
+  g_test_seam_err_ctr_syncfs = 0;
+  test_touch_main_args(EXIT_FAILURE,
+                       "--durable",
+                       "-R",
+                       DURABLE_DIRS[0],
+                       NULL);
+
+  /*
+   * Flush every filesystem using sync() without a filesystem list or
+   * without a directory cache.
+   */
+  g_test_seam_err_ctr_syncfs = 0;
+  g_test_seam_err_ctr_malloc = 2;
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--durable",
+                       DURABLE_FILES[0],
+                       NULL);
+  g_test_seam_err_ctr_malloc = 0;
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--durable",
+                       DURABLE_FILES[0],
+                       NULL);
+  assert(g_test_seam_err_ctr_syncfs == 0);
+  g_test_seam_err_ctr_syncfs = -1;
+  g_test_seam_err_ctr_malloc = -1;
+
+  /* Library context flushes after each call. */
+  ctx = touch_ctx_new(TOUCH_FLAG_DURABLE | TOUCH_FLAG_DATE_TIME,
+                      "2015-01-01T09:05:00");
+  assert(ctx);
+  assert(touch_ctx_apply_many(ctx, DURABLE_FILES, NUM_FILES) == EXIT_SUCCESS);
+  g_test_seam_err_ctr_syncfs = 0;
+  assert(touch_ctx_apply(ctx, DURABLE_FILES[0]) == EXIT_FAILURE);
+  g_test_seam_err_ctr_syncfs = -1;
+  touch_ctx_free(ctx);
+  for(i = 0; i < NUM_FILES; i++){
+    test_assert_mtime_year(DURABLE_FILES[i], 2015);
+  }
+
+  for(i = 0; i < NUM_FILES; i++){
+    assert(remove(DURABLE_FILES[i]) == 0);
+  }
+  for(i = NUM_DIRS; i-- > 0;){
+    assert(rmdir(DURABLE_DIRS[i]) == 0);
+  }
+}
+
+/**
+ * Test scenarios with [--progress[=fd]].
+ */
+static void
+test_touch_progress_all(void){
+  const char *const PATH_PROGRESS_LIST = "/tmp/test-touch-progress.txt";
+  const char *const PATH_PROGRESS_OUT = "/tmp/test-touch-progress.out";
+  const size_t NUM_PATHS = 20000;
+  char fd_arg[30];
+  const char *last;
+  char *list;
+  char *err_out;
+  size_t len;
+  size_t i;
+  int fd;
+
+  /* Final report to STDERR. */
+  err_out = test_touch_main_stderr(EXIT_SUCCESS,
+                                   "--progress",
+                                   PATH_TMP_FILE,
+                                   NULL);
+  assert(strncmp(err_out, "progress: done=1 errors=0 ", 26) == 0);
+  assert(strstr(err_out, " finished\n"));
+  assert(test_count_lines(err_out) == 1);
+  free(err_out);
+  test_remove_tmp_file();
+
+  /* Final report to another file descriptor. */
+  fd = open(PATH_PROGRESS_OUT, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
+  assert(fd >= 0);
+  sprintf(fd_arg, "--progress=%d", fd);
+  test_touch_main_args(EXIT_FAILURE,
+                       fd_arg,
+                       "-c",
+                       PATH_TMP_FILE,
+                       "/tmp/noexist/noexist",
+                       "/dev/null/noexist",
+                       NULL);
+  assert(close(fd) == 0);
+  err_out = test_read_file(PATH_PROGRESS_OUT);
+  assert(strncmp(err_out, "progress: done=3 errors=1 ", 26) == 0);
+  free(err_out);
+
+  /* Periodic reports while streaming a list, sorting it, and walking it. */
+  list = malloc(NUM_PATHS * 40);
+  assert(list);
+  len = 0;
+  for(i = 0; i < NUM_PATHS; i++){
+    len += (size_t)sprintf(&list[len], "/tmp/test-touch-progress-%lu\n",
+                           (unsigned long)i);
+  }
+  test_write_file(PATH_PROGRESS_LIST, list, len);
+  free(list);
+  g_test_seam_progress_interval_ns = 100000;
+  err_out = test_touch_main_stderr(EXIT_SUCCESS,
+                                   "--progress",
+                                   "-c",
+                                   "-j",
+                                   "2",
+                                   "-f",
+                                   PATH_PROGRESS_LIST,
+                                   NULL);
+  assert(test_count_lines(err_out) > 1);
+  last = strstr(err_out, "progress: done=20000 errors=0 ");
+  assert(last && strstr(last, " finished\n"));
+  free(err_out);
+  err_out = test_touch_main_stderr(EXIT_SUCCESS,
+                                   "--progress",
+                                   "-c",
+                                   "--sort",
+                                   "-j",
+                                   "2",
+                                   "-f",
+                                   PATH_PROGRESS_LIST,
+                                   NULL);
+  assert(strstr(err_out, "progress: done=20000 errors=0 "));
+  free(err_out);
+  err_out = test_touch_main_stderr(EXIT_SUCCESS,
+                                   "--progress",
+                                   "-R",
+                                   "-c",
+                                   "/tmp/test-touch-progress-none",
+                                   NULL);
+  assert(strstr(err_out, "progress: done=1 errors=0 "));
+  free(err_out);
+  g_test_seam_progress_interval_ns = 1000000000UL;
+
+  /* No reports if the reporter fails to start. */
+  g_test_seam_err_ctr_pthread_create = 0;
+  err_out = test_touch_main_stderr(EXIT_SUCCESS,
+                                   "--progress",
+                                   "-c",
+                                   PATH_TMP_FILE,
+                                   NULL);
+  assert(*err_out == '\0');
+  free(err_out);
+  g_test_seam_err_ctr_pthread_create = -1;
+  g_test_seam_err_ctr_malloc = 2;
+  err_out = test_touch_main_stderr(EXIT_SUCCESS,
+                                   "--progress",
+                                   "-c",
+                                   PATH_TMP_FILE,
+                                   NULL);
+  assert(*err_out == '\0');
+  free(err_out);
+  g_test_seam_err_ctr_malloc = -1;
+
+  /* Invalid file descriptors. */
+  test_touch_main_args(EXIT_FAILURE, "--progress=0", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE, "--progress=x", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE, "--progress=3x", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--progress=99999999999",
+                       PATH_TMP_FILE,
+                       NULL);
+  assert(remove(PATH_PROGRESS_LIST) == 0);
+  assert(remove(PATH_PROGRESS_OUT) == 0);
+}
+
+/**
+ * Test scenarios with [--max-rate=ops], [--target-latency=usec],
+ * [--nice=level], and [--ioprio=idle|level].
+ */
+static void
+test_touch_limit_all(void){
+  const char *const PATH_LIMIT_LIST = "/tmp/test-touch-limit.txt";
+  const size_t NUM_PATHS = 2000;
+  struct timespec start;
+  struct timespec end;
+  unsigned long elapsed_ms;
+  char nice_arg[30];
+  char *list;
+  char *err_out;
+  size_t len;
+  size_t i;
+
+  list = malloc(NUM_PATHS * 40);
+  assert(list);
+  len = 0;
+  for(i = 0; i < NUM_PATHS; i++){
+    len += (size_t)sprintf(&list[len], "/tmp/test-touch-limit-%lu\n",
+                           (unsigned long)i);
+  }
+  test_write_file(PATH_LIMIT_LIST, list, len);
+  free(list);
+
+  /* Rate limit spaces out the operations across all workers. */
+  assert(clock_gettime(CLOCK_MONOTONIC, &start) == 0);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--max-rate=1000",
+                       "-c",
+                       "-j",
+                       "4",
+                       "/tmp/test-touch-limit-0",
+                       "/tmp/test-touch-limit-1",
+                       "/tmp/test-touch-limit-2",
+                       "/tmp/test-touch-limit-3",
+                       "/tmp/test-touch-limit-4",
+                       "/tmp/test-touch-limit-5",
+                       "/tmp/test-touch-limit-6",
+                       "/tmp/test-touch-limit-7",
+                       "/tmp/test-touch-limit-8",
+                       "/tmp/test-touch-limit-9",
+                       "/tmp/test-touch-limit-10",
+                       NULL);
+  assert(clock_gettime(CLOCK_MONOTONIC, &end) == 0);
+  elapsed_ms = (unsigned long)(end.tv_sec - start.tv_sec) * 1000UL +
+               (unsigned long)(end.tv_nsec / 1000000L) -
+               (unsigned long)(start.tv_nsec / 1000000L);
+  assert(elapsed_ms >= 9);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--max-rate=1000000000",
+                       "--new-files",
+                       PATH_TMP_FILE,
+                       NULL);
+  assert(access(PATH_TMP_FILE, F_OK) == 0);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--max-rate=1000000000",
+                       "--new-files",
+                       PATH_TMP_FILE,
+                       NULL);
+  test_remove_tmp_file();
+
+  /* Workers pause while the latency stays above the target. */
+  g_test_seam_limit_window_ns = 0;
+  g_test_seam_utimensat_delay_ns = 20000;
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--target-latency=1",
+                       "-c",
+                       "-j",
+                       "4",
+                       "-f",
+                       PATH_LIMIT_LIST,
+                       NULL);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--target-latency=1",
+                       "-c",
+                       "--sort",
+                       "-j",
+                       "4",
+                       "-f",
+                       PATH_LIMIT_LIST,
+                       NULL);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--target-latency=1000000",
+                       "--max-rate=1000000000",
+                       "-c",
+                       "-j",
+                       "4",
+                       "-f",
+                       PATH_LIMIT_LIST,
+                       NULL);
+  g_test_seam_utimensat_delay_ns = 0;
+  g_test_seam_limit_window_ns = 100000000UL;
+
+  /* Limits missing on allocation failure. */
+  g_test_seam_err_ctr_malloc = 2;
+  err_out = test_touch_main_stderr(EXIT_FAILURE,
+                                   "--max-rate=10",
+                                   "-c",
+                                   PATH_TMP_FILE,
+                                   NULL);
+  assert(strstr(err_out, "malloc: limit"));
+  free(err_out);
+  g_test_seam_err_ctr_malloc = -1;
+
+  /* Priorities. */
+  errno = 0;
+  sprintf(nice_arg, "--nice=%d", getpriority(PRIO_PROCESS, 0));
+  assert(errno == 0);
+  test_touch_main_args(EXIT_SUCCESS, nice_arg, "-c", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_SUCCESS, "--ioprio=4", "-c", PATH_TMP_FILE, NULL);
+
+  /* Invalid arguments. */
+  test_touch_main_args(EXIT_FAILURE, "--max-rate=0", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE, "--max-rate=x", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--max-rate=1000000001",
+                       PATH_TMP_FILE,
+                       NULL);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--target-latency=0",
+                       PATH_TMP_FILE,
+                       NULL);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--target-latency=1x",
+                       PATH_TMP_FILE,
+                       NULL);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--target-latency=99999999999999999999",
+                       PATH_TMP_FILE,
+                       NULL);
+  test_touch_main_args(EXIT_FAILURE, "--nice=20", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE, "--nice=-21", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE, "--nice=", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE, "--nice=1x", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE, "--ioprio=8", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE, "--ioprio=be", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE, "--ioprio=", PATH_TMP_FILE, NULL);
+  test_touch_main_args(EXIT_FAILURE, "--ioprio=44", PATH_TMP_FILE, NULL);
+  assert(access(PATH_TMP_FILE, F_OK) != 0);
+  assert(remove(PATH_LIMIT_LIST) == 0);
+}
+
+/**
+ * Test scenarios with [--plan].
+ */
+static void
+test_touch_plan_all(void){
+  const char *const PATH_PLAN_DIR = "/tmp/test-touch-plan";
+  const char *const PATH_PLAN_FILE = "/tmp/test-touch-plan/file";
+  const char *const PATH_PLAN_NEW = "/tmp/test-touch-plan/new";
+  const char *const PATH_PLAN_LIST = "/tmp/test-touch-plan.txt";
+  const size_t NUM_PATHS = 2000;
+  char *list;
+  char *out;
+  size_t len;
+  size_t i;
+
+  assert(mkdir(PATH_PLAN_DIR, S_IRWXU) == 0);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-d",
+                       "2001-06-01T00:00:00Z",
+                       PATH_PLAN_FILE,
+                       NULL);
+
+  /* Classify targets without changing anything. */
+  out = test_touch_main_stdout(EXIT_FAILURE,
+                               "--plan",
+                               PATH_PLAN_FILE,
+                               PATH_PLAN_NEW,
+                               "/tmp/noexist/noexist",
+                               NULL);
+  assert(strstr(out, " dirs=1 create=1 update=1 unchanged=0 skip=0 "
+                     "error=0\n"));
+  assert(strstr(out, "plan: dev=other dirs=0 create=0 update=0 "
+                     "unchanged=0 skip=0 error=1\n"));
+  assert(strstr(out, "plan: total dirs=1 create=1 update=1 unchanged=0 "
+                     "skip=0 error=1\n"));
+  assert(strstr(out, "plan: syscalls="));
+  assert(test_count_lines(out) == 4);
+  free(out);
+  assert(access(PATH_PLAN_NEW, F_OK) != 0);
+  test_assert_mtime_year(PATH_PLAN_FILE, 2001);
+
+  /* Unchanged and skipped targets. */
+  out = test_touch_main_stdout(EXIT_SUCCESS,
+                               "--plan",
+                               "--if-changed",
+                               "-c",
+                               "-d",
+                               "2001-06-01T00:00:00Z",
+                               PATH_PLAN_FILE,
+                               PATH_PLAN_NEW,
+                               NULL);
+  assert(strstr(out, "plan: total dirs=1 create=0 update=0 unchanged=1 "
+                     "skip=1 error=0\n"));
+  free(out);
+  out = test_touch_main_stdout(EXIT_SUCCESS,
+                               "--plan",
+                               "--forward-only",
+                               "--new-files",
+                               "-d",
+                               "2000-06-01T00:00:00Z",
+                               PATH_PLAN_FILE,
+                               PATH_PLAN_NEW,
+                               NULL);
+  assert(strstr(out, "plan: total dirs=1 create=1 update=0 unchanged=1 "
+                     "skip=0 error=0\n"));
+  free(out);
+  assert(access(PATH_PLAN_NEW, F_OK) != 0);
+
+  /* Targets the user does not own. */
+  if(geteuid() != 0){
+    out = test_touch_main_stdout(EXIT_FAILURE,
+                                 "--plan",
+                                 "-d",
+                                 "2001-06-01T00:00:00Z",
+                                 "/",
+                                 "/dev/null",
+                                 NULL);
+    assert(strstr(out, "plan: total dirs=2 create=0 update=0 unchanged=0 "
+                       "skip=0 error=2\n"));
+    free(out);
+    out = test_touch_main_stdout(EXIT_SUCCESS, "--plan", "/dev/null", NULL);
+    assert(strstr(out, "plan: total dirs=1 create=0 update=1 "));
+    free(out);
+    out = test_touch_main_stdout(EXIT_FAILURE, "--plan", "/noexist", NULL);
+    assert(strstr(out, "plan: total dirs=1 create=0 update=0 unchanged=0 "
+                       "skip=0 error=1\n"));
+    free(out);
+  }
+
+  /* Walking a tree and checking reference files. */
+  out = test_touch_main_stdout(EXIT_SUCCESS,
+                               "--plan",
+                               "-R",
+                               "-c",
+                               PATH_PLAN_DIR,
+                               NULL);
+  assert(strstr(out, "plan: total dirs=2 create=0 update=2 "));
+  free(out);
+  test_assert_mtime_year(PATH_PLAN_FILE, 2001);
+  out = test_touch_main_stdout(EXIT_FAILURE,
+                               "--plan",
+                               "--ref-root=/tmp/test-touch-plan",
+                               "--target-root=/tmp",
+                               "/tmp/file",
+                               "/tmp/noexist",
+                               NULL);
+  assert(strstr(out, "plan: total dirs=1 create=1 update=0 unchanged=0 "
+                     "skip=0 error=1\n"));
+  free(out);
+  assert(access("/tmp/file", F_OK) != 0);
+
+  /* Worker threads, run time estimate, and rate limit. */
+  list = malloc(NUM_PATHS * 40);
+  assert(list);
+  len = 0;
+  for(i = 0; i < NUM_PATHS; i++){
+    len += (size_t)sprintf(&list[len], "%s/%lu\n",
+                           PATH_PLAN_DIR,
+                           (unsigned long)i);
+  }
+  test_write_file(PATH_PLAN_LIST, list, len);
+  free(list);
+  out = test_touch_main_stdout(EXIT_SUCCESS,
+                               "--plan",
+                               "-j",
+                               "4",
+                               "-f",
+                               PATH_PLAN_LIST,
+                               NULL);
+  assert(strstr(out, " create=2000 update=0 "));
+  assert(strstr(out, "latency_ns="));
+  assert(strstr(out, " jobs=4 "));
+  free(out);
+  assert(access("/tmp/test-touch-plan/0", F_OK) != 0);
+  out = test_touch_main_stdout(EXIT_SUCCESS,
+                               "--plan",
+                               "--durable",
+                               "--max-rate=1",
+                               "--io-uring",
+                               PATH_PLAN_FILE,
+                               PATH_PLAN_NEW,
+                               "/tmp/test-touch-plan-new",
+                               NULL);
+  assert(strstr(out, "plan: total dirs=2 create=2 update=1 "));
+  assert(strstr(out, " estimate_ms=3000\n"));
+  free(out);
+  assert(access(PATH_PLAN_NEW, F_OK) != 0);
+
+  /* No summary on allocation failure. */
+  g_test_seam_err_ctr_malloc = 2;
+  out = test_touch_main_stdout(EXIT_FAILURE,
+                               "--plan",
+                               PATH_PLAN_NEW,
+                               NULL);
+  assert(*out == '\0');
+  free(out);
+  g_test_seam_err_ctr_malloc = -1;
+  assert(access(PATH_PLAN_NEW, F_OK) != 0);
+
+  assert(remove(PATH_PLAN_LIST) == 0);
+  assert(remove(PATH_PLAN_FILE) == 0);
+  assert(rmdir(PATH_PLAN_DIR) == 0);
+}
+
+/**
+ * Check the contents of a checkpoint saved by --checkpoint.
+ *
+ * @param[in] path   Path to the checkpoint.
+ * @param[in] expect Expected checkpoint contents.
+ */
+static void
+test_assert_checkpoint(const char *const path,
+                       const char *const expect){
+  char *data;
+
+  data = test_read_file(path);
+  assert(strcmp(data, expect) == 0);
+  free(data);
+}
+
+/**
+ * Test scenarios with [--checkpoint=file] and [--resume].
+ */
+static void
+test_touch_checkpoint_all(void){
+  const char *const PATH_CP = "/tmp/test-touch-checkpoint.json";
+  const char *const PATH_CP_DIR = "/tmp/test-touch-checkpoint";
+  const char *const PATH_CP_A = "/tmp/test-touch-checkpoint/a";
+  const char *const PATH_CP_B = "/tmp/test-touch-checkpoint/b";
+  const char *const PATH_CP_LIST = "/tmp/test-touch-checkpoint.txt";
+  const char *const PATH_CP_MANIFEST = "/tmp/test-touch-checkpoint.man";
+  const char LIST[] = "/tmp/test-touch-checkpoint/a\n"
+                      "/tmp/noexist/noexist\n"
+                      "/tmp/test-touch-checkpoint/b\n";
+  const char MANIFEST[] = "2000-06-01T00:00:00Z 2000-06-01T00:00:00Z "
+                          "/tmp/test-touch-checkpoint/a\n"
+                          "2000-06-01T00:00:00Z 2000-06-01T00:00:00Z "
+                          "/tmp/test-touch-checkpoint/b\n";
+  const char *const INVALID[] = {
+    "",
+    "{\"offset\":1}\n",
+    "{\"offset\":-1,\"targets\":0,\"errors\":0,\"errno\":{}}\n",
+    "{\"offset\":99999999999999999999,\"targets\":0,\"errors\":0,"
+    "\"errno\":{}}\n",
+    "{\"offset\":0,\"targets\":0,\"errors\":0,\"errno\":[]}\n",
+    "{\"offset\":0,\"targets\":0,\"errors\":1,\"errno\":{\"160\":1}}\n",
+    "{\"offset\":0,\"targets\":0,\"errors\":1,\"errno\":{\"2\":1,}}\n",
+    "{\"offset\":0,\"targets\":0,\"errors\":0,\"errno\":{}}\nx",
+    "{\"offset\":0,\"targets\":0,\"errors\":0,\"errno\":{}"
+  };
+  const size_t LIST_LEN = sizeof(LIST) - 1;
+  const size_t B_OFFSET = LIST_LEN - strlen(PATH_CP_B) - 1;
+  const size_t MAP_LEN = 2 << 20;
+  char expect[200];
+  char *list;
+  char *out;
+  size_t i;
+  int fds[2];
+  int fd_stdin;
+
+  assert(mkdir(PATH_CP_DIR, S_IRWXU) == 0);
+  test_write_file(PATH_CP_LIST, LIST, LIST_LEN);
+  test_write_file(PATH_CP_MANIFEST, MANIFEST, sizeof(MANIFEST) - 1);
+
+  /* Save the offset and error summary while touching a list. */
+  test_touch_main_args(EXIT_FAILURE,
+                       "--checkpoint=/tmp/test-touch-checkpoint.json",
+                       "-f",
+                       PATH_CP_LIST,
+                       NULL);
+  sprintf(expect,
+          "{\"offset\":%lu,\"targets\":3,\"errors\":1,\"errno\":{\"2\":1}}\n",
+          (unsigned long)LIST_LEN);
+  test_assert_checkpoint(PATH_CP, expect);
+  assert(access(PATH_CP_A, F_OK) == 0);
+  assert(access(PATH_CP_B, F_OK) == 0);
+
+  /* Resume after the failed path, adding to the saved totals. */
+  assert(remove(PATH_CP_A) == 0);
+  assert(remove(PATH_CP_B) == 0);
+  sprintf(expect,
+          "{\"offset\":%lu,\"targets\":2,\"errors\":1,\"errno\":{\"2\":1}}\n",
+          (unsigned long)B_OFFSET);
+  test_write_file(PATH_CP, expect, strlen(expect));
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--resume",
+                       "--checkpoint=/tmp/test-touch-checkpoint.json",
+                       "-j",
+                       "3",
+                       "-f",
+                       PATH_CP_LIST,
+                       NULL);
+  assert(access(PATH_CP_A, F_OK) != 0);
+  assert(access(PATH_CP_B, F_OK) == 0);
+  sprintf(expect,
+          "{\"offset\":%lu,\"targets\":3,\"errors\":1,\"errno\":{\"2\":1}}\n",
+          (unsigned long)LIST_LEN);
+  test_assert_checkpoint(PATH_CP, expect);
+
+  /* Resuming a finished run touches nothing, and --plan saves nothing. */
+  assert(remove(PATH_CP_B) == 0);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--resume",
+                       "--checkpoint=/tmp/test-touch-checkpoint.json",
+                       "-f",
+                       PATH_CP_LIST,
+                       NULL);
+  assert(access(PATH_CP_B, F_OK) != 0);
+  sprintf(expect,
+          "{\"offset\":%lu,\"targets\":3,\"errors\":1,\"errno\":{\"2\":1}}\n",
+          (unsigned long)B_OFFSET);
+  test_write_file(PATH_CP, expect, strlen(expect));
+  out = test_touch_main_stdout(EXIT_SUCCESS,
+                               "--plan",
+                               "--resume",
+                               "--checkpoint=/tmp/test-touch-checkpoint.json",
+                               "-f",
+                               PATH_CP_LIST,
+                               NULL);
+  assert(strstr(out, "plan: total dirs=1 create=1 update=0 unchanged=0 "
+                     "skip=0 error=0\n"));
+  free(out);
+  test_assert_checkpoint(PATH_CP, expect);
+  assert(access(PATH_CP_B, F_OK) != 0);
+
+  /* A missing checkpoint starts from the beginning. */
+  assert(remove(PATH_CP) == 0);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--resume",
+                       "--checkpoint=/tmp/test-touch-checkpoint.json",
+                       "-f",
+                       PATH_CP_LIST,
+                       NULL);
+  assert(access(PATH_CP_A, F_OK) == 0);
+  assert(access(PATH_CP_B, F_OK) == 0);
+  assert(remove(PATH_CP_A) == 0);
+  assert(remove(PATH_CP_B) == 0);
+
+  /* Resume a list on a pipe by reading past the saved offset, or fail if
+   * the pipe ends before it. */
+  fd_stdin = dup(STDIN_FILENO);
+  assert(fd_stdin >= 0);
+  for(i = 0; i < 2; i++){
+    sprintf(expect,
+            "{\"offset\":%lu,\"targets\":2,\"errors\":1,"
+            "\"errno\":{\"2\":1}}\n",
+            (unsigned long)((i == 0) ? B_OFFSET : LIST_LEN + 1));
+    test_write_file(PATH_CP, expect, strlen(expect));
+    assert(pipe(fds) == 0);
+    assert(write(fds[1], LIST, LIST_LEN) == (ssize_t)LIST_LEN);
+    assert(close(fds[1]) == 0);
+    assert(dup2(fds[0], STDIN_FILENO) == STDIN_FILENO);
+    assert(close(fds[0]) == 0);
+    test_touch_main_args((i == 0) ? EXIT_SUCCESS : EXIT_FAILURE,
+                         "--resume",
+                         "--checkpoint=/tmp/test-touch-checkpoint.json",
+                         "-f",
+                         "-",
+                         NULL);
+    assert(access(PATH_CP_A, F_OK) != 0);
+    assert((access(PATH_CP_B, F_OK) == 0) == (i == 0));
+    if(i == 0){
+      assert(remove(PATH_CP_B) == 0);
+      sprintf(expect,
+              "{\"offset\":%lu,\"targets\":3,\"errors\":1,"
+              "\"errno\":{\"2\":1}}\n",
+              (unsigned long)LIST_LEN);
+      test_assert_checkpoint(PATH_CP, expect);
+    }
+  }
+  assert(dup2(fd_stdin, STDIN_FILENO) == STDIN_FILENO);
+  assert(close(fd_stdin) == 0);
+
+  /* Invalid or unreadable checkpoints touch nothing. */
+  for(i = 0; i < sizeof(INVALID) / sizeof(INVALID[0]); i++){
+    test_write_file(PATH_CP, INVALID[i], strlen(INVALID[i]));
+    test_touch_main_args(EXIT_FAILURE,
+                         "--resume",
+                         "--checkpoint=/tmp/test-touch-checkpoint.json",
+                         "-f",
+                         PATH_CP_LIST,
+                         NULL);
+    assert(access(PATH_CP_A, F_OK) != 0);
+  }
+  test_touch_main_args(EXIT_FAILURE,
+                       "--resume",
+                       "--checkpoint=/tmp/test-touch-checkpoint",
+                       "-f",
+                       PATH_CP_LIST,
+                       NULL);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--resume",
+                       "--checkpoint=/tmp/test-touch-checkpoint.txt/cp",
+                       "-f",
+                       PATH_CP_LIST,
+                       NULL);
+  assert(access(PATH_CP_A, F_OK) != 0);
+
+  /* malloc: Touch everything without a checkpoint, or nothing if resuming. */
+  g_test_seam_err_ctr_malloc = 2;
+  test_touch_main_args(EXIT_FAILURE,
+                       "--resume",
+                       "--checkpoint=/tmp/test-touch-checkpoint.json",
+                       "-f",
+                       PATH_CP_LIST,
+                       NULL);
+  assert(access(PATH_CP_A, F_OK) != 0);
+  g_test_seam_err_ctr_malloc = 2;
+  test_touch_main_args(EXIT_FAILURE,
+                       "--checkpoint=/tmp/test-touch-checkpoint.json",
+                       "-f",
+                       PATH_CP_LIST,
+                       NULL);
+  g_test_seam_err_ctr_malloc = -1;
+  assert(access(PATH_CP_A, F_OK) == 0);
+
+  /* Failing to save a checkpoint still touches every path. */
+  assert(remove(PATH_CP) == 0);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--checkpoint=/tmp/noexist/cp",
+                       "--manifest=/tmp/test-touch-checkpoint.man",
+                       NULL);
+  test_assert_mtime_year(PATH_CP_A, 2000);
+  test_assert_mtime_year(PATH_CP_B, 2000);
+  assert(access(PATH_CP, F_OK) != 0);
+
+  /* Save a checkpoint after each manifest record, and resume one. */
+  g_test_seam_checkpoint_interval_ns = 0;
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--checkpoint=/tmp/test-touch-checkpoint.json",
+                       "--manifest=/tmp/test-touch-checkpoint.man",
+                       NULL);
+  g_test_seam_checkpoint_interval_ns = 1000000000UL;
+  sprintf(expect,
+          "{\"offset\":%lu,\"targets\":2,\"errors\":0,\"errno\":{}}\n",
+          (unsigned long)(sizeof(MANIFEST) - 1));
+  test_assert_checkpoint(PATH_CP, expect);
+  sprintf(expect,
+          "{\"offset\":%lu,\"targets\":1,\"errors\":0,\"errno\":{}}\n",
+          (unsigned long)(sizeof(MANIFEST) - 1) / 2);
+  test_write_file(PATH_CP, expect, strlen(expect));
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-d",
+                       "2003-06-01T00:00:00Z",
+                       PATH_CP_A,
+                       PATH_CP_B,
+                       NULL);
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--resume",
+                       "--checkpoint=/tmp/test-touch-checkpoint.json",
+                       "--manifest=/tmp/test-touch-checkpoint.man",
+                       NULL);
+  test_assert_mtime_year(PATH_CP_A, 2003);
+  test_assert_mtime_year(PATH_CP_B, 2000);
+
+  /* Start a mapped list at the saved offset, past the first window. */
+  list = malloc(MAP_LEN);
+  assert(list);
+  memset(list, '\n', MAP_LEN);
+  memcpy(list, PATH_CP_A, strlen(PATH_CP_A));
+  memcpy(&list[MAP_LEN / 2], PATH_CP_B, strlen(PATH_CP_B));
+  test_write_file(PATH_CP_LIST, list, MAP_LEN);
+  free(list);
+  sprintf(expect,
+          "{\"offset\":%lu,\"targets\":1,\"errors\":0,\"errno\":{}}\n",
+          (unsigned long)MAP_LEN / 2);
+  test_write_file(PATH_CP, expect, strlen(expect));
+  test_touch_main_args(EXIT_SUCCESS,
+                       "--resume",
+                       "--checkpoint=/tmp/test-touch-checkpoint.json",
+                       "-d",
+                       "2001-06-01T00:00:00Z",
+                       "-f",
+                       PATH_CP_LIST,
+                       NULL);
+  test_assert_mtime_year(PATH_CP_A, 2003);
+  test_assert_mtime_year(PATH_CP_B, 2001);
+  sprintf(expect,
+          "{\"offset\":%lu,\"targets\":2,\"errors\":0,\"errno\":{}}\n",
+          (unsigned long)MAP_LEN);
+  test_assert_checkpoint(PATH_CP, expect);
+  sprintf(expect,
+          "{\"offset\":%lu,\"targets\":0,\"errors\":0,\"errno\":{}}\n",
+          (unsigned long)MAP_LEN + 1);
+  test_write_file(PATH_CP, expect, strlen(expect));
+  test_touch_main_args(EXIT_FAILURE,
+                       "--resume",
+                       "--checkpoint=/tmp/test-touch-checkpoint.json",
+                       "-f",
+                       PATH_CP_LIST,
+                       NULL);
+  test_assert_mtime_year(PATH_CP_A, 2003);
+
+  /* Invalid combinations. */
+  test_touch_main_args(EXIT_FAILURE, "--resume", "-f", PATH_CP_LIST, NULL);
+  test_touch_main_args(EXIT_FAILURE,
+                       "--checkpoint=/tmp/test-touch-checkpoint.json",
+                       "-f",
+                       PATH_CP_LIST,
+                       "--manifest=/tmp/test-touch-checkpoint.man",
+                       NULL);
+  test_assert_mtime_year(PATH_CP_A, 2003);
+
+  assert(remove(PATH_CP) == 0);
+  assert(remove(PATH_CP_LIST) == 0);
+  assert(remove(PATH_CP_MANIFEST) == 0);
+  assert(remove(PATH_CP_A) == 0);
+  assert(remove(PATH_CP_B) == 0);
+  assert(rmdir(PATH_CP_DIR) == 0);
+}
+
+/**
+ * Test the apply kernels against the generic path for each flag combination.
+ */
+static void
+test_touch_kernels_all(void){
+  int kernels;
+
+  for(kernels = 0; kernels <= 1; kernels++){
+    g_test_seam_apply_kernels = kernels;
+    test_touch_main_args(EXIT_SUCCESS, "-c", PATH_TMP_FILE, NULL);
+    assert(access(PATH_TMP_FILE, F_OK) != 0);
+    test_touch_main_args(EXIT_SUCCESS,
+                         "--max-rate=1000000",
+                         "-d",
+                         "2001-06-01T00:00:00Z",
+                         PATH_TMP_FILE,
+                         NULL);
+    test_assert_mtime_year(PATH_TMP_FILE, 2001);
+    test_touch_main_args(EXIT_SUCCESS,
+                         "--forward-only",
+                         "-c",
+                         "-d",
+                         "2000-06-01T00:00:00Z",
+                         PATH_TMP_FILE,
+                         NULL);
+    test_assert_mtime_year(PATH_TMP_FILE, 2001);
+    test_touch_main_args(EXIT_SUCCESS,
+                         "--if-changed",
+                         "-d",
+                         "2001-06-01T00:00:00Z",
+                         PATH_TMP_FILE,
+                         NULL);
+    test_assert_mtime_year(PATH_TMP_FILE, 2001);
+    test_touch_main_args(EXIT_SUCCESS,
+                         "--if-changed",
+                         "--forward-only",
+                         "-d",
+                         "2002-06-01T00:00:00Z",
+                         PATH_TMP_FILE,
+                         NULL);
+    test_assert_mtime_year(PATH_TMP_FILE, 2002);
+    test_touch_main_args(EXIT_FAILURE,
+                         "-d",
+                         "2000-06-01T00:00:00Z",
+                         "/tmp/noexist/noexist",
+                         NULL);
+    test_remove_tmp_file();
+  }
+  g_test_seam_apply_kernels = 1;
+}
+
+/**
+ * Test scenarios with [--manifest=manifest].
+ */
+static void
+test_touch_manifest_all(void){
+  const char MANIFEST[] =
+    "1546333500.25 1546333501 " PATH_TMP_FILE "\n"
+    "2019-01-01T09:05:00Z -1.25 " PATH_TMP_FILE_2 "\n";
+  const char MANIFEST_INVALID[] =
+    "1546333500\n"
+    "1546333500 1546333500 \n"
+    "x 1546333500 " PATH_TMP_FILE "\n"
+    "1546333500 1. " PATH_TMP_FILE "\n"
+    "99999999999999999999 1546333500 " PATH_TMP_FILE "\n"
+    "2019-01-01T09:05:00Y 1546333500 " PATH_TMP_FILE "\n"
+    "10 20 " PATH_TMP_FILE_2 "\n";
+  struct stat sb;
+
+  /* Each path gets its own times. */
+  test_write_file(PATH_TMP_LIST, MANIFEST, sizeof(MANIFEST) - 1);
+  test_touch_main_args(EXIT_SUCCESS, "--manifest=" PATH_TMP_LIST, NULL);
+  assert(stat(PATH_TMP_FILE, &sb) == 0);
+  assert(sb.st_atim.tv_sec == 1546333500);
+  assert(sb.st_atim.tv_nsec == 250000000);
+  assert(sb.st_mtim.tv_sec == 1546333501);
+  assert(sb.st_mtim.tv_nsec == 0);
+  assert(stat(PATH_TMP_FILE_2, &sb) == 0);
+  assert(sb.st_atim.tv_sec == 1546333500);
+  assert(sb.st_mtim.tv_sec == -2);
+  assert(sb.st_mtim.tv_nsec == 750000000);
+
+  /* Only change the modification times. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-m",
+                       "--manifest=" PATH_TMP_LIST,
+                       NULL);
+  test_write_file(PATH_TMP_LIST,
+                  MANIFEST_INVALID,
+                  sizeof(MANIFEST_INVALID) - 1);
+  test_touch_main_args(EXIT_FAILURE,
+                       "-m",
+                       "--manifest=" PATH_TMP_LIST,
+                       NULL);
+  assert(stat(PATH_TMP_FILE, &sb) == 0);
+  assert(sb.st_mtim.tv_sec == 1546333501);
+  assert(stat(PATH_TMP_FILE_2, &sb) == 0);
+  assert(sb.st_atim.tv_sec == 1546333500);
+  assert(sb.st_mtim.tv_sec == 20);
+  test_assert_remove_tmp_files();
+
+  /* Manifest does not exist. */
+  assert(remove(PATH_TMP_LIST) == 0);
+  test_touch_main_args(EXIT_FAILURE, "--manifest=" PATH_TMP_LIST, NULL);
+}
+
+/**
+ * Test scenarios with [--stats].
+ */
+static void
+test_touch_stats_all(void){
+  const char *const PATH_TMP_STDERR = "/tmp/test-touch-stderr.txt";
+  char expect[200];
+  char *err_out;
+  char *line_1;
+  char *line_2;
+  int fd_stderr;
+  int fd_err;
+
+  fd_stderr = dup(STDERR_FILENO);
+  assert(fd_stderr >= 0);
+  fd_err = open(PATH_TMP_STDERR, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
+  assert(fd_err >= 0);
+  assert(dup2(fd_err, STDERR_FILENO) == STDERR_FILENO);
+  assert(close(fd_err) == 0);
+
+  /* Create two files and fail to create one. */
+  test_touch_main_args(EXIT_FAILURE,
+                       "--stats",
+                       PATH_NOEXIST,
+                       PATH_TMP_FILE,
+                       PATH_TMP_FILE_2,
+                       NULL);
+
+  /* Counters from the worker threads get merged. */
+  test_touch_main_args(EXIT_SUCCESS,
+                       "-c",
+                       "-j",
+                       "2",
+                       "--stats",
+                       PATH_TMP_FILE,
+                       PATH_TMP_FILE_2,
+                       NULL);
+  assert(dup2(fd_stderr, STDERR_FILENO) == STDERR_FILENO);
+  assert(close(fd_stderr) == 0);
+  test_assert_remove_tmp_files();
+
+  err_out = test_read_file(PATH_TMP_STDERR);
+  assert(remove(PATH_TMP_STDERR) == 0);
+  sprintf(expect,
+          "\n{\"opens\":4,\"creats\":2,\"utimensat\":3,\"futimens\":2,"
+          "\"statx\":0,\"unchanged\":0,\"enoent\":3,\"errors\":1,"
+          "\"errno\":{\"%d\":1},\"parse_ns\":",
+          EACCES);
+  line_1 = strstr(err_out, expect);
+  line_2 = strstr(err_out,
+                  "\"utimensat\":2,\"futimens\":0,\"statx\":0,"
+                  "\"unchanged\":0,\"enoent\":0,\"errors\":0,\"errno\":{},"
+                  "\"parse_ns\":");
+  assert(line_1 && line_2 && line_1 < line_2);
+  assert(strstr(line_1, ",\"fs_ns\":"));
+  free(err_out);
+}
+
+/**
+ * Test scenarios for the library interface in @ref touch_ctx.
+ */
+static void
+test_touch_ctx_all(void){
+  const char *const PATHS[] = {
+    PATH_TMP_FILE,
+    PATH_TMP_FILE_2
+  };
+  struct touch_ctx *ctx;
+
+  /* Apply one precompiled time to several paths. */
+  ctx = touch_ctx_new(TOUCH_FLAG_DATE_TIME, "2019-01-01T09:05:00");
+  assert(ctx);
+  assert(touch_ctx_apply(ctx, PATH_TMP_FILE) == EXIT_SUCCESS);
+  test_assert_mtime_year(PATH_TMP_FILE, 2019);
+  assert(touch_ctx_apply_many(ctx, PATHS, 2) == EXIT_SUCCESS);
+  test_assert_mtime_year(PATH_TMP_FILE_2, 2019);
+  assert(touch_ctx_apply(ctx, PATH_NOEXIST) == EXIT_FAILURE);
+  assert(touch_ctx_apply(ctx, PATH_TMP_FILE) == EXIT_SUCCESS);
+  touch_ctx_free(ctx);
+
+  /* Only update the access time using a reference file. */
+  ctx = touch_ctx_new(TOUCH_FLAG_REF_FILE | TOUCH_FLAG_ACCESS_TIME,
+                      PATH_REF_FILE);
+  assert(ctx);
+  assert(touch_ctx_apply_many(ctx, PATHS, 2) == EXIT_SUCCESS);
+  test_assert_mtime_year(PATH_TMP_FILE, 2019);
+  touch_ctx_free(ctx);
+
+  /* Current time without creating files. */
+  test_assert_remove_tmp_files();
+  ctx = touch_ctx_new(TOUCH_FLAG_NO_CREATE, NULL);
+  assert(ctx);
+  assert(touch_ctx_apply_many(ctx, PATHS, 2) == EXIT_SUCCESS);
+  assert(test_file_exists(PATH_TMP_FILE) == false);
+  touch_ctx_free(ctx);
+
+  /* Directories replaced or renamed between calls. */
+  assert(mkdir("/tmp/test-touch-ctx", S_IRWXU) == 0);
+  ctx = touch_ctx_new(0, NULL);
+  assert(ctx);
+  assert(touch_ctx_apply(ctx, "/tmp/test-touch-ctx/a") == EXIT_SUCCESS);
+  assert(rename("/tmp/test-touch-ctx", "/tmp/test-touch-ctx-old") == 0);
+  assert(mkdir("/tmp/test-touch-ctx", S_IRWXU) == 0);
+  assert(touch_ctx_apply(ctx, "/tmp/test-touch-ctx/b") == EXIT_SUCCESS);
+  assert(test_file_exists("/tmp/test-touch-ctx/b"));
+  assert(test_file_exists("/tmp/test-touch-ctx-old/b") == false);
+  assert(remove("/tmp/test-touch-ctx/b") == 0);
+  assert(rmdir("/tmp/test-touch-ctx") == 0);
+  assert(mkdir("/tmp/test-touch-ctx", S_IRWXU) == 0);
+  assert(touch_ctx_apply(ctx, "/tmp/test-touch-ctx/b") == EXIT_SUCCESS);
+  assert(test_file_exists("/tmp/test-touch-ctx/b"));
+  touch_ctx_free(ctx);
+  assert(remove("/tmp/test-touch-ctx/b") == 0);
+  assert(rmdir("/tmp/test-touch-ctx") == 0);
+  assert(remove("/tmp/test-touch-ctx-old/a") == 0);
+  assert(rmdir("/tmp/test-touch-ctx-old") == 0);
+
+  /* Flags that only report results from touch_main(). */
+  assert(touch_ctx_new(TOUCH_FLAG_STATS, NULL) == NULL);
+  assert(touch_ctx_new(TOUCH_FLAG_PLAN, NULL) == NULL);
+
+  /* Invalid time arguments. */
+  assert(touch_ctx_new(TOUCH_FLAG_TIME, "20") == NULL);
+  assert(touch_ctx_new(TOUCH_FLAG_DATE_TIME, NULL) == NULL);
+  assert(touch_ctx_new(TOUCH_FLAG_TIME | TOUCH_FLAG_DATE_TIME,
+                       "200711121015") == NULL);
+
+  /* Failed to allocate the context. */
+  g_test_seam_err_ctr_malloc = 0;
+  assert(touch_ctx_new(0, NULL) == NULL);
+  g_test_seam_err_ctr_malloc = -1;
+
+  touch_ctx_free(NULL);
+}
+
 /**
  * Run all test cases for touch.
  */
@@ -725,9 +3891,36 @@ test_touch_all(void){
   test_touch_posix_examples();
   test_touch_ref_file_all();
   test_touch_date_time_all();
+  test_touch_tz_all();
   test_touch_time_all();
   test_touch_directory();
   test_touch_multi_files();
+  test_touch_write_only_file();
+  test_touch_list_all();
+  test_touch_list_map_all();
+  test_touch_jobs_all();
+  test_touch_io_uring_all();
+  test_touch_io_uring_fail_all();
+  test_touch_dircache_all();
+  test_touch_recursive_all();
+  test_touch_ctx_all();
+  test_touch_stats_all();
+  test_touch_manifest_all();
+  test_touch_ref_root_all();
+  test_touch_if_changed_all();
+  test_touch_errlog_all();
+  test_touch_new_files_all();
+  test_touch_sort_all();
+  test_touch_serve_all();
+  test_touch_jobs_ring_all();
+  test_touch_tree_rss_all();
+  test_touch_glob_all();
+  test_touch_durable_all();
+  test_touch_progress_all();
+  test_touch_limit_all();
+  test_touch_plan_all();
+  test_touch_checkpoint_all();
+  test_touch_kernels_all();
 }
 
 /**
@@ -9,30 +9,65 @@
 #define TOUCH_TEST_H
 
 #include <sys/stat.h>
+#include <pthread.h>
 #include <time.h>
 
+#include "../src/touch.h"
+
 int
-touch_main(int argc,
-           char *const argv[]);
+test_seam_close(int fd);
 
 int
 test_seam_futimens(int fd,
                    const struct timespec times[2]);
 
+long
+test_seam_io_uring_enter(int fd,
+                         unsigned int to_submit,
+                         unsigned int min_complete,
+                         unsigned int flags);
+
+struct tm *
+test_seam_localtime_r(const time_t *timer,
+                      struct tm *result);
+
 void *
 test_seam_malloc(size_t size);
 
-time_t
-test_seam_mktime(struct tm *timeptr);
+void *
+test_seam_mmap(void *addr,
+               size_t len,
+               int prot,
+               int flags,
+               int fd,
+               off_t off);
+
+int
+test_seam_open(const char *path,
+               int oflag, ...);
+
+int
+test_seam_openat(int fd,
+                 const char *path,
+                 int oflag, ...);
+
+int
+test_seam_pthread_create(pthread_t *thread,
+                         const pthread_attr_t *attr,
+                         void *(*start_routine)(void *),
+                         void *arg);
 
+#ifdef STATX_MTIME
 int
-test_seam_setenv(const char *envname,
-                 const char *envval,
-                 int overwrite);
+test_seam_statx(int dirfd,
+                const char *path,
+                int flags,
+                unsigned int mask,
+                struct statx *stx);
+#endif /* STATX_MTIME */
 
-double
-test_seam_strtod(const char *nptr,
-                 char **endptr);
+int
+test_seam_syncfs(int fd);
 
 int
 test_seam_utimensat(int fd,
@@ -40,12 +75,24 @@ test_seam_utimensat(int fd,
                     const struct timespec times[2],
                     int flag);
 
+extern int g_test_seam_apply_kernels;
+extern int g_test_seam_date_time_fast;
 extern int g_test_seam_err_ctr_futimens;
+extern int g_test_seam_err_ctr_io_uring_enter;
+extern int g_test_seam_err_ctr_localtime_r;
 extern int g_test_seam_err_ctr_malloc;
-extern int g_test_seam_err_ctr_mktime;
-extern int g_test_seam_err_ctr_setenv;
-extern int g_test_seam_err_ctr_strtod;
+extern int g_test_seam_err_ctr_mmap;
+extern int g_test_seam_err_ctr_open;
+extern int g_test_seam_err_ctr_pthread_create;
+extern int g_test_seam_err_ctr_syncfs;
 extern int g_test_seam_err_ctr_utimensat;
 
+extern unsigned long g_test_seam_checkpoint_interval_ns;
+extern unsigned long g_test_seam_limit_window_ns;
+extern unsigned long g_test_seam_progress_interval_ns;
+extern unsigned int g_test_seam_statx_drop;
+extern unsigned long g_test_seam_syscall_ctr;
+extern unsigned long g_test_seam_utimensat_delay_ns;
+
 #endif /* TOUCH_TEST_H */
 